@@ -0,0 +1,302 @@
+#include <log4cxx/propertyconfigurator.h>
+#include <boost/program_options.hpp>
+#include "util/CppFile.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace po = boost::program_options;
+typedef std::string StringType;
+typedef std::vector<StringType> StringStore;
+typedef boost::filesystem::path PathType;
+typedef std::vector<PathType> PathStore;
+
+// Declare the supported options.
+    po::options_description
+GetOptionDescription()
+{
+    po::options_description data
+        ( "log4cxx_10_to_11_bench {options}\n\n"
+          "Generate a synthetic C++ corpus and report the throughput of each processing phase as JSON lines.\n\n"
+          "where valid options are"
+        );
+    data.add_options()
+        ("help,h", "produce help message")
+        ("files", po::value<int>()->default_value(50), "the number of files to generate")
+        ("file-size", po::value<int>()->default_value(64 * 1024), "the approximate size of each file in bytes")
+        ("macro-density", po::value<double>()->default_value(0.2), "the fraction of statements that are LOG4CXX_ macros")
+        ("comment-density", po::value<double>()->default_value(0.2), "the fraction of statements preceded by a comment")
+        ("string-density", po::value<double>()->default_value(0.2), "the fraction of statements containing a string literal")
+        ("nesting", po::value<int>()->default_value(3), "the maximum depth of nested blocks")
+        ("seed", po::value<unsigned>()->default_value(1), "the random number generator seed")
+        ("repeat", po::value<int>()->default_value(3), "the number of times each phase is measured")
+        ("lexer", po::value<StringType>()->default_value("fast"), "the tokenizer to use: fast or wave")
+        ("dir", po::value<StringType>(), "put the corpus in (and keep) this directory")
+        ;
+    return data;
+}
+
+/// The shape of the generated C++ files
+struct CorpusOptions
+{
+    int      fileCount;
+    size_t   fileSize;       //!< Approximate bytes per file
+    double   macroDensity;   //!< Fraction of statements that are LOG4CXX_ macros
+    double   commentDensity; //!< Fraction of statements preceded by a comment
+    double   stringDensity;  //!< Fraction of statements with a string literal
+    int      nesting;        //!< Maximum depth of nested blocks
+    unsigned seed;
+};
+
+/// Writes C++ source files that resemble code using log4cxx
+class CorpusGenerator
+{
+private: // Attributes
+    CorpusOptions m_options;
+    std::mt19937 m_random;
+    std::ostringstream m_text; //!< The content of the current file
+    int m_functionCount; //!< The number of functions in the current file
+
+public: // ...structors
+    CorpusGenerator(const CorpusOptions& options)
+        : m_options(options)
+        , m_random(options.seed)
+        , m_functionCount(0)
+    {}
+
+public: // Methods
+    /// Put the files into \c dir, appending their names to \c paths
+    void Generate(const PathType& dir, PathStore& paths)
+    {
+        boost::filesystem::create_directories(dir);
+        for (int i = 0; i < m_options.fileCount; ++i)
+        {
+            PathType path = dir / ("file" + std::to_string(i) + ".cpp");
+            std::ofstream(path.c_str(), std::ios::binary) << GenerateFile();
+            paths.push_back(path);
+        }
+    }
+
+protected: // Support methods
+    /// Is the next random event of \c probability true?
+    bool Chance(double probability)
+    {
+        return std::uniform_real_distribution<double>(0, 1)(m_random) < probability;
+    }
+
+    /// A random value in [0, count)
+    int Pick(int count)
+    {
+        return std::uniform_int_distribution<int>(0, count - 1)(m_random);
+    }
+
+    /// The content of a file
+    StringType GenerateFile()
+    {
+        m_text.str("");
+        m_functionCount = 0;
+        m_text << "/// A generated file\n#include <log4cxx/logger.h>\n\n"
+            << "static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger(\"bench\"));\n\n";
+        while (size_t(m_text.tellp()) < m_options.fileSize)
+        {
+            m_text << "int function" << m_functionCount++ << "(int x, int y)\n{\n";
+            GenerateBlock(1);
+            m_text << "    return x;\n}\n\n";
+        }
+        return m_text.str();
+    }
+
+    /// Statements (and nested blocks) at \c depth
+    void GenerateBlock(int depth)
+    {
+        StringType indent(4 * depth, ' ');
+        int statementCount = 2 + Pick(6);
+        for (int i = 0; i < statementCount; ++i)
+        {
+            if (Chance(m_options.commentDensity))
+                m_text << indent << (Chance(0.5) ? "// A comment with LOG4CXX_INFO(logger, x) in it\n" : "/* A block\n" + indent + "   comment */\n");
+            if (depth < m_options.nesting && Chance(0.25))
+            {
+                static const char* keywords[] = { "if (x < y)", "while (0 < --x)", "for (int i = 0; i < y; ++i)" };
+                m_text << indent << keywords[Pick(3)] << "\n";
+                if (Chance(m_options.macroDensity)) // A compound statement body that needs braces for 0.10 and 0.11
+                    m_text << indent << "    " << GenerateMacro() << "\n";
+                else
+                {
+                    m_text << indent << "{\n";
+                    GenerateBlock(depth + 1);
+                    m_text << indent << "}\n";
+                }
+            }
+            else if (Chance(m_options.macroDensity))
+                m_text << indent << GenerateMacro() << (Chance(0.5) ? ";\n" : "\n");
+            else if (Chance(m_options.stringDensity))
+                m_text << indent << "x += std::strlen(\"a (string) with LOG4CXX_WARN(logger, y); in it\");\n";
+            else
+                m_text << indent << "x = (x * " << Pick(100) << " + y) % " << (1 + Pick(1000)) << ";\n";
+        }
+    }
+
+    /// A logging request without a terminator
+    StringType GenerateMacro()
+    {
+        static const char* levels[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR" };
+        StringType result = StringType("LOG4CXX_") + levels[Pick(5)] + "(logger, ";
+        if (Chance(m_options.stringDensity))
+            result += "\"x=\" << x << \" (y=\" << y << ')'";
+        else
+            result += "x << y";
+        return result + ")";
+    }
+};
+
+/// Exposes the internals of CppFile that are measured separately
+class BenchFile : public CppFile
+{
+public: // ...structors
+    BenchFile(LexerType lexerType)
+        : CppFile(lexerType)
+    {}
+
+public: // Methods
+    using CppFile::SetLineIndex;
+};
+
+/// Measures a processing phase
+class PhaseTimer
+{
+public: // Types
+    typedef std::chrono::steady_clock ClockType;
+
+private: // Attributes
+    StringType m_name;
+    double m_seconds; //!< The total measured time
+    uintmax_t m_bytes; //!< The total content processed
+    uintmax_t m_tokens; //!< The total tokens processed
+    uintmax_t m_files; //!< The number of files processed
+
+public: // ...structors
+    PhaseTimer(const StringType& name)
+        : m_name(name)
+        , m_seconds(0)
+        , m_bytes(0)
+        , m_tokens(0)
+        , m_files(0)
+    {}
+
+public: // Methods
+    /// Measure \c phase applied to \c file
+    void Measure(const std::function<void()>& phase, const CppFile& file)
+    {
+        ClockType::time_point start = ClockType::now();
+        phase();
+        m_seconds += std::chrono::duration<double>(ClockType::now() - start).count();
+        m_bytes += file.GetContentSize();
+        m_tokens += file.GetTokenCount();
+        ++m_files;
+    }
+
+    /// Put the totals and rates onto \c os as a JSON object
+    void Report(std::ostream& os) const
+    {
+        double seconds = 0 < m_seconds ? m_seconds : 1e-9;
+        os << "{\"phase\": \"" << m_name << "\""
+            << ", \"files\": " << m_files
+            << ", \"bytes\": " << m_bytes
+            << ", \"tokens\": " << m_tokens
+            << ", \"seconds\": " << m_seconds
+            << ", \"MB/s\": " << m_bytes / seconds / 1e6
+            << ", \"tokens/s\": " << m_tokens / seconds
+            << ", \"files/s\": " << m_files / seconds
+            << "}\n";
+    }
+};
+
+/// Measure each processing phase on \c paths \c repeatCount times
+void RunBenchmarks(const PathStore& paths, CppFile::LexerType lexerType, int repeatCount)
+{
+    BenchFile file(lexerType);
+    CppFile::FunctionIterator log4cxxMacro(file, "LOG4CXX_");
+    log4cxxMacro.AddExclusion("LOG4CXX_STR");
+    file.SetPrefilter(log4cxxMacro.GetPrefilter());
+    PhaseTimer load("LoadFile"), lineIndex("SetLineIndex"), iterate("FunctionIterator"), fix("AddSemicolon+InsertBraces"), store("Store");
+    size_t macroCount = 0;
+    for (int repeat = 0; repeat < repeatCount; ++repeat)
+    {
+        for (auto& path : paths)
+        {
+            load.Measure([&file, &path]() { file.LoadFile(path); }, file);
+            lineIndex.Measure([&file]() { file.SetLineIndex(); }, file);
+            iterate.Measure([&log4cxxMacro, &macroCount]()
+            {
+                for (log4cxxMacro.Start(); !log4cxxMacro.Off(); log4cxxMacro.Forth())
+                    ++macroCount;
+            }, file);
+            fix.Measure([&log4cxxMacro]()
+            {
+                for (log4cxxMacro.Start(); !log4cxxMacro.Off(); log4cxxMacro.Forth())
+                {
+                    if (!log4cxxMacro.HasStatementTerminator())
+                    {
+                        log4cxxMacro.AddSemicolon();
+                        if (log4cxxMacro.IsCompoundStatementBody())
+                            log4cxxMacro.InsertBraces();
+                    }
+                }
+            }, file);
+            std::ostringstream os;
+            store.Measure([&file, &os]() { file.Store(os); }, file);
+        }
+    }
+    for (auto phase : { &load, &lineIndex, &iterate, &fix, &store })
+        phase->Report(std::cout);
+    std::cerr << macroCount / std::max(1, repeatCount) << " macros in " << paths.size() << " files\n";
+}
+
+int main(int argc, char* argv[])
+{
+    bool ok = false;
+    try
+    {
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, GetOptionDescription()), vm);
+        po::notify(vm);
+        if (vm.count("help"))
+            std::cout << GetOptionDescription() << "\n";
+        else
+        {
+            if (boost::filesystem::exists("log4cxx_10_to_11.properties"))
+                log4cxx::PropertyConfigurator::configure("log4cxx_10_to_11.properties");
+            CorpusOptions options;
+            options.fileCount = vm["files"].as<int>();
+            options.fileSize = size_t(std::max(1, vm["file-size"].as<int>()));
+            options.macroDensity = vm["macro-density"].as<double>();
+            options.commentDensity = vm["comment-density"].as<double>();
+            options.stringDensity = vm["string-density"].as<double>();
+            options.nesting = vm["nesting"].as<int>();
+            options.seed = vm["seed"].as<unsigned>();
+            StringType lexerName = vm["lexer"].as<StringType>();
+            if ("fast" != lexerName && "wave" != lexerName)
+                throw std::invalid_argument("--lexer must be fast or wave, not " + lexerName);
+            bool keepCorpus = vm.count("dir");
+            PathType dir = keepCorpus
+                ? PathType(vm["dir"].as<StringType>())
+                : boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("log4cxx_bench_%%%%%%%%");
+            PathStore paths;
+            CorpusGenerator(options).Generate(dir, paths);
+            RunBenchmarks(paths, "wave" == lexerName ? CppFile::WaveContext : CppFile::LexerOnly, std::max(1, vm["repeat"].as<int>()));
+            if (!keepCorpus)
+                boost::filesystem::remove_all(dir);
+        }
+        ok = true;
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << ex.what() << "\n";
+    }
+    return ok ? 0 : 1;
+}
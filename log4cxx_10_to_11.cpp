@@ -1,13 +1,32 @@
 #include <log4cxx/propertyconfigurator.h>
 #include <boost/program_options.hpp>
 #include <log4cxx/logger.h>
+#include "util/ChangedLines.h"
 #include "util/CppFile.h"
 #include "util/DirectoryEntryIterator.h"
+#include "util/FileProcessor.h"
+#include "util/FileQueue.h"
+#include "util/LocalSocket.h"
+#include "util/PhaseStats.h"
+#include "util/ReadAhead.h"
+#include "util/RequestServer.h"
+#include "util/TextSearch.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <thread>
 
 namespace po = boost::program_options;
 typedef std::string StringType;
 typedef std::vector<StringType> StringStore;
+typedef boost::filesystem::path PathType;
 
 // Declare the supported options.
     po::options_description
@@ -22,7 +41,21 @@ GetOptionDescription()
         ("verbose,v", "list the number of macros to be adjusted in each file")
         ("only_11", "modify files to work with 0.11")
         ("both_10_and_11", "modify files to work with 0.10 and 0.11")
+        ("diff", po::value<StringType>()->implicit_value("-"), "put the modifications of --only_11 or --both_10_and_11 as a unified diff onto the standard output (or into the patch file arg) instead of changing the files")
         ("ext,e", po::value<StringStore>(), "add to the list of checked file extensions: default [.cpp, .cxx, .hpp, .h]")
+        ("jobs,j", po::value<int>()->default_value(1), "the number of files to process in parallel: 0 uses all processors")
+        ("lexer", po::value<StringType>()->default_value("fast"), "the tokenizer to use: fast or wave")
+        ("input", po::value<StringType>()->default_value("mmap"), "how files are loaded: mmap or read")
+        ("cache", po::value<StringType>(), "the directory in which to keep results for reuse by later runs")
+        ("files-from", po::value<StringType>(), "also process the files named in arg (- for standard input), one per line or NUL separated")
+        ("lines", po::value<StringStore>(), "check only the macros on the lines given as path:first-last[,first-last...], also processing path")
+        ("lines-from-diff", po::value<StringType>(), "check only the macros on the lines changed by the unified diff in arg (- for standard input), also processing its files")
+        ("rules", po::value<StringType>(), "the file of macro families, exclusions and actions to check instead of the LOG4CXX_ macros")
+        ("read-ahead", po::value<int>()->implicit_value(32), "keep up to arg files being read ahead of processing, through io_uring where the kernel allows it, otherwise by reader threads")
+        ("stream", po::value<int>()->implicit_value(64), "process files of at least arg MB a chunk at a time in bounded memory, using the fast tokenizer without a cache")
+        ("stats", po::value<int>()->implicit_value(10), "put the time spent in each phase and the peak edit arena size as JSON onto the standard error stream, listing the arg slowest files")
+        ("serve", po::value<StringType>(), "check the files sent to the Unix socket arg by clients until interrupted, keeping loaded state between requests")
+        ("client", po::value<StringType>(), "have the server listening on the Unix socket arg check the files (- sends the standard input and puts the result onto the standard output)")
         ;
     return data;
 }
@@ -47,30 +80,315 @@ void processArgs(int argc, char** argv, po::variables_map& vm)
     static log4cxx::LoggerPtr
 log_s(log4cxx::Logger::getLogger("main"));
 
-// Scan \c file for issues with LOG4CXX_ macros, and optionally apply changes
-int ProcessLog4cxxMacros(CppFile& file, bool fix, bool fix_10_and_11)
+// The tokenizer selected by the --lexer option \c name
+CppFile::LexerType GetLexerType(const StringType& name)
 {
-    int macroCount = 0;
-    int fixCount = 0;
-    CppFile::FunctionIterator log4cxxMacro(file, "LOG4CXX_");
-    log4cxxMacro.AddExclusion("LOG4CXX_STR");
-    log4cxxMacro.AddExclusion("LOG4CXX_LIST");
-    log4cxxMacro.AddExclusion("LOG4CXX_PTR");
-    log4cxxMacro.AddExclusion("LOG4CXX_ENCODE");
-    log4cxxMacro.AddExclusion("LOG4CXX_DECODE");
-    for (log4cxxMacro.Start(); !log4cxxMacro.Off(); log4cxxMacro.Forth())
+    if ("fast" == name)
+        return CppFile::LexerOnly;
+    if ("wave" == name)
+        return CppFile::WaveContext;
+    throw std::invalid_argument("--lexer must be fast or wave, not " + name);
+}
+
+// The file loading method selected by the --input option \c name
+CppFile::InputType GetInputType(const StringType& name)
+{
+    if ("mmap" == name)
+        return CppFile::MappedInput;
+    if ("read" == name)
+        return CppFile::BufferedInput;
+    throw std::invalid_argument("--input must be mmap or read, not " + name);
+}
+
+// The LOG4CXX_ macros that are logging requests
+MacroRuleSet GetLog4cxxRules()
+{
+    MacroRuleSet result;
+    result.AddFamily("LOG4CXX_");
+    result.AddExclusion("LOG4CXX_STR");
+    result.AddExclusion("LOG4CXX_LIST");
+    result.AddExclusion("LOG4CXX_PTR");
+    result.AddExclusion("LOG4CXX_ENCODE");
+    result.AddExclusion("LOG4CXX_DECODE");
+    return result;
+}
+
+/// Puts the outcome of checking each file onto the standard streams
+class ResultReporter
+{
+private: // Attributes
+    bool m_quiet; //!< Do not print file names?
+    bool m_verbose; //!< Print fix counts and a summary?
+    size_t m_fileCount; //!< The number of results reported
+    size_t m_prefilteredCount; //!< The number of files skipped without tokenizing
+    size_t m_cachedCount; //!< The number of results reused from a previous run
+    bool m_isCacheUsed; //!< Report the cache hit rate?
+    std::ostream* m_patchStream; //!< Where modifications are put as a unified diff (or null)
+    PhaseStats m_totalStats; //!< The resources used by all files
+    size_t m_slowestCount; //!< The number of files in m_slowest
+    std::vector<FileResult> m_slowest; //!< The files that took longest, as a heap with the fastest at the front
+
+public: // ...structors
+    ResultReporter(bool quiet, bool verbose, bool isCacheUsed = false)
+        : m_quiet(quiet)
+        , m_verbose(verbose)
+        , m_fileCount(0)
+        , m_prefilteredCount(0)
+        , m_cachedCount(0)
+        , m_isCacheUsed(isCacheUsed)
+        , m_patchStream(0)
+        , m_slowestCount(0)
+    {}
+
+public: // Modifiers
+    /// Keep the resources used by the \c slowestCount files that take longest
+    void SetSlowestCount(size_t slowestCount) { m_slowestCount = slowestCount; }
+
+    /// Put the modifications of each file as a unified diff onto \c patchStream
+    void SetPatchStream(std::ostream* patchStream) { m_patchStream = patchStream; }
+
+public: // Methods
+    /// Put the outcome of checking a file onto the standard streams
+    void Report(const FileResult& result)
+    {
+        ++m_fileCount;
+        if (result.isPrefiltered)
+            ++m_prefilteredCount;
+        if (result.isCached)
+            ++m_cachedCount;
+        m_totalStats.Add(result.stats);
+        if (0 < m_slowestCount)
+            KeepIfSlow(result);
+        if (m_patchStream)
+            *m_patchStream << result.patch;
+        if (!result.isValid)
+            std::cerr << "Skipping invalid " << result.path << "\n";
+        else if (result.fixCount && !m_quiet)
+        {
+            std::cout << result.path.string();
+            if (m_verbose)
+                std::cout << ": " << result.fixCount;
+            std::cout << "\n";
+        }
+    }
+
+    /// Put the totals onto the standard error stream (when verbose)
+    void ReportSummary() const
+    {
+        if (!m_verbose)
+            return;
+        std::cerr << m_prefilteredCount << " of " << m_fileCount
+            << " files had no macros of interest (" << TextSearch::GetKernelName() << " prefilter)\n";
+        if (m_isCacheUsed)
+            std::cerr << m_cachedCount << " of " << m_fileCount << " results were cached ("
+                << (m_fileCount ? 100 * m_cachedCount / m_fileCount : 0) << "% hit rate)\n";
+    }
+
+    /// Put the resources used, including \c walkStats, as JSON onto the standard error stream
+    void ReportStats(const PhaseStats& walkStats, double elapsedSeconds)
+    {
+        PhaseStats total = m_totalStats;
+        total.Add(walkStats);
+        std::cerr << "{\"files\": " << m_fileCount
+            << ", \"prefiltered\": " << m_prefilteredCount
+            << ", \"cached\": " << m_cachedCount
+            << ", \"elapsed_seconds\": " << elapsedSeconds
+            << ", \"hardware_counters\": " << (total.HasEvents() ? "true" : "false")
+            << ",\n \"total\": {";
+        total.WriteJson(std::cerr);
+        std::cerr << "},\n \"slowest\": [";
+        std::sort_heap(m_slowest.begin(), m_slowest.end(), IsSlower);
+        for (size_t i = 0; i < m_slowest.size(); ++i)
+        {
+            std::cerr << (0 < i ? ",\n  " : "\n  ") << "{\"path\": ";
+            PhaseStats::WriteJsonString(std::cerr, m_slowest[i].path.string());
+            std::cerr << ", ";
+            m_slowest[i].stats.WriteJson(std::cerr);
+            std::cerr << "}";
+        }
+        std::cerr << "]}\n";
+    }
+
+protected: // Support methods
+    /// Did \c left take longer than \c right?
+    static bool IsSlower(const FileResult& left, const FileResult& right)
+    {
+        return right.stats.GetTotalSeconds() < left.stats.GetTotalSeconds();
+    }
+
+    /// Add \c result to m_slowest if it is one of the slowest files
+    void KeepIfSlow(const FileResult& result)
+    {
+        if (m_slowest.size() < m_slowestCount)
+        {
+            m_slowest.push_back(result);
+            std::push_heap(m_slowest.begin(), m_slowest.end(), IsSlower);
+        }
+        else if (IsSlower(result, m_slowest.front()))
+        {
+            std::pop_heap(m_slowest.begin(), m_slowest.end(), IsSlower);
+            m_slowest.back() = result;
+            std::push_heap(m_slowest.begin(), m_slowest.end(), IsSlower);
+        }
+    }
+};
+
+/// Check the files selected by \c fileIter using \c jobCount threads, reporting the outcome in file order
+void ProcessInParallel(DirectoryEntryIterator& fileIter, int jobCount, const ProcessingOptions& options, ResultReporter& reporter)
+{
+    typedef FileQueue<FileResult> QueueType;
+    QueueType queue(std::max<size_t>(jobCount * 16, options.readAheadDepth));
+    std::unique_ptr<ReadAhead> readAhead;
+    if (0 < options.readAheadDepth)
+    {
+        readAhead.reset(new ReadAhead(options.readAheadDepth));
+        LOG4CXX_INFO(log_s, "Reading ahead using " << readAhead->GetMethodName());
+    }
+    std::vector<std::thread> workers;
+    for (int i = 0; i < jobCount; ++i)
+        workers.emplace_back([&queue, &readAhead, &options]()
+        {
+            FileProcessor processor(options);
+            InputFile content; // Of a file read ahead
+            QueueType::JobType job;
+            while (queue.NextJob(job))
+            {
+                FileResult result;
+                try
+                {
+                    bool isRead = readAhead && readAhead->Take(job.sequence, content);
+                    result = processor.Process(job.path, isRead ? &content : 0);
+                    content.Close();
+                }
+                catch (std::exception& ex)
+                {
+                    LOG4CXX_ERROR(log_s, job.path << ": " << ex.what());
+                    result = FileResult(job.path);
+                }
+                queue.Complete(job.sequence, std::move(result));
+            }
+        });
+    std::exception_ptr walkError;
+    std::thread walker([&queue, &readAhead, &fileIter, &walkError, &options]()
+    {
+        HardwareCounters counters(options.collectStats); // Of this thread
+        if (fileIter.GetStats())
+            fileIter.GetStats()->SetCounters(&counters);
+        try
+        {
+            size_t sequence = 0; // Of the next job added to queue
+            for (fileIter.Start(); !fileIter.Off(); fileIter.Forth(), ++sequence)
+            {
+                // The walker learns the type of an entry without a stat call, but not its size,
+                // so this costs a stat per selected file. It runs on this thread while the workers
+                // are busy, and is what lets the largest files start first.
+                boost::system::error_code ec;
+                uintmax_t size = boost::filesystem::file_size(fileIter.Item(), ec);
+                if (readAhead && !ec && size < options.streamSize) // Streamed files are not loaded
+                    readAhead->Add(sequence, fileIter.Item());
+                queue.Add(fileIter.Item(), ec ? 0 : size);
+            }
+        }
+        catch (...)
+        {
+            walkError = std::current_exception();
+        }
+        if (fileIter.GetStats())
+            fileIter.GetStats()->SetCounters(0);
+        queue.Close();
+    });
+    FileResult result;
+    while (queue.NextResult(result))
+        reporter.Report(result);
+    walker.join();
+    for (auto& worker : workers)
+        worker.join();
+    if (walkError)
+        std::rethrow_exception(walkError);
+}
+
+namespace
+{
+    volatile std::sig_atomic_t stopRequested_s = 0; //!< Set by an interrupt
+
+    extern "C" void RequestStop(int)
+    {
+        stopRequested_s = 1;
+    }
+}
+
+/// Reply to the clients connecting to \c socketPath until interrupted
+void Serve(const StringType& socketPath, const ProcessingOptions& options, const DirectoryEntrySelectorPtr& selector)
+{
+    LocalSocket listener;
+    if (!listener.Listen(socketPath))
+        throw std::runtime_error(socketPath + ": cannot listen (already served or not creatable)");
+#if !defined(_WIN32)
+    // Without SA_RESTART, so a waiting accept() returns
+    struct sigaction action = {};
+    action.sa_handler = RequestStop;
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+#endif
+    RequestServer server(options, selector);
+    LOG4CXX_INFO(log_s, "Serving " << socketPath);
+    LocalSocket connection;
+    while (!stopRequested_s)
     {
-        ++macroCount;
-        if (!log4cxxMacro.HasStatementTerminator())
+        if (listener.Accept(connection))
+            server.Serve(connection);
+        else if (EINTR != errno)
+            throw std::runtime_error(socketPath + ": " + std::strerror(errno));
+        connection.Close();
+    }
+    LOG4CXX_INFO(log_s, "Stopped serving " << socketPath);
+}
+
+/// Have the server at \c socketPath check \c itemStore in \c mode, reporting the outcome to \c reporter
+void RunClient(const StringType& socketPath, const StringType& mode, const StringStore& itemStore, ResultReporter& reporter)
+{
+    LocalSocket server;
+    if (!server.Connect(socketPath))
+        throw std::runtime_error(socketPath + ": no server is listening");
+    server.Write("request " + mode + "\n");
+    StringType input; // The standard input content
+    for (auto& item : itemStore)
+    {
+        if ("-" != item)
+            server.Write("path " + boost::filesystem::absolute(item).string() + "\n");
+        else
         {
-            ++fixCount;
-            if (fix)
-                log4cxxMacro.AddSemicolon();
-            if (fix_10_and_11 && log4cxxMacro.IsCompoundStatementBody())
-                log4cxxMacro.InsertBraces();
+            input.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+            server.Write("buffer " + std::to_string(input.size()) + " -\n");
+            server.Write(input);
         }
     }
-    return fixCount;
+    server.Write("end\n");
+    if (!server.Shutdown())
+        throw std::runtime_error(socketPath + ": the server stopped");
+    StringType line, output;
+    while (server.ReadLine(line) && "done" != line)
+    {
+        if (0 == line.compare(0, 6, "error "))
+            throw std::runtime_error(socketPath + ": " + line.substr(6));
+        FileResult result;
+        if (!RequestServer::ParseResult(line, result))
+            throw std::runtime_error(socketPath + ": unexpected reply: " + line);
+        if ("-" != result.path)
+        {
+            reporter.Report(result);
+            continue;
+        }
+        if (!server.ReadLine(line) || line.compare(0, 8, "content ")
+            || !server.ReadBlock(std::stoul(line.substr(8)), output))
+            throw std::runtime_error(socketPath + ": incomplete reply");
+        if ("check" == mode) // The standard output is not the content
+            reporter.Report(result);
+        else
+            std::cout << (output.empty() ? input : output);
+    }
+    if ("done" != line)
+        throw std::runtime_error(socketPath + ": the server stopped");
 }
 
 int main( int argc, char* argv[] )
@@ -80,44 +398,139 @@ int main( int argc, char* argv[] )
     {
         po::variables_map vm;
         processArgs(argc, argv, vm);
-        bool changeFiles = vm.count("both_10_and_11") || vm.count("only_11");
-        bool for_10_and_11 = vm.count("both_10_and_11");
-        bool quiet = vm.count("quiet");
+        ProcessingOptions options;
+        options.fix = vm.count("both_10_and_11") || vm.count("only_11");
+        options.fix_10_and_11 = vm.count("both_10_and_11");
+        options.diff = vm.count("diff");
+        options.collectStats = vm.count("stats");
+        bool quiet = vm.count("quiet") || (options.diff && "-" == vm["diff"].as<StringType>()); // The standard output is the patch
         bool verbose = vm.count("verbose");
+        int jobCount = vm["jobs"].as<int>();
+        if (jobCount <= 0)
+            jobCount = std::max(1u, std::thread::hardware_concurrency());
+        options.lexerType = GetLexerType(vm["lexer"].as<StringType>());
+        options.inputType = GetInputType(vm["input"].as<StringType>());
+        if (vm.count("cache"))
+            options.cacheDir = vm["cache"].as<StringType>();
+        options.readAheadDepth = vm.count("read-ahead") ? size_t(std::max(0, vm["read-ahead"].as<int>())) : 0;
+        options.streamSize = UINTMAX_MAX;
+        if (vm.count("stream"))
+            options.streamSize = uintmax_t(std::max(0, vm["stream"].as<int>())) << 20;
+        if (!vm.count("rules"))
+            options.rules = GetLog4cxxRules();
+        else
+        {
+            options.rules.LoadFile(vm["rules"].as<StringType>());
+            if (options.rules.GetPrefilter().IsEmpty())
+                throw std::invalid_argument(vm["rules"].as<StringType>() + ": no macro families");
+        }
 
-        if (!vm.count("file-or-dir") || vm.count("help"))
+        StringStore itemStore;
+        if (vm.count("file-or-dir"))
+            itemStore = vm["file-or-dir"].as<StringStore>();
+        StringStore extStore = {".cpp", ".cxx", ".hpp", ".h"};
+        if (vm.count("ext"))
+        {
+            StringStore extra = vm["ext"].as<StringStore>();
+            extStore.insert(extStore.end(), extra.begin(), extra.end());
+        }
+        DirectoryEntrySelectorPtr selector(new ExtensionSelector(extStore.begin(), extStore.end()));
+        if (vm.count("lines"))
+        {
+            for (auto& spec : vm["lines"].as<StringStore>())
+                options.changedLines.AddSpecification(spec);
+        }
+        if (vm.count("lines-from-diff"))
+        {
+            StringType diffName = vm["lines-from-diff"].as<StringType>();
+            if ("-" == diffName)
+                options.changedLines.AddDiff(std::cin);
+            else
+            {
+                std::ifstream diffFile(diffName.c_str(), std::ios::binary);
+                if (!diffFile.is_open())
+                    throw ExistsException(diffName);
+                options.changedLines.AddDiff(diffFile);
+            }
+        }
+        size_t namedCount = itemStore.size();
+        for (auto& item : options.changedLines) // The selected files not already named
+        {
+            bool skipDirectory;
+            auto isSame = [&item](const StringType& name) { return PathType(name).lexically_normal() == item.first; };
+            if (selector->IsIncluded(0, item.first, skipDirectory)
+                && std::none_of(itemStore.begin(), itemStore.begin() + namedCount, isSame))
+                itemStore.push_back(item.first.string());
+        }
+        if (vm.count("help") || !(vm.count("serve") || !itemStore.empty() || vm.count("files-from")))
             std::cout << "Requires the directory or file in which to check log4cxx macro usage.\n\n"
                 << GetOptionDescription() << "\n";
+        else if (vm.count("serve"))
+        {
+            if (options.diff || vm.count("lines") || vm.count("lines-from-diff"))
+                throw std::invalid_argument("--diff, --lines and --lines-from-diff cannot be used with --serve");
+            log4cxx::PropertyConfigurator::configure("log4cxx_10_to_11.properties");
+            Serve(vm["serve"].as<StringType>(), options, selector);
+        }
+        else if (vm.count("client"))
+        {
+            if (vm.count("files-from") || !options.changedLines.IsEmpty())
+                throw std::invalid_argument("--files-from, --lines and --lines-from-diff cannot be used with --client");
+            StringType mode = options.fix_10_and_11 ? "both_10_and_11" : options.fix ? "only_11" : "check";
+            ResultReporter reporter(quiet, verbose);
+            RunClient(vm["client"].as<StringType>(), mode, itemStore, reporter);
+            reporter.ReportSummary();
+        }
         else
         {
             log4cxx::PropertyConfigurator::configure("log4cxx_10_to_11.properties");
-            StringStore itemStore = vm["file-or-dir"].as<StringStore>();
-            StringStore extStore = {".cpp", ".cxx", ".hpp", ".h"};
-            if (vm.count("ext"))
+            DirectoryEntryIterator fileIter(itemStore.begin(), itemStore.end(), selector);
+            std::ifstream listFile;
+            if (vm.count("files-from"))
             {
-                StringStore extra = vm["ext"].as<StringStore>();
-                extStore.insert(extStore.end(), extra.begin(), extra.end());
+                StringType listName = vm["files-from"].as<StringType>();
+                if ("-" == listName)
+                    fileIter.SetPathList(std::cin);
+                else
+                {
+                    listFile.open(listName.c_str(), std::ios::binary);
+                    if (!listFile.is_open())
+                        throw ExistsException(listName);
+                    fileIter.SetPathList(listFile);
+                }
             }
-            DirectoryEntrySelectorPtr selector(new ExtensionSelector(extStore.begin(), extStore.end()));
-            DirectoryEntryIterator fileIter(itemStore.begin(), itemStore.end(), selector);
-            for (fileIter.Start(); !fileIter.Off(); fileIter.Forth())
+            ResultReporter reporter(quiet, verbose, !options.cacheDir.empty());
+            std::ofstream patchFile;
+            if (options.diff)
             {
-                CppFile file(fileIter.Item());
-                if (!file.IsValid())
-                    std::cerr << "Skipping invalid " << fileIter.Item() << "\n";
-                 else if (int fixCount = ProcessLog4cxxMacros(file, changeFiles, for_10_and_11))
-                 {
-                     if (!quiet)
-                     {
-                        std::cout << fileIter.Item().string();
-                        if (verbose)
-                            std::cout << ": " << fixCount;
-                        std::cout << "\n";
-                    }
-                    if (changeFiles)
-                        file.StoreFile(fileIter.Item());
+                StringType patchName = vm["diff"].as<StringType>();
+                if ("-" != patchName)
+                {
+                    patchFile.open(patchName.c_str(), std::ios::binary);
+                    if (!patchFile.is_open())
+                        throw std::runtime_error(patchName + ": cannot be created");
                 }
+                reporter.SetPatchStream("-" == patchName ? &std::cout : &patchFile);
+            }
+            PhaseStats::Timer::ClockType::time_point startTime = PhaseStats::Timer::ClockType::now();
+            HardwareCounters counters(options.collectStats && jobCount <= 1);
+            PhaseStats walkStats(&counters);
+            if (options.collectStats)
+            {
+                reporter.SetSlowestCount(size_t(std::max(0, vm["stats"].as<int>())));
+                fileIter.SetStats(&walkStats);
+            }
+            if (1 < jobCount || 0 < options.readAheadDepth) // The walk and reads overlap processing
+                ProcessInParallel(fileIter, jobCount, options, reporter);
+            else
+            {
+                FileProcessor processor(options);
+                for (fileIter.Start(); !fileIter.Off(); fileIter.Forth())
+                    reporter.Report(processor.Process(fileIter.Item()));
             }
+            reporter.ReportSummary();
+            if (options.collectStats)
+                reporter.ReportStats(walkStats, std::chrono::duration<double>(PhaseStats::Timer::ClockType::now() - startTime).count());
         }
         ok = true;
     }
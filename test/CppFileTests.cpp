@@ -1,7 +1,23 @@
 #define BOOST_TEST_MODULE log4cxx_10_to_111 test
 #include <boost/test/unit_test.hpp>
 #include <log4cxx/propertyconfigurator.h>
+#include "util/ChangedLines.h"
 #include "util/CppFile.h"
+#include "util/CppStream.h"
+#include "util/DirectoryEntryIterator.h"
+#include "util/EditSet.h"
+#include "util/FileQueue.h"
+#include "util/LineIndex.h"
+#include "util/LocalSocket.h"
+#include "util/PhaseStats.h"
+#include "util/ReadAhead.h"
+#include "util/RequestServer.h"
+#include "util/ResultCache.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
 
 struct Initialise_log4cxx
 {
@@ -12,6 +28,37 @@ struct Initialise_log4cxx
 };
 BOOST_GLOBAL_FIXTURE( Initialise_log4cxx );
 
+/// A file in the temporary directory that is removed when this goes out of scope
+class TemporaryFile
+{
+private: // Attributes
+    OutputFile::PathType m_path;
+
+public: // ...structors
+    /// A new file holding \c content
+    TemporaryFile(const std::string& content)
+        : m_path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+    { Write(content); }
+
+    /// Remove the file
+    ~TemporaryFile()
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(m_path, ec);
+    }
+
+public: // Accessors
+    /// The location of the file
+    const OutputFile::PathType& GetPath() const { return m_path; }
+
+public: // Modifiers
+    /// Replace the file content with \c content
+    void Write(const std::string& content)
+    {
+        std::ofstream(m_path.c_str(), std::ios::binary) << content;
+    }
+};
+
 BOOST_AUTO_TEST_CASE( fixup_test )
 {
     CppFile file;
@@ -58,3 +105,978 @@ BOOST_AUTO_TEST_CASE( no_change_test )
     BOOST_CHECK_EQUAL(insertBraceCount, 0);
     BOOST_CHECK_EQUAL(terminateStatementCount, 2);
 }
+
+BOOST_AUTO_TEST_CASE( lexer_comparison_test )
+{
+    std::string fixed[2];
+    CppFile::LexerType lexerType[2] = { CppFile::WaveContext, CppFile::LexerOnly };
+    for (int i = 0; i < 2; ++i)
+    {
+        CppFile file(lexerType[i]);
+        BOOST_REQUIRE(file.LoadFile("main_0_10.cpp"));
+        BOOST_CHECK(file.IsValid());
+        BOOST_CHECK_EQUAL(file.GetFunctionCount("LOG4CXX_INFO"), 1);
+        BOOST_CHECK_EQUAL(file.GetFunctionCount("LOG4CXX_DEBUG"), 3);
+        CppFile::FunctionIterator log4cxxMacro(file, "LOG4CXX_");
+        for (log4cxxMacro.Start(); !log4cxxMacro.Off(); log4cxxMacro.Forth())
+        {
+            if (log4cxxMacro.IsCompoundStatementBody())
+                log4cxxMacro.InsertBraces();
+            else if (!log4cxxMacro.HasStatementTerminator())
+                log4cxxMacro.AddSemicolon();
+        }
+        std::ostringstream os;
+        file.Store(os);
+        fixed[i] = os.str();
+    }
+    BOOST_CHECK_EQUAL(fixed[0], fixed[1]);
+}
+
+BOOST_AUTO_TEST_CASE( prefilter_test )
+{
+    IdentifierPrefilter prefilter;
+    prefilter.AddPrefix("LOG4CXX_");
+    prefilter.AddExclusion("LOG4CXX_STR");
+    auto hasCandidate = [&prefilter](const std::string& text)
+    {
+        return prefilter.HasCandidate(text.data(), text.data() + text.size());
+    };
+    BOOST_CHECK(hasCandidate("LOG4CXX_INFO(logger, \"x\")"));
+    BOOST_CHECK(hasCandidate(std::string(100, ' ') + "\n  LOG4CXX_DEBUG(logger, \"x\")" + std::string(100, ' ')));
+    BOOST_CHECK(!hasCandidate("MY_LOG4CXX_INFO(logger, \"x\")"));
+    BOOST_CHECK(!hasCandidate("auto s = LOG4CXX_STR(\"x\");" + std::string(100, ' ')));
+    BOOST_CHECK(!hasCandidate("LOG4CXX"));
+
+    CppFile file;
+    CppFile::FunctionIterator log4cxxMacro(file, "LOG4CXX_");
+    file.SetPrefilter(log4cxxMacro.GetPrefilter());
+    BOOST_REQUIRE(file.LoadFile("main_0_10.cpp"));
+    BOOST_CHECK(!file.IsPrefiltered());
+    BOOST_CHECK_EQUAL(file.GetFunctionCount("LOG4CXX_DEBUG"), 3);
+    file.SetPrefilter(CppFile::FunctionIterator(file, "NO_SUCH_MACRO_").GetPrefilter());
+    BOOST_REQUIRE(file.LoadFile("main_0_10.cpp"));
+    BOOST_CHECK(file.IsPrefiltered());
+    BOOST_CHECK(file.IsValid());
+    BOOST_CHECK_EQUAL(file.GetFunctionCount("LOG4CXX_DEBUG"), 0);
+}
+
+BOOST_AUTO_TEST_CASE( token_table_test )
+{
+    TokenTable tokens;
+    tokens.Append(0, boost::wave::T_IDENTIFIER);
+    tokens.Append(7, boost::wave::T_LEFTPAREN);
+    tokens.Append(8, boost::wave::T_CCOMMENT);
+    tokens.Append(15, boost::wave::T_RIGHTPAREN);
+    tokens.Append(16, boost::wave::T_NEWLINE);
+    tokens.Append(17, boost::wave::T_ANDAND_ALT);
+    BOOST_REQUIRE_EQUAL(tokens.Size(), 6u);
+    BOOST_CHECK_EQUAL(tokens.GetId(0), boost::wave::T_IDENTIFIER);
+    BOOST_CHECK_EQUAL(tokens.GetId(2), boost::wave::T_CCOMMENT);
+    BOOST_CHECK_EQUAL(tokens.GetId(5), boost::wave::T_ANDAND_ALT);
+    BOOST_CHECK(tokens.IsWhitespace(2));
+    BOOST_CHECK(tokens.IsWhitespace(4));
+    BOOST_CHECK_EQUAL(tokens.LowerBound(8), 2u);
+    BOOST_CHECK_EQUAL(tokens.UpperBound(8), 3u);
+    BOOST_CHECK_EQUAL(tokens.LowerBound(18), 6u);
+    BOOST_CHECK_EQUAL(tokens.NextSignificant(1), 3u);
+    BOOST_CHECK_EQUAL(tokens.NextSignificant(3), 5u);
+    BOOST_CHECK_EQUAL(tokens.PreviousSignificant(3), 1u);
+    BOOST_CHECK_EQUAL(tokens.PreviousSignificant(0), tokens.Size());
+    BOOST_CHECK_EQUAL(tokens.PreviousSignificant(tokens.Size()), 5u);
+    BOOST_CHECK_EQUAL(tokens.NextSignificant(5), tokens.Size());
+    BOOST_CHECK_EQUAL(tokens.GetIdOrEnd(tokens.Size()), boost::wave::T_EOI);
+    BOOST_CHECK(TokenTable::IsWhitespaceId(boost::wave::T_CPPCOMMENT));
+    BOOST_CHECK(TokenTable::IsWhitespaceId(boost::wave::T_CONTLINE));
+    BOOST_CHECK(!TokenTable::IsWhitespaceId(boost::wave::T_EOF));
+    bool isOpening = false;
+    BOOST_CHECK_EQUAL(TokenTable::GetBracketKind(tokens.GetId(1), isOpening), TokenTable::Parenthesis);
+    BOOST_CHECK(isOpening);
+    BOOST_CHECK_EQUAL(TokenTable::GetBracketKind(boost::wave::T_RIGHTBRACE_ALT, isOpening), TokenTable::Brace);
+    BOOST_CHECK(!isOpening);
+    BOOST_CHECK_EQUAL(TokenTable::GetBracketKind(tokens.GetId(0), isOpening), TokenTable::NotBracket);
+    BOOST_CHECK_EQUAL(tokens.GetMate(1), tokens.Size());
+    tokens.SetMate(1, 3);
+    BOOST_CHECK_EQUAL(tokens.GetMate(1), 3u);
+    BOOST_CHECK_EQUAL(tokens.GetMate(3), 1u);
+    BOOST_CHECK_EQUAL(tokens.GetMate(0), tokens.Size());
+}
+
+BOOST_AUTO_TEST_CASE( identifier_table_test )
+{
+    std::string content = "LOG4CXX_INFO LOG4CXX_STR x LOG4CXX_INFO LOG4CXX_DEBUG y LOG4CXX";
+    IdentifierTable identifiers;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        identifiers.Clear();
+        size_t start = 0;
+        for (size_t i = 0; i <= content.size(); ++i)
+        {
+            if (i == content.size() || ' ' == content[i])
+            {
+                identifiers.Add(IdentifierTable::NameType(content.data() + start, i - start), start);
+                start = i + 1;
+            }
+        }
+        identifiers.Index();
+        BOOST_REQUIRE_EQUAL(identifiers.Size(), 6u);
+        size_t info = identifiers.Find("LOG4CXX_INFO");
+        BOOST_REQUIRE(info < identifiers.Size());
+        BOOST_CHECK_EQUAL(identifiers.GetInstanceCount(info), 2u);
+        BOOST_CHECK_EQUAL(*identifiers.BeginInstance(info), 0u);
+        BOOST_CHECK_EQUAL(*(identifiers.EndInstance(info) - 1), 27u);
+        BOOST_CHECK_EQUAL(identifiers.Find("LOG4CXX_WARN"), identifiers.Size());
+        IdentifierTable::RangeType range = identifiers.GetPrefixRange("LOG4CXX_");
+        BOOST_CHECK_EQUAL(range.second - range.first, 3u);
+        for (size_t rank = range.first; rank < range.second; ++rank)
+            BOOST_CHECK_EQUAL(identifiers.GetName(rank).substr(0, 8), "LOG4CXX_");
+        range = identifiers.GetPrefixRange("z");
+        BOOST_CHECK_EQUAL(range.first, range.second);
+    }
+
+    // Clearing after many identifiers shrinks the hash table, which still works when refilled
+    std::vector<std::string> names;
+    for (int i = 0; i < 10000; ++i)
+        names.push_back("id" + std::to_string(i));
+    identifiers.Clear();
+    for (size_t i = 0; i < names.size(); ++i)
+        identifiers.Add(names[i], i);
+    identifiers.Index();
+    BOOST_CHECK_EQUAL(identifiers.Size(), names.size());
+    identifiers.Clear();
+    identifiers.Clear();
+    for (size_t i = 0; i < 1000; ++i)
+        identifiers.Add(names[i], i);
+    identifiers.Add(names[7], 1000);
+    identifiers.Index();
+    BOOST_CHECK_EQUAL(identifiers.Size(), 1000u);
+    BOOST_CHECK_EQUAL(identifiers.GetInstanceCount(identifiers.Find("id7")), 2u);
+}
+
+BOOST_AUTO_TEST_CASE( input_comparison_test )
+{
+    std::string stored[2];
+    CppFile::InputType inputType[2] = { CppFile::MappedInput, CppFile::BufferedInput };
+    for (int i = 0; i < 2; ++i)
+    {
+        CppFile file(CppFile::LexerOnly, inputType[i]);
+        BOOST_REQUIRE(file.LoadFile("main_0_10.cpp"));
+        BOOST_CHECK_EQUAL(file.GetFunctionCount("LOG4CXX_DEBUG"), 3);
+        CppFile::FunctionIterator log4cxxMacro(file, "LOG4CXX_");
+        for (log4cxxMacro.Start(); !log4cxxMacro.Off(); log4cxxMacro.Forth())
+            if (!log4cxxMacro.HasStatementTerminator())
+                log4cxxMacro.AddSemicolon();
+        std::ostringstream os;
+        file.Store(os);
+        stored[i] = os.str();
+    }
+    BOOST_CHECK_EQUAL(stored[0], stored[1]);
+    BOOST_CHECK(!CppFile().LoadFile("no_such_file.cpp"));
+}
+
+BOOST_AUTO_TEST_CASE( file_queue_test )
+{
+    typedef FileQueue<std::string> QueueType;
+    const uintmax_t sizes[] = { 30, 10, 50, 20, 40 };
+    QueueType queue(5);
+    for (size_t i = 0; i < 5; ++i)
+        queue.Add("f" + std::to_string(i), sizes[i]);
+
+    // Adding beyond the capacity waits for a result to be removed
+    std::atomic<bool> isAdded(false);
+    std::thread adder([&queue, &isAdded]()
+    {
+        queue.Add("f5", 60);
+        isAdded = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK(!isAdded);
+
+    // The largest file is started first
+    std::vector<QueueType::JobType> jobs(5);
+    for (auto& job : jobs)
+        BOOST_REQUIRE(queue.NextJob(job));
+    const size_t startOrder[] = { 2, 4, 0, 3, 1 };
+    for (size_t i = 0; i < 5; ++i)
+        BOOST_CHECK_EQUAL(jobs[i].sequence, startOrder[i]);
+
+    // Results completed out of order on several threads are removed in the order the files were added
+    std::vector<std::thread> workers;
+    for (auto& job : jobs)
+        workers.emplace_back([&queue, &job]() { queue.Complete(job.sequence, std::string(job.path.string())); });
+    for (auto& worker : workers)
+        worker.join();
+    std::string result;
+    BOOST_REQUIRE(queue.NextResult(result));
+    BOOST_CHECK_EQUAL(result, "f0");
+    adder.join();
+    BOOST_CHECK(isAdded);
+    QueueType::JobType job;
+    BOOST_REQUIRE(queue.NextJob(job));
+    BOOST_CHECK_EQUAL(job.sequence, 5u);
+    queue.Complete(job.sequence, std::string(job.path.string()));
+    queue.Close();
+    for (size_t i = 1; i < 6; ++i)
+    {
+        BOOST_REQUIRE(queue.NextResult(result));
+        BOOST_CHECK_EQUAL(result, "f" + std::to_string(i));
+    }
+    BOOST_CHECK(!queue.NextResult(result));
+    BOOST_CHECK(!queue.NextJob(job));
+}
+
+BOOST_AUTO_TEST_CASE( output_file_test )
+{
+    OutputFile::SpanStore spans = { "int main()", "\n", "{ return 0; }\n" };
+    BOOST_CHECK(OutputFile::IsSameContent(spans, "int main()\n{ return 0; }\n"));
+    BOOST_CHECK(!OutputFile::IsSameContent(spans, "int main()\n{ return 0; }"));
+    BOOST_CHECK(!OutputFile::IsSameContent(spans, "int main()\n{ return 0; }\n\n"));
+
+    OutputFile::PathType path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    OutputFile output(path);
+    BOOST_REQUIRE(output.Store(spans));
+    BOOST_CHECK(output.IsChanged());
+    BOOST_REQUIRE(output.Store(spans));
+    BOOST_CHECK(!output.IsChanged());
+    spans.pop_back();
+    BOOST_REQUIRE(output.Store(spans));
+    BOOST_CHECK(output.IsChanged());
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), 11u);
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE( result_cache_test )
+{
+    std::string content = "LOG4CXX_INFO(m_log, \"message\")\n";
+    ContentHash::ValueType hash = ContentHash::Compute(content.data(), content.size());
+    BOOST_CHECK(hash == ContentHash::Compute(content.data(), content.size()));
+    BOOST_CHECK(!(hash == ContentHash::Compute(content.data(), content.size() - 1)));
+    BOOST_CHECK_EQUAL(ContentHash::ToString(hash).size(), 32u);
+
+    ResultCache::PathType directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    ResultCache cache(directory, "prefix=LOG4CXX_");
+    ResultCache otherRules(directory, "prefix=LOG4CXX_ fix=1");
+    ResultCache::KeyType key = cache.GetKey(content);
+    BOOST_CHECK(!(key == otherRules.GetKey(content)));
+    ResultCache::ValueType value{0, 0};
+    BOOST_CHECK(!cache.Find(key, value));
+    BOOST_REQUIRE(cache.Store(key, ResultCache::ValueType{3, 2}));
+    BOOST_REQUIRE(cache.Find(key, value));
+    BOOST_CHECK_EQUAL(value.macroCount, 3);
+    BOOST_CHECK_EQUAL(value.fixCount, 2);
+    BOOST_CHECK(!otherRules.Find(otherRules.GetKey(content), value));
+    boost::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE( directory_walk_test )
+{
+    namespace fs = boost::filesystem;
+    fs::path root = fs::temp_directory_path() / fs::unique_path();
+    for (auto dir : { "a/b/c", "a/d", "e" })
+        fs::create_directories(root / dir);
+    for (auto file : { "a/b/c/1.cpp", "a/b/2.h", "a/b/3.txt", "a/d/4.cpp", "e/5.hpp", "6.cpp" })
+        std::ofstream(fs::path(root / file).c_str()) << "int i;\n";
+    boost::system::error_code ec;
+    fs::create_symlink(root / "a/b/2.h", root / "e/7.h", ec);
+    fs::create_directory_symlink(root / "a", root / "e/8", ec); // Not followed
+
+    std::vector<std::string> extensions = { ".cpp", ".h", ".hpp" };
+    DirectoryEntrySelectorPtr selector(new ExtensionSelector(extensions.begin(), extensions.end()));
+    std::vector<fs::path> expected;
+    for (fs::recursive_directory_iterator pItem(root), end; end != pItem; ++pItem)
+    {
+        bool skipDirectory = false;
+        if (selector->IsIncluded(pItem.level(), pItem->path(), skipDirectory))
+            expected.push_back(pItem->path());
+    }
+    BOOST_CHECK_EQUAL(expected.size(), ec ? 5u : 6u);
+    for (int threadCount : { 0, 1, 4 })
+    {
+        DirectoryEntryIterator fileIter(root, selector);
+        fileIter.SetThreadCount(threadCount);
+        std::vector<fs::path> walked;
+        for (fileIter.Start(); !fileIter.Off(); fileIter.Forth())
+            walked.push_back(fileIter.Item());
+        BOOST_CHECK_EQUAL_COLLECTIONS(walked.begin(), walked.end(), expected.begin(), expected.end());
+    }
+
+    DirectoryEntryIterator shallowIter(root, DirectoryEntrySelectorPtr(new DirectoryEntrySelector(0)));
+    size_t shallowCount = 0;
+    for (shallowIter.Start(); !shallowIter.Off(); shallowIter.Forth())
+        ++shallowCount;
+    BOOST_CHECK_EQUAL(shallowCount, 3u);
+    fs::remove_all(root);
+}
+
+BOOST_AUTO_TEST_CASE( path_list_test )
+{
+    for (auto list : { std::string("main_0_10.cpp\nno_such_file.cpp\r\n\nmain_0_11.cpp\n")
+                     , std::string("main_0_10.cpp\0no_such_file.cpp\0main_0_11.cpp", 44) })
+    {
+        std::istringstream is(list);
+        std::vector<DirectoryEntryIterator::PathType> none;
+        DirectoryEntryIterator fileIter(none.begin(), none.end());
+        fileIter.SetPathList(is);
+        std::vector<std::string> listed;
+        for (fileIter.Start(); !fileIter.Off(); fileIter.Forth())
+            listed.push_back(fileIter.Item().string());
+        std::vector<std::string> expected = { "main_0_10.cpp", "no_such_file.cpp", "main_0_11.cpp" };
+        BOOST_CHECK_EQUAL_COLLECTIONS(listed.begin(), listed.end(), expected.begin(), expected.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( phase_stats_test )
+{
+    HardwareCounters counters;
+    PhaseStats stats(&counters);
+    {
+        PhaseStats::Timer timer(&stats, PhaseStats::Lex);
+        PhaseStats::Timer ignored(0, PhaseStats::Lex);
+        CppFile file;
+        BOOST_REQUIRE(file.LoadFile("main_0_10.cpp"));
+        stats.AddCount(PhaseStats::Tokens, file.GetTokenCount());
+    }
+    BOOST_CHECK(0 < stats.GetPhase(PhaseStats::Lex).seconds);
+    BOOST_CHECK_EQUAL(stats.GetPhase(PhaseStats::Read).seconds, 0);
+    BOOST_CHECK_EQUAL(stats.HasEvents(), counters.IsAvailable());
+    PhaseStats total;
+    total.Add(stats);
+    total.Add(stats);
+    BOOST_CHECK_EQUAL(total.GetCount(PhaseStats::Tokens), 2 * stats.GetCount(PhaseStats::Tokens));
+
+    std::ostringstream os;
+    PhaseStats::WriteJsonString(os, "a\"b\\c\n");
+    BOOST_CHECK_EQUAL(os.str(), "\"a\\\"b\\\\c\\u000a\"");
+}
+
+BOOST_AUTO_TEST_CASE( macro_rule_set_test )
+{
+    PatternMatcher matcher({ "he", "she", "his", "hers" });
+    std::string text = "ushers";
+    std::vector<std::pair<size_t, std::string>> found;
+    matcher.FindEach(text.data(), text.data() + text.size(), [&](const char* p, uint32_t index)
+    {
+        found.emplace_back(p - text.data(), matcher.GetPattern(index));
+        return false;
+    });
+    std::vector<std::pair<size_t, std::string>> expected = { {1, "she"}, {2, "he"}, {2, "hers"} };
+    BOOST_CHECK(found == expected);
+
+    MacroRuleSet rules;
+    std::istringstream ruleFile
+        ( "# Logging macros\n"
+          "macro LOG4CXX_ both\n"
+          "exclude LOG4CXX_STR\n"
+          "macro LOG4CXX_STREAM_ terminate # nested in an exclusion\n"
+          "macro MYCO_LOG_\n"
+        );
+    rules.Load(ruleFile, "rules");
+    BOOST_REQUIRE_EQUAL(rules.Size(), 4u);
+    BOOST_CHECK_EQUAL(rules.FindRule("LOG4CXX_INFO"), 0u);
+    BOOST_CHECK_EQUAL(rules.FindRule("LOG4CXX_STR"), MacroRuleSet::NoRule);
+    BOOST_CHECK_EQUAL(rules.FindRule("LOG4CXX_STREAM_INFO"), 2u);
+    BOOST_CHECK_EQUAL(rules.FindRule("MYCO_LOG_WARN"), 3u);
+    BOOST_CHECK_EQUAL(rules.FindRule("MYCO_TRACE"), MacroRuleSet::NoRule);
+    std::istringstream badRule("macro LOG4CXX_ sometimes\n");
+    BOOST_CHECK_THROW(rules.Load(badRule, "bad"), std::invalid_argument);
+
+    IdentifierPrefilter prefilter = rules.GetPrefilter();
+    auto hasCandidate = [&prefilter](const std::string& text)
+    {
+        return prefilter.HasCandidate(text.data(), text.data() + text.size());
+    };
+    BOOST_CHECK(hasCandidate("x = 1; MYCO_LOG_WARN(x)"));
+    BOOST_CHECK(hasCandidate("LOG4CXX_STREAM_INFO(x)"));
+    BOOST_CHECK(!hasCandidate("LOG4CXX_STR(\"x\") + NOT_MYCO_LOG_WARN(x)"));
+
+    CppFile file;
+    CppFile::FunctionIterator macro(file, rules);
+    file.SetPrefilter(macro.GetPrefilter());
+    BOOST_REQUIRE(file.LoadFile("main_0_10.cpp"));
+    size_t macroCount = 0;
+    for (macro.Start(); !macro.Off(); macro.Forth())
+    {
+        ++macroCount;
+        BOOST_CHECK_EQUAL(macro.GetRule().prefix, "LOG4CXX_");
+        BOOST_CHECK_EQUAL(macro.GetRule().action, MacroRuleSet::Both);
+    }
+    BOOST_CHECK_EQUAL(macroCount, 4u);
+}
+
+BOOST_AUTO_TEST_CASE( stream_test )
+{
+    std::ifstream original("main_0_10.cpp", std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(original)), std::istreambuf_iterator<char>());
+    content += "if (x)\n"
+        "    LOG4CXX_WARN(logger, /* a comment\n  spanning lines */ \"a \\\n continued string\")\n"
+        "else LOG4CXX_INFO(logger, R\"(raw\n text)\")\n"
+        "#define LOG4CXX_X(x) x\n"
+        "for (;;) LOG4CXX_ERROR(logger, (x) << '\\n')";
+    TemporaryFile source(content);
+    const OutputFile::PathType& path = source.GetPath();
+    MacroRuleSet rules;
+    rules.AddFamily("LOG4CXX_");
+    rules.AddExclusion("LOG4CXX_STR");
+    for (MacroRuleSet::ActionType action : { MacroRuleSet::Terminate, MacroRuleSet::Both })
+    {
+        CppFile file(CppFile::LexerOnly);
+        BOOST_REQUIRE(file.LoadFile(path));
+        CppFile::FunctionIterator macro(file, rules);
+        int macroCount = 0, fixCount = 0;
+        for (macro.Start(); !macro.Off(); macro.Forth())
+        {
+            ++macroCount;
+            if (macro.HasStatementTerminator())
+                continue;
+            ++fixCount;
+            macro.AddSemicolon();
+            if ((action & MacroRuleSet::Brace) && macro.IsCompoundStatementBody())
+                macro.InsertBraces();
+        }
+        BOOST_CHECK_EQUAL(macroCount, 7);
+        std::ostringstream expected;
+        file.Store(expected);
+        for (size_t chunkSize : { 1, 7, 64, 1 << 20 })
+        {
+            CppStream stream(rules, chunkSize);
+            stream.SetFix(true, MacroRuleSet::Both == action);
+            std::istringstream is(content);
+            std::string output;
+            BOOST_REQUIRE(stream.Process(is, [&output](const OutputFile::SpanStore& spans)
+            {
+                for (auto& span : spans)
+                    output.append(span.data(), span.size());
+                return true;
+            }));
+            BOOST_CHECK_EQUAL(stream.GetMacroCount(), macroCount);
+            BOOST_CHECK_EQUAL(stream.GetFixCount(), fixCount);
+            BOOST_CHECK_EQUAL(output, expected.str());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( arena_test )
+{
+    Arena arena(100);
+    std::pmr::vector<double> numbers(&arena);
+    for (int i = 0; i < 100; ++i)
+        numbers.push_back(i);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(numbers.data()) % alignof(double), 0u);
+    BOOST_CHECK_EQUAL(arena.Copy("text"), "text");
+    BOOST_CHECK(1 < arena.GetBlockAllocationCount());
+    size_t used = arena.GetUsed();
+    numbers = std::pmr::vector<double>(&arena);
+    arena.Rewind();
+    BOOST_CHECK_EQUAL(arena.GetUsed(), 0u);
+    BOOST_CHECK_EQUAL(arena.GetHighWater(), used);
+    BOOST_CHECK(used <= arena.GetCapacity());
+    size_t blockAllocationCount = arena.GetBlockAllocationCount();
+    for (int i = 0; i < 100; ++i)
+        numbers.push_back(i);
+    arena.Copy("text");
+    BOOST_CHECK_EQUAL(arena.GetBlockAllocationCount(), blockAllocationCount);
+
+    CppFile file;
+    std::string fixed[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        BOOST_REQUIRE(file.LoadFile("main_0_10.cpp"));
+        CppFile::FunctionIterator log4cxxMacro(file, "LOG4CXX_");
+        for (log4cxxMacro.Start(); !log4cxxMacro.Off(); log4cxxMacro.Forth())
+            if (log4cxxMacro.IsCompoundStatementBody())
+                log4cxxMacro.InsertBraces();
+        std::ostringstream os;
+        file.Store(os);
+        fixed[i] = os.str();
+        if (0 == i)
+            blockAllocationCount = file.GetArena().GetBlockAllocationCount();
+    }
+    BOOST_CHECK_EQUAL(fixed[0], fixed[1]);
+    BOOST_CHECK_EQUAL(file.GetArena().GetBlockAllocationCount(), blockAllocationCount);
+    BOOST_CHECK(0 < file.GetArena().GetUsed());
+    file.Reset();
+    BOOST_CHECK_EQUAL(file.GetArena().GetUsed(), 0u);
+    BOOST_CHECK_EQUAL(file.GetContentSize(), 0u);
+
+    PhaseStats stats, total;
+    stats.AddPeak(PhaseStats::ArenaBytes, 10);
+    total.Add(stats);
+    total.Add(stats);
+    BOOST_CHECK_EQUAL(total.GetPeak(PhaseStats::ArenaBytes), 10u);
+}
+
+BOOST_AUTO_TEST_CASE( edit_log_test )
+{
+    // Edits are made one macro name at a time, so arrive out of content order
+    std::string content, expected;
+    for (int i = 0; i < 300; ++i)
+    {
+        std::string call = std::string("LOG4CXX_") + (i % 2 ? "INFO" : "DEBUG") + "(logger, " + std::to_string(i) + ")";
+        content += "if (x)\n    " + call + "\n";
+        expected += "if (x)\n{\n    " + call + ";\n}\n";
+    }
+    TemporaryFile source(content);
+    const OutputFile::PathType& path = source.GetPath();
+    CppFile file;
+    BOOST_REQUIRE(file.LoadFile(path));
+    CppFile::FunctionIterator log4cxxMacro(file, "LOG4CXX_");
+    for (log4cxxMacro.Start(); !log4cxxMacro.Off(); log4cxxMacro.Forth())
+    {
+        BOOST_CHECK(!log4cxxMacro.HasStatementTerminator());
+        log4cxxMacro.AddSemicolon();
+        BOOST_CHECK(log4cxxMacro.IsCompoundStatementBody());
+        log4cxxMacro.InsertBraces();
+    }
+    std::ostringstream os;
+    file.Store(os);
+    BOOST_CHECK(os.str() == expected);
+
+    // Removing the changes already output keeps the order of those remaining
+    EditSet edits;
+    edits.AppendText(5, "a");
+    edits.InsertText(20, "c");
+    edits.InsertText(2, "b");
+    edits.InsertText(20, "d");
+    edits.AppendText(19, "e");
+    edits.RemoveBefore(10);
+    BOOST_CHECK_EQUAL(edits.Size(), 3u);
+    BOOST_CHECK(!edits.HasUpdateBetween(0, 18));
+    BOOST_CHECK(edits.HasUpdateBetween(19, 19));
+    edits.InsertText(20, "f");
+    std::string remaining;
+    for (auto& update : edits.GetSortedUpdates())
+        remaining.append(update.text.data(), update.text.size());
+    BOOST_CHECK_EQUAL(remaining, "efdc");
+    edits.RemoveBefore(size_t(-1));
+    BOOST_CHECK(edits.IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE( line_index_test )
+{
+    // CRLF line breaks and no final line feed
+    std::string content = "a\r\nbc\r\n\r\nlast";
+    LineIndex index;
+    index.Assign(content.data(), content.data() + content.size());
+    BOOST_CHECK_EQUAL(index.GetLineCount(), 4);
+    BOOST_CHECK_EQUAL(index.GetLineStart(2), 3);
+    BOOST_CHECK_EQUAL(index.GetLineStart(5), content.size());
+    BOOST_CHECK_EQUAL(index.GetLine(2), 1); // The carriage return ends line 1
+    BOOST_CHECK_EQUAL(index.GetLine(3), 2);
+    BOOST_CHECK_EQUAL(index.GetLine(content.size() - 1), 4);
+    BOOST_CHECK_EQUAL(index.GetLine(0), 1);
+    BOOST_CHECK_EQUAL(index.GetIndex(4, 2), content.size() - 3);
+    content += '\n'; // An empty last line
+    index.Assign(content.data(), content.data() + content.size());
+    BOOST_CHECK_EQUAL(index.GetLineCount(), 5);
+    BOOST_CHECK_EQUAL(index.GetLineStart(5), content.size());
+    index.Clear();
+    BOOST_CHECK_EQUAL(index.GetLine(0), 0);
+
+    // The vectorized kernel agrees with a simple scan at every alignment and line length
+    std::string text;
+    for (size_t i = 0; i < 5000; ++i)
+        text += (i * 7919) % 37 < 3 ? '\n' : char('a' + i % 26);
+    for (size_t offset = 0; offset < 33; ++offset)
+    {
+        const char* first = text.data() + offset;
+        std::vector<size_t> expected{0};
+        for (size_t i = offset; i < text.size(); ++i)
+            if ('\n' == text[i])
+                expected.push_back(i + 1 - offset);
+        index.Assign(first, text.data() + text.size());
+        BOOST_REQUIRE_EQUAL(index.GetLineCount(), expected.size());
+        for (size_t line = 1; line <= expected.size(); ++line)
+            BOOST_CHECK_EQUAL(index.GetLineStart(line), expected[line - 1]);
+        // Ascending and descending translation with a hint
+        size_t hint = 0;
+        for (size_t i = 0; i < text.size() - offset; i += 5)
+            BOOST_CHECK_EQUAL(index.GetLine(i, &hint), std::upper_bound(expected.begin(), expected.end(), i) - expected.begin());
+        for (size_t i = text.size() - offset; 11 < i; i -= 11)
+            BOOST_CHECK_EQUAL(index.GetLine(i, &hint), std::upper_bound(expected.begin(), expected.end(), i) - expected.begin());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( read_ahead_test )
+{
+    boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directory(dir);
+    std::vector<std::string> contents;
+    for (size_t i = 0; i < 40; ++i)
+    {
+        contents.push_back(std::string(i * i * 997, char('a' + i % 26)));
+        std::ofstream((dir / std::to_string(i)).c_str(), std::ios::binary) << contents.back();
+    }
+    for (auto method : {ReadAhead::ThreadPool, ReadAhead::IoUring})
+    {
+        ReadAhead readAhead(4, method);
+        BOOST_TEST_MESSAGE("read_ahead_test: " << readAhead.GetMethodName());
+        for (size_t i = 0; i < contents.size(); ++i)
+            readAhead.Add(i, dir / std::to_string(i));
+        readAhead.Add(contents.size(), dir / "missing");
+        readAhead.Close();
+        readAhead.WaitForReads();
+        InputFile input;
+        BOOST_CHECK(!readAhead.Take(contents.size(), input));
+        BOOST_CHECK(!readAhead.Take(contents.size() + 1, input)); // Never added
+        for (size_t i = contents.size(); 0 < i--; )
+        {
+            BOOST_REQUIRE(readAhead.Take(i, input));
+            BOOST_CHECK(input.GetContent() == contents[i]);
+        }
+        BOOST_CHECK(!readAhead.Take(0, input)); // Already taken
+    }
+    boost::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE( concurrent_analysis_test )
+{
+    std::string content;
+    for (int i = 0; i < 200; ++i)
+        content += std::string("if (x)\n    LOG4CXX_") + (i % 2 ? "INFO" : "DEBUG") + "(logger, " + std::to_string(i) + ")\n";
+    TemporaryFile source(content);
+    const OutputFile::PathType& path = source.GetPath();
+    auto analyse = [](CppFile::FunctionIterator& macro)
+    {
+        for (macro.Start(); !macro.Off(); macro.Forth())
+        {
+            macro.AddSemicolon();
+            if (macro.IsCompoundStatementBody())
+                macro.InsertBraces();
+        }
+    };
+    // One analysis of both macro families
+    CppFile file;
+    BOOST_REQUIRE(file.LoadFile(path));
+    CppFile::FunctionIterator log4cxxMacro(file, "LOG4CXX_");
+    analyse(log4cxxMacro);
+    std::ostringstream expected;
+    file.Store(expected);
+
+    // An analysis of each family in parallel, sharing one lexing pass
+    BOOST_REQUIRE(file.LoadFile(path));
+    const CppFile& snapshot = file;
+    std::vector<std::string> families{"LOG4CXX_INFO", "LOG4CXX_DEBUG"};
+    std::vector<std::unique_ptr<EditSet>> edits;
+    std::vector<std::thread> analysers;
+    for (auto& family : families)
+    {
+        edits.emplace_back(new EditSet);
+        MacroRuleSet rules;
+        rules.AddFamily(family);
+        analysers.emplace_back([&snapshot, &analyse, rules, pEdits = edits.back().get()]()
+        {
+            CppFile::FunctionIterator macro(snapshot, *pEdits, rules);
+            analyse(macro);
+        });
+    }
+    for (auto& analyser : analysers)
+        analyser.join();
+    BOOST_CHECK(file.GetEdits().IsEmpty());
+    for (auto& pEdits : edits)
+    {
+        BOOST_CHECK_EQUAL(pEdits->Size(), 300u); // A semicolon and two braces for each macro
+        file.Merge(*pEdits);
+    }
+    std::ostringstream merged;
+    file.Store(merged);
+    BOOST_CHECK(merged.str() == expected.str());
+}
+
+BOOST_AUTO_TEST_CASE( changed_lines_test )
+{
+    ChangedLines lines;
+    BOOST_CHECK_EQUAL(lines.AddSpecification("dir/../a.cpp:3,5-7"), "dir/../a.cpp");
+    BOOST_CHECK_THROW(lines.AddSpecification("a.cpp:7-5"), std::invalid_argument);
+    BOOST_CHECK_THROW(lines.AddSpecification("a.cpp"), std::invalid_argument);
+    std::istringstream diff
+        ( "diff --git a/b.cpp b/b.cpp\n"
+          "--- a/b.cpp\n"
+          "+++ b/b.cpp\n"
+          "@@ -10,3 +10,4 @@ void f()\n"
+          " context\n"
+          "-removed\n"
+          "+added\n"
+          "+added\n"
+          " context\n"
+          "@@ -30 +31,0 @@\n"
+          "-removed\n"
+          "--- a/c.cpp\n"
+          "+++ /dev/null\n"
+          "@@ -1 +0,0 @@\n"
+          "-removed\n"
+        );
+    lines.AddDiff(diff);
+    const CppFile::LineRangeStore* ranges = lines.Find("a.cpp");
+    BOOST_REQUIRE(ranges);
+    BOOST_REQUIRE_EQUAL(ranges->size(), 2u);
+    BOOST_CHECK_EQUAL(ranges->back().first, 5u);
+    BOOST_CHECK_EQUAL(ranges->back().last, 7u);
+    ranges = lines.Find("b.cpp");
+    BOOST_REQUIRE(ranges);
+    BOOST_REQUIRE_EQUAL(ranges->size(), 2u);
+    BOOST_CHECK_EQUAL(ranges->front().first, 10u);
+    BOOST_CHECK_EQUAL(ranges->front().last, 12u);
+    BOOST_CHECK_EQUAL(ranges->back().first, 31u);
+    BOOST_CHECK(!lines.Find("c.cpp"));
+
+    // Only the macros on the lines are checked, skipping a comment that hides one
+    std::string content;
+    for (int i = 0; i < 30; ++i)
+        content += "f(1);\n";
+    content += "/*\n";
+    for (int i = 0; i < 30; ++i)
+        content += "LOG4CXX_INFO(logger, \"(\")\n";
+    content += "*/\nLOG4CXX_INFO(logger, 1)\nLOG4CXX_INFO(logger, 2)\n";
+    TemporaryFile source(content);
+    const OutputFile::PathType& path = source.GetPath();
+    CppFile file;
+    file.SetLineRanges(CppFile::LineRangeStore{CppFile::LineRange{64, 64}});
+    BOOST_REQUIRE(file.LoadFile(path));
+    BOOST_CHECK(file.IsValid());
+    CppFile::FunctionIterator log4cxxMacro(file, "LOG4CXX_");
+    int macroCount = 0;
+    for (log4cxxMacro.Start(); !log4cxxMacro.Off(); log4cxxMacro.Forth())
+    {
+        ++macroCount;
+        BOOST_CHECK_EQUAL(log4cxxMacro.Item().identifier.line, 64u);
+        log4cxxMacro.AddSemicolon();
+    }
+    BOOST_CHECK_EQUAL(macroCount, 1);
+    BOOST_CHECK(file.GetTokenCount() < 20);
+    std::ostringstream os;
+    file.Store(os);
+    BOOST_CHECK(os.str() == content.substr(0, content.size() - 1) + ";\n");
+
+    // A call is checked when any of its lines is in a range, even if it starts before the context lines
+    content.clear();
+    for (int i = 0; i < 30; ++i)
+        content += "f(1);\n";
+    content += "LOG4CXX_INFO(logger,\n";
+    for (int i = 0; i < 20; ++i)
+        content += "    \"x\" <<\n";
+    content += "    2)\nf(3);\n";
+    source.Write(content);
+    file.SetLineRanges(CppFile::LineRangeStore{CppFile::LineRange{52, 52}});
+    BOOST_REQUIRE(file.LoadFile(path));
+    BOOST_CHECK(file.IsValid());
+    macroCount = 0;
+    for (log4cxxMacro.Start(); !log4cxxMacro.Off(); log4cxxMacro.Forth())
+    {
+        ++macroCount;
+        BOOST_CHECK_EQUAL(log4cxxMacro.Item().identifier.line, 31u);
+        BOOST_CHECK_EQUAL(log4cxxMacro.Item().paramEnd.line, 52u);
+        BOOST_CHECK(!log4cxxMacro.HasStatementTerminator());
+    }
+    BOOST_CHECK_EQUAL(macroCount, 1);
+    file.SetLineRanges(CppFile::LineRangeStore{CppFile::LineRange{53, 53}});
+    BOOST_REQUIRE(file.LoadFile(path));
+    log4cxxMacro.Start();
+    BOOST_CHECK(log4cxxMacro.Off());
+}
+
+BOOST_AUTO_TEST_CASE( diff_output_test )
+{
+    std::string content
+        ( "int f()\n"
+          "{\n"
+          "    if (x)\n"
+          "        LOG4CXX_INFO(logger, 1)\n"
+          "    return 0;\n"
+          "}\n"
+          "\n"
+          "\n"
+          "\n"
+          "\n"
+          "\n"
+          "LOG4CXX_INFO(logger, 2)"
+        );
+    TemporaryFile source(content);
+    const OutputFile::PathType& path = source.GetPath();
+    CppFile file;
+    BOOST_REQUIRE(file.LoadFile(path));
+    std::ostringstream unchanged;
+    file.StoreDiff(unchanged, "a/f.cpp", "b/f.cpp");
+    BOOST_CHECK(unchanged.str().empty());
+    CppFile::FunctionIterator log4cxxMacro(file, "LOG4CXX_");
+    for (log4cxxMacro.Start(); !log4cxxMacro.Off(); log4cxxMacro.Forth())
+    {
+        log4cxxMacro.AddSemicolon();
+        if (log4cxxMacro.IsCompoundStatementBody())
+            log4cxxMacro.InsertBraces();
+    }
+    std::ostringstream os;
+    file.StoreDiff(os, "a/f.cpp", "b/f.cpp");
+    BOOST_CHECK_EQUAL(os.str(),
+        "--- a/f.cpp\n"
+        "+++ b/f.cpp\n"
+        "@@ -1,7 +1,9 @@\n"
+        " int f()\n"
+        " {\n"
+        "     if (x)\n"
+        "-        LOG4CXX_INFO(logger, 1)\n"
+        "+    {\n"
+        "+        LOG4CXX_INFO(logger, 1);\n"
+        "+    }\n"
+        "     return 0;\n"
+        " }\n"
+        " \n"
+        "@@ -9,4 +11,4 @@\n"
+        " \n"
+        " \n"
+        " \n"
+        "-LOG4CXX_INFO(logger, 2)\n"
+        "\\ No newline at end of file\n"
+        "+LOG4CXX_INFO(logger, 2);\n"
+        "\\ No newline at end of file\n"
+        );
+
+    // Changes on adjacent lines are one block of removals followed by the additions
+    content =
+        "void g()\n"
+        "{\n"
+        "    LOG4CXX_INFO(logger, 1)\n"
+        "    LOG4CXX_INFO(logger, 2)\n"
+        "}\n";
+    source.Write(content);
+    BOOST_REQUIRE(file.LoadFile(path));
+    for (log4cxxMacro.Start(); !log4cxxMacro.Off(); log4cxxMacro.Forth())
+        log4cxxMacro.AddSemicolon();
+    std::ostringstream adjacent;
+    file.StoreDiff(adjacent, "a/g.cpp", "b/g.cpp");
+    BOOST_CHECK_EQUAL(adjacent.str(),
+        "--- a/g.cpp\n"
+        "+++ b/g.cpp\n"
+        "@@ -1,5 +1,5 @@\n"
+        " void g()\n"
+        " {\n"
+        "-    LOG4CXX_INFO(logger, 1)\n"
+        "-    LOG4CXX_INFO(logger, 2)\n"
+        "+    LOG4CXX_INFO(logger, 1);\n"
+        "+    LOG4CXX_INFO(logger, 2);\n"
+        " }\n"
+        );
+}
+
+#if !defined(_WIN32)
+BOOST_AUTO_TEST_CASE( local_socket_test )
+{
+    LocalSocket::PathType path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    LocalSocket listener;
+    BOOST_REQUIRE(listener.Listen(path));
+    std::string block(100000, 'x');
+    std::thread sender([&path, &block]()
+    {
+        LocalSocket client;
+        if (!client.Connect(path))
+            return;
+        client.Write("buffer ");
+        client.Write(std::to_string(block.size()) + "\n");
+        client.Write(block);
+        client.Write("end\n");
+        client.Shutdown();
+        std::string line;
+        client.ReadLine(line);
+    });
+    LocalSocket connection;
+    BOOST_REQUIRE(listener.Accept(connection));
+    std::string line, data;
+    BOOST_REQUIRE(connection.ReadLine(line));
+    BOOST_CHECK_EQUAL(line, "buffer 100000");
+    BOOST_REQUIRE(connection.ReadBlock(block.size(), data));
+    BOOST_CHECK(data == block);
+    BOOST_REQUIRE(connection.ReadLine(line));
+    BOOST_CHECK_EQUAL(line, "end");
+    BOOST_CHECK(!connection.ReadLine(line));
+    connection.Write("done\n");
+    BOOST_CHECK(connection.Flush());
+    sender.join();
+    BOOST_CHECK(!LocalSocket().Listen(path)); // Already served
+    listener.Close();
+    BOOST_CHECK(!boost::filesystem::exists(path));
+
+    // A buffer is checked as though loaded from a file
+    InputFile input;
+    input.Assign("if (x)\n    LOG4CXX_INFO(logger, 1)\n");
+    CppFile file;
+    BOOST_REQUIRE(file.LoadFile("buffer.cpp", input));
+    CppFile::FunctionIterator log4cxxMacro(file, "LOG4CXX_");
+    log4cxxMacro.Start();
+    BOOST_REQUIRE(!log4cxxMacro.Off());
+    BOOST_CHECK(!log4cxxMacro.HasStatementTerminator());
+}
+
+BOOST_AUTO_TEST_CASE( request_server_test )
+{
+    ProcessingOptions options;
+    options.fix = options.fix_10_and_11 = options.diff = false;
+    options.lexerType = CppFile::LexerOnly;
+    options.inputType = CppFile::BufferedInput;
+    options.rules.AddFamily("LOG4CXX_");
+    options.streamSize = UINTMAX_MAX;
+    options.collectStats = false;
+    options.readAheadDepth = 0;
+    std::vector<std::string> extensions{".cpp"};
+    RequestServer server(options, DirectoryEntrySelectorPtr(new ExtensionSelector(extensions.begin(), extensions.end())));
+    LocalSocket::PathType path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    LocalSocket listener;
+    BOOST_REQUIRE(listener.Listen(path));
+    // Send \c request on a new connection, returning the reply lines, with each content block on its own line
+    auto exchange = [&server, &listener, &path](const std::string& request)
+    {
+        std::thread serving([&server, &listener]()
+        {
+            LocalSocket connection;
+            if (listener.Accept(connection))
+                server.Serve(connection);
+        });
+        std::vector<std::string> reply;
+        LocalSocket client;
+        if (client.Connect(path))
+        {
+            client.Write(request);
+            client.Shutdown();
+            std::string line;
+            while (client.ReadLine(line))
+            {
+                reply.push_back(line);
+                if (0 == line.compare(0, 8, "content ") && client.ReadBlock(std::stoul(line.substr(8)), line))
+                    reply.push_back(line);
+            }
+        }
+        serving.join();
+        return reply;
+    };
+
+    // A file, then a buffer fixed in a second request on the same connection
+    std::string source = boost::filesystem::absolute("main_0_10.cpp").string();
+    std::string buffer = "if (x)\n    LOG4CXX_INFO(logger, 1)\n";
+    std::vector<std::string> reply = exchange("request check\npath " + source + "\nend\n"
+        "request both_10_and_11\nbuffer " + std::to_string(buffer.size()) + " -\n" + buffer + "end\n");
+    std::string fixed = "if (x)\n{\n    LOG4CXX_INFO(logger, 1);\n}\n";
+    BOOST_REQUIRE_EQUAL(reply.size(), 6u);
+    BOOST_CHECK_EQUAL(reply[0], "result 1 4 0 0 " + source);
+    BOOST_CHECK_EQUAL(reply[1], "done");
+    BOOST_CHECK_EQUAL(reply[2], "result 1 1 0 0 -");
+    BOOST_CHECK_EQUAL(reply[3], "content " + std::to_string(fixed.size()));
+    BOOST_CHECK_EQUAL(reply[4], fixed);
+    BOOST_CHECK_EQUAL(reply[5], "done");
+    FileResult result;
+    BOOST_REQUIRE(RequestServer::ParseResult("result 1 4 0 1 " + source, result));
+    BOOST_CHECK(result.isValid);
+    BOOST_CHECK_EQUAL(result.fixCount, 4);
+    BOOST_CHECK(!result.isPrefiltered);
+    BOOST_CHECK(result.isCached);
+    BOOST_CHECK_EQUAL(result.path.string(), source);
+    BOOST_CHECK(!RequestServer::ParseResult("done", result));
+
+    // An error ends the connection
+    reply = exchange("request check\npath /no/such/file.cpp\nend\nrequest check\nend\n");
+    BOOST_REQUIRE_EQUAL(reply.size(), 1u);
+    BOOST_CHECK_EQUAL(reply[0], "error /no/such/file.cpp not found");
+    reply = exchange("request only_11\nbuffer 100 -\nLOG4CXX_INFO(logger, 1)\n");
+    BOOST_REQUIRE_EQUAL(reply.size(), 1u);
+    BOOST_CHECK_EQUAL(reply[0], "error incomplete buffer: buffer 100 -");
+    reply = exchange("request fix\n");
+    BOOST_REQUIRE_EQUAL(reply.size(), 1u);
+    BOOST_CHECK_EQUAL(reply[0], "error unknown request: request fix");
+}
+#endif // !defined(_WIN32)
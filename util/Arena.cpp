@@ -0,0 +1,87 @@
+#include "Arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+const size_t Arena::DefaultBlockSize;
+
+/// No blocks yet, the first having at least \c initialSize bytes
+Arena::Arena(size_t initialSize)
+    : m_next(0)
+    , m_used(0)
+    , m_highWater(0)
+    , m_blockAllocationCount(0)
+{
+    m_blocks.push_back(BlockType{std::unique_ptr<char[]>(), std::max(initialSize, size_t(1))});
+}
+
+/// The number of bytes in all blocks
+    size_t
+Arena::GetCapacity() const
+{
+    size_t result = 0;
+    for (auto& block : m_blocks)
+        if (block.data)
+            result += block.size;
+    return result;
+}
+
+/// A copy of \c text in this
+    Arena::TextType
+Arena::Copy(TextType text)
+{
+    if (text.empty())
+        return TextType();
+    char* data = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(data, text.data(), text.size());
+    return TextType(data, text.size());
+}
+
+/// Make all blocks available for reuse - Precondition: nothing allocated from this is in use
+    void
+Arena::Rewind()
+{
+    if (1 < m_blocks.size()) // Replace the blocks with one that would have held everything
+    {
+        size_t size = std::max(GetCapacity(), m_used);
+        m_blocks.clear();
+        AddBlock(size);
+    }
+    m_next = 0;
+    m_used = 0;
+}
+
+    void*
+Arena::do_allocate(size_t bytes, size_t alignment)
+{
+    BlockType* block = &m_blocks.back();
+    uintptr_t start = reinterpret_cast<uintptr_t>(block->data.get());
+    uintptr_t next = start + m_next;
+    uintptr_t result = (next + alignment - 1) & ~uintptr_t(alignment - 1);
+    if (!block->data || start + block->size < result + bytes)
+    {
+        size_t size = block->size * 2;
+        if (!block->data) // The first allocation
+        {
+            size = block->size;
+            m_blocks.pop_back();
+        }
+        AddBlock(std::max(size, bytes + alignment));
+        block = &m_blocks.back();
+        start = next = reinterpret_cast<uintptr_t>(block->data.get());
+        result = (next + alignment - 1) & ~uintptr_t(alignment - 1);
+    }
+    m_used += result + bytes - next;
+    m_highWater = std::max(m_highWater, m_used);
+    m_next = result + bytes - start;
+    return reinterpret_cast<void*>(result);
+}
+
+/// Add a block of at least \c size bytes
+    void
+Arena::AddBlock(size_t size)
+{
+    m_blocks.push_back(BlockType{std::unique_ptr<char[]>(new char[size]), size});
+    ++m_blockAllocationCount;
+    m_next = 0;
+}
@@ -0,0 +1,72 @@
+#if !defined(ARENA_INCLUDED)
+#define ARENA_INCLUDED
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+/// A memory resource that allocates by advancing a pointer through blocks it retains until destroyed.
+///
+/// Deallocation does nothing. Rewind() makes all the memory available again,
+/// first merging the blocks into one as large as the memory used,
+/// so a sequence of similar workloads stops allocating once the largest has been seen.
+class Arena : public std::pmr::memory_resource
+{
+public: // Types
+    typedef std::string_view TextType;
+
+protected: // Types
+    struct BlockType
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    typedef std::vector<BlockType> BlockStore;
+
+private: // Attributes
+    BlockStore m_blocks; //!< The last block is being used
+    size_t m_next; //!< The index of the next free byte in the last block
+    size_t m_used; //!< The number of bytes allocated since the last Rewind()
+    size_t m_highWater; //!< The largest value of m_used
+    size_t m_blockAllocationCount; //!< The number of blocks obtained from the heap
+
+public: // ...structors
+    /// No blocks yet, the first having at least \c initialSize bytes
+    Arena(size_t initialSize = DefaultBlockSize);
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+public: // Accessors
+    /// The number of bytes allocated since the last Rewind()
+    size_t GetUsed() const { return m_used; }
+
+    /// The largest number of bytes allocated between calls to Rewind()
+    size_t GetHighWater() const { return m_highWater; }
+
+    /// The number of bytes in all blocks
+    size_t GetCapacity() const;
+
+    /// The number of blocks obtained from the heap
+    size_t GetBlockAllocationCount() const { return m_blockAllocationCount; }
+
+public: // Methods
+    /// A copy of \c text in this
+    TextType Copy(TextType text);
+
+    /// Make all blocks available for reuse - Precondition: nothing allocated from this is in use
+    void Rewind();
+
+protected: // memory_resource methods
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+protected: // Support methods
+    /// Add a block of at least \c size bytes
+    void AddBlock(size_t size);
+
+private: // Class data
+    static const size_t DefaultBlockSize = 64 * 1024;
+};
+
+#endif // !defined(ARENA_INCLUDED)
@@ -0,0 +1,32 @@
+#include "CallStatement.h"
+
+/// Is \c nextId, the significant token after the closing parenthesis, a semicolon, colon or comma?
+    bool
+CallStatement::IsTerminated(TokenId nextId)
+{
+    return boost::wave::T_SEMICOLON == nextId ||
+           boost::wave::T_COLON == nextId ||
+           boost::wave::T_COMMA == nextId;
+}
+
+/// Is the call the body of a compound statement given \c previousId, the significant token before its name?
+/// When \c previousId is a closing parenthesis, \c statementId is the significant token before the matching opening one.
+/// \c isChangedBefore indicates a change was made from the previous token to the name (such as braces around an earlier call).
+    bool
+CallStatement::IsCompoundStatementBody(TokenId previousId, TokenId statementId, bool isChangedBefore)
+{
+    if (boost::wave::T_RIGHTPAREN == previousId)
+        return boost::wave::T_CATCH == statementId ||
+               boost::wave::T_FOR == statementId ||
+               boost::wave::T_IF == statementId ||
+               boost::wave::T_SWITCH == statementId ||
+               boost::wave::T_WHILE == statementId;
+    return !isChangedBefore &&
+           boost::wave::T_EOF != previousId && // The start of a line range window
+           boost::wave::T_ELSE != previousId &&
+           boost::wave::T_LEFTBRACE != previousId &&
+           boost::wave::T_RIGHTBRACE != previousId &&
+           boost::wave::T_COLON != previousId &&
+           boost::wave::T_SEMICOLON != previousId &&
+           boost::wave::T_COMMA != previousId;
+}
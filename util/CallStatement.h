@@ -0,0 +1,24 @@
+#if !defined(CALL_STATEMENT_INCLUDED)
+#define CALL_STATEMENT_INCLUDED
+#include <boost/wave/token_ids.hpp>
+
+/// The decisions about the statement holding a selected function call.
+///
+/// CppFile::FunctionIterator and CppStream find the significant tokens around a call differently,
+/// but both decide whether it needs a statement terminator or braces here.
+class CallStatement
+{
+public: // Types
+    typedef boost::wave::token_id TokenId;
+
+public: // Class methods
+    /// Is \c nextId, the significant token after the closing parenthesis, a semicolon, colon or comma?
+    static bool IsTerminated(TokenId nextId);
+
+    /// Is the call the body of a compound statement given \c previousId, the significant token before its name?
+    /// When \c previousId is a closing parenthesis, \c statementId is the significant token before the matching opening one.
+    /// \c isChangedBefore indicates a change was made from the previous token to the name (such as braces around an earlier call).
+    static bool IsCompoundStatementBody(TokenId previousId, TokenId statementId, bool isChangedBefore);
+};
+
+#endif // !defined(CALL_STATEMENT_INCLUDED)
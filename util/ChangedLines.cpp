@@ -0,0 +1,143 @@
+#include "ChangedLines.h"
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+    /// The file name in the text following the --- or +++ of a diff header line
+    std::string GetDiffName(const std::string& text)
+    {
+        std::string result = text.substr(0, text.find('\t')); // Remove any timestamp
+        if (2 <= result.size() && '"' == result.front() && '"' == result.back())
+            result = result.substr(1, result.size() - 2);
+        return result;
+    }
+
+    /// The number at \c p, putting the position after it in \c next. Returns zero if there is no number at \c p.
+    size_t GetNumber(const char* p, const char*& next)
+    {
+        char* end;
+        size_t result = std::strtoul(p, &end, 10);
+        next = end;
+        return result;
+    }
+
+    /// The line number in \c text of \c spec. Throws std::invalid_argument if \c text is not a positive number.
+    size_t GetLineNumber(const std::string& text, const std::string& spec)
+    {
+        const char* next;
+        size_t result = GetNumber(text.c_str(), next);
+        if (text.empty() || 0 == result || '\0' != *next)
+            throw std::invalid_argument("--lines " + spec + ": " + text + " is not a line number");
+        return result;
+    }
+}
+
+/// The lines of interest in \c path (or null if none were given)
+    const ChangedLines::LineRangeStore*
+ChangedLines::Find(const PathType& path) const
+{
+    auto pItem = m_ranges.find(path.lexically_normal());
+    return m_ranges.end() == pItem ? 0 : &pItem->second;
+}
+
+/// Include lines \c first to \c last of \c path
+    void
+ChangedLines::Add(const PathType& path, size_t first, size_t last)
+{
+    LineRangeStore& ranges = m_ranges[path.lexically_normal()];
+    if (!ranges.empty() && ranges.back().last + 1 == first) // Extend the previous range
+        ranges.back().last = last;
+    else
+        ranges.push_back(CppFile::LineRange{first, last});
+}
+
+/// Include the lines in \c spec, a path:first[-last][,first[-last]...] specification.
+/// Returns the path. Throws std::invalid_argument if \c spec is malformed.
+    ChangedLines::PathType
+ChangedLines::AddSpecification(const StringType& spec)
+{
+    size_t colon = spec.rfind(':');
+    if (StringType::npos == colon || 0 == colon)
+        throw std::invalid_argument("--lines " + spec + ": expected path:first-last");
+    PathType path = spec.substr(0, colon);
+    for (size_t start = colon + 1; start <= spec.size(); )
+    {
+        size_t end = std::min(spec.find(',', start), spec.size());
+        StringType range = spec.substr(start, end - start);
+        size_t dash = range.find('-');
+        size_t first = GetLineNumber(range.substr(0, dash), spec);
+        size_t last = StringType::npos == dash ? first : GetLineNumber(range.substr(dash + 1), spec);
+        if (last < first)
+            throw std::invalid_argument("--lines " + spec + ": " + range + " is not in ascending order");
+        Add(path, first, last);
+        start = end + 1;
+    }
+    return path;
+}
+
+/// Include the lines added by the unified diff \c diff and the line before each removal.
+/// The a/ and b/ prefixes of git diff names are removed.
+    void
+ChangedLines::AddDiff(std::istream& diff)
+{
+    StringType line, oldName;
+    PathType path;
+    size_t newLine = 0, oldRemaining = 0, newRemaining = 0;
+    while (std::getline(diff, line))
+    {
+        if (!line.empty() && '\r' == line.back())
+            line.pop_back();
+        if (0 < oldRemaining || 0 < newRemaining) // In a hunk
+        {
+            char kind = line.empty() ? ' ' : line[0];
+            if ('+' == kind)
+            {
+                if (!path.empty())
+                    Add(path, newLine, newLine);
+                ++newLine;
+                newRemaining -= (0 < newRemaining);
+            }
+            else if ('-' == kind)
+            {
+                if (!path.empty() && 1 < newLine)
+                    Add(path, newLine - 1, newLine - 1);
+                oldRemaining -= (0 < oldRemaining);
+            }
+            else if ('\\' != kind) // Not "\ No newline at end of file"
+            {
+                ++newLine;
+                newRemaining -= (0 < newRemaining);
+                oldRemaining -= (0 < oldRemaining);
+            }
+        }
+        else if (0 == line.compare(0, 4, "--- "))
+            oldName = GetDiffName(line.substr(4));
+        else if (0 == line.compare(0, 4, "+++ "))
+        {
+            StringType newName = GetDiffName(line.substr(4));
+            bool isGitDiff = 0 == oldName.compare(0, 2, "a/") || "/dev/null" == oldName;
+            if ("/dev/null" == newName) // A removed file
+                newName.clear();
+            else if (isGitDiff && 0 == newName.compare(0, 2, "b/"))
+                newName.erase(0, 2);
+            path = newName;
+        }
+        else if (0 == line.compare(0, 4, "@@ -"))
+        {
+            // @@ -oldStart[,oldCount] +newStart[,newCount] @@
+            const char* p;
+            GetNumber(line.c_str() + 4, p);
+            oldRemaining = ',' == *p ? GetNumber(p + 1, p) : 1;
+            if (' ' != p[0] || '+' != p[1])
+            {
+                oldRemaining = 0;
+                continue;
+            }
+            size_t newStart = GetNumber(p + 2, p);
+            newRemaining = ',' == *p ? GetNumber(p + 1, p) : 1;
+            // A hunk that only removes lines gives the line before the removal
+            newLine = 0 == newRemaining ? newStart + 1 : newStart;
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#if !defined(CHANGED_LINES_INCLUDED)
+#define CHANGED_LINES_INCLUDED
+#include "CppFile.h"
+#include <boost/filesystem.hpp>
+#include <istream>
+#include <map>
+#include <string>
+
+/// The lines of interest in each file, given as path:first-last specifications or read from a unified diff
+class ChangedLines
+{
+public: // Types
+    typedef boost::filesystem::path PathType;
+    typedef std::string StringType;
+    typedef CppFile::LineRangeStore LineRangeStore;
+    typedef std::map<PathType, LineRangeStore> RangeMap;
+    typedef RangeMap::const_iterator const_iterator;
+
+private: // Attributes
+    RangeMap m_ranges; //!< The lines of each file, keyed by its lexically normal path
+
+public: // Accessors
+    /// Are there no lines of interest?
+    bool IsEmpty() const { return m_ranges.empty(); }
+
+    /// The lines of interest in \c path (or null if none were given)
+    const LineRangeStore* Find(const PathType& path) const;
+
+    /// The first file and its lines
+    const_iterator begin() const { return m_ranges.begin(); }
+
+    /// Beyond the last file
+    const_iterator end() const { return m_ranges.end(); }
+
+public: // Methods
+    /// Include lines \c first to \c last of \c path
+    void Add(const PathType& path, size_t first, size_t last);
+
+    /// Include the lines in \c spec, a path:first[-last][,first[-last]...] specification.
+    /// Returns the path. Throws std::invalid_argument if \c spec is malformed.
+    PathType AddSpecification(const StringType& spec);
+
+    /// Include the lines added by the unified diff \c diff and the line before each removal.
+    /// The a/ and b/ prefixes of git diff names are removed.
+    void AddDiff(std::istream& diff);
+};
+
+#endif // !defined(CHANGED_LINES_INCLUDED)
@@ -0,0 +1,118 @@
+#include "ContentHash.h"
+#include <cstring>
+
+namespace
+{
+    inline uint64_t RotateLeft(uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    /// Load 8 bytes (in little-endian order) from \c p
+    inline uint64_t Load64(const uint8_t* p)
+    {
+        uint64_t result = 0;
+        for (int i = 7; 0 <= i; --i)
+            result = (result << 8) | p[i];
+        return result;
+    }
+
+    /// Mix the bits of \c k so each input bit affects each output bit
+    inline uint64_t FinalMix(uint64_t k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return k;
+    }
+
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+}
+
+/// The hash of the \c size bytes at \c data
+    ContentHash::ValueType
+ContentHash::Compute(const void* data, size_t size, uint32_t seed)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    const size_t blockCount = size / 16;
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    for (size_t i = 0; i < blockCount; ++i)
+    {
+        uint64_t k1 = Load64(bytes + i * 16);
+        uint64_t k2 = Load64(bytes + i * 16 + 8);
+
+        k1 *= c1; k1 = RotateLeft(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = RotateLeft(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = RotateLeft(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = RotateLeft(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const uint8_t* tail = bytes + blockCount * 16;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    switch (size & 15)
+    {
+    case 15: k2 ^= uint64_t(tail[14]) << 48; // fall through
+    case 14: k2 ^= uint64_t(tail[13]) << 40; // fall through
+    case 13: k2 ^= uint64_t(tail[12]) << 32; // fall through
+    case 12: k2 ^= uint64_t(tail[11]) << 24; // fall through
+    case 11: k2 ^= uint64_t(tail[10]) << 16; // fall through
+    case 10: k2 ^= uint64_t(tail[ 9]) << 8;  // fall through
+    case  9: k2 ^= uint64_t(tail[ 8]);
+        k2 *= c2; k2 = RotateLeft(k2, 33); k2 *= c1; h2 ^= k2;
+        // fall through
+    case  8: k1 ^= uint64_t(tail[ 7]) << 56; // fall through
+    case  7: k1 ^= uint64_t(tail[ 6]) << 48; // fall through
+    case  6: k1 ^= uint64_t(tail[ 5]) << 40; // fall through
+    case  5: k1 ^= uint64_t(tail[ 4]) << 32; // fall through
+    case  4: k1 ^= uint64_t(tail[ 3]) << 24; // fall through
+    case  3: k1 ^= uint64_t(tail[ 2]) << 16; // fall through
+    case  2: k1 ^= uint64_t(tail[ 1]) << 8;  // fall through
+    case  1: k1 ^= uint64_t(tail[ 0]);
+        k1 *= c1; k1 = RotateLeft(k1, 31); k1 *= c2; h1 ^= k1;
+        break;
+    default:
+        break;
+    }
+
+    h1 ^= uint64_t(size);
+    h2 ^= uint64_t(size);
+    h1 += h2;
+    h2 += h1;
+    h1 = FinalMix(h1);
+    h2 = FinalMix(h2);
+    h1 += h2;
+    h2 += h1;
+    return ValueType{h1, h2};
+}
+
+/// The hash of \c value combined with \c other
+    ContentHash::ValueType
+ContentHash::Combine(const ValueType& value, const ValueType& other)
+{
+    uint8_t bytes[32];
+    const uint64_t words[4] = { value.high, value.low, other.high, other.low };
+    for (int i = 0; i < 32; ++i)
+        bytes[i] = uint8_t(words[i / 8] >> (8 * (i % 8)));
+    return Compute(bytes, sizeof (bytes));
+}
+
+/// The 32 hexadecimal digits of \c value
+    std::string
+ContentHash::ToString(const ValueType& value)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string result(32, '0');
+    for (int i = 0; i < 16; ++i)
+    {
+        result[15 - i] = digits[(value.high >> (4 * i)) & 15];
+        result[31 - i] = digits[(value.low >> (4 * i)) & 15];
+    }
+    return result;
+}
@@ -0,0 +1,28 @@
+#if !defined(CONTENT_HASH_INCLUDED)
+#define CONTENT_HASH_INCLUDED
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// A 128 bit non-cryptographic hash (MurmurHash3 x64_128) suitable for identifying file content.
+namespace ContentHash
+{
+    /// A hash value
+    struct ValueType
+    {
+        uint64_t high;
+        uint64_t low;
+        bool operator==(const ValueType& other) const { return high == other.high && low == other.low; }
+    };
+
+    /// The hash of the \c size bytes at \c data
+    ValueType Compute(const void* data, size_t size, uint32_t seed = 0);
+
+    /// The hash of \c value combined with \c other
+    ValueType Combine(const ValueType& value, const ValueType& other);
+
+    /// The 32 hexadecimal digits of \c value
+    std::string ToString(const ValueType& value);
+}
+
+#endif // !defined(CONTENT_HASH_INCLUDED)
@@ -1,5 +1,8 @@
 #include "CppFile.h"
-#include <fstream>
+#include "CallStatement.h"
+#include "HotPathLogging.h"
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <ctype.h>
 
@@ -36,14 +39,14 @@ public: // Hooked methods
         , bool               include_next
         )
     {
-        LOG4CXX_TRACE(log_s, "include " << filename);
+        HOT_PATH_TRACE(log_s, "include " << filename);
         return true;    // skip all #includes
     }
     /// Prevent directive processing
     template <typename ContextT, typename TokenT>
     bool found_directive(ContextT const &ctx, TokenT const &directive)
     {
-        LOG4CXX_TRACE(log_s, "directive " << directive.get_value());
+        HOT_PATH_TRACE(log_s, "directive " << directive.get_value());
         return true;    // skip all directives
     }
 };
@@ -53,7 +56,7 @@ typedef boost::wave::util::file_position<BOOST_WAVE_STRINGTYPE> position_type;
 typedef boost::wave::cpplexer::lex_token<position_type> TokenType;
 typedef boost::wave::cpplexer::lex_iterator<TokenType> lex_iterator_type;
 typedef boost::wave::context
-    < std::string::iterator
+    < const char*
     , lex_iterator_type
     , boost::wave::iteration_context_policies::load_file_to_string
     , CppFile::CustomDirectivesHooks
@@ -110,6 +113,33 @@ operator<<(std::ostream& stream, ContextType::iterator_type const& pItem)
 ///////////////////////////////////////////////////////////////////////////////
 //  CppFile implementation
 
+const size_t CppFile::ContextLineCount;
+const size_t CppFile::DiffContextLineCount;
+
+namespace
+{
+    /// The lines of \c text, each including its line break
+    std::vector<InputFile::ContentType> SplitLines(InputFile::ContentType text)
+    {
+        std::vector<InputFile::ContentType> result;
+        while (!text.empty())
+        {
+            size_t length = std::min(text.find('\n'), text.size() - 1) + 1;
+            result.push_back(text.substr(0, length));
+            text.remove_prefix(length);
+        }
+        return result;
+    }
+
+    /// Put \c line onto \c os after \c prefix, marking a missing line break
+    void WriteDiffLine(std::ostream& os, char prefix, InputFile::ContentType line)
+    {
+        os << prefix << line;
+        if (line.empty() || '\n' != line.back())
+            os << "\n\\ No newline at end of file\n";
+    }
+}
+
 // Put \c item onto \c os
     std::ostream&
 operator<<(std::ostream& stream, CppFile::PositionType const& item)
@@ -122,168 +152,309 @@ operator<<(std::ostream& stream, CppFile::PositionType const& item)
     size_t
 CppFile::GetContentIndex(const PositionType& index) const
 {
-    size_t result;
-    if (0 < index.line && index.line <= m_lineIndex.size())
-        result = m_lineIndex[index.line - 1] + index.column - 1;
-    else
-        result = m_content.size();
-    LOG4CXX_TRACE(log_s, "GetContentIndex: " << index << " result " << result);
+    size_t result = m_lineIndex.GetIndex(index.line, index.column);
+    HOT_PATH_TRACE(log_s, "GetContentIndex: " << index << " result " << result);
     return result;
 }
 
+/// The index into \c m_content of the start of the (1-based) \c line
+    size_t
+CppFile::GetLineStart(size_t line) const
+{
+    return m_lineIndex.GetLineStart(line);
+}
+
+/// The (1-based) line and column of \c index into \c m_content.
+/// \c lineHint (when given) holds the line of the position previously found by the caller.
+    CppFile::PositionType
+CppFile::GetPosition(size_t index, size_t* lineHint) const
+{
+    size_t line = m_lineIndex.GetLine(index, lineHint);
+    if (0 == line)
+        return PositionType{0, 0};
+    return PositionType{line, index - m_lineIndex.GetLineStart(line) + 1};
+}
+
 /// The number of instances of the identifier \c name
     size_t
-CppFile::GetIdentifierCount(const StringType& name) const
+CppFile::GetIdentifierCount(IdentifierTable::NameType name) const
 {
     size_t result = 0;
-    StringPositionMap::const_iterator pItem = m_identiferPositions.find(name);
-    if (m_identiferPositions.end() != pItem)
-        result = pItem->second.size();
+    size_t rank = m_identifiers.Find(name);
+    if (rank < m_identifiers.Size())
+        result = m_identifiers.GetInstanceCount(rank);
     return result;
 }
 
 /// The number of function call style usages of the identifier \c name
     size_t
-CppFile::GetFunctionCount(const StringType& name) const
+CppFile::GetFunctionCount(IdentifierTable::NameType name) const
 {
     size_t result = 0;
-    StringPositionMap::const_iterator pItem = m_identiferPositions.find(name);
-    if (m_identiferPositions.end() == pItem)
+    size_t rank = m_identifiers.Find(name);
+    if (m_identifiers.Size() <= rank)
         ;
-    else for (size_t i = 0; i < pItem->second.size(); ++i)
+    else for (auto pInstance = m_identifiers.BeginInstance(rank); pInstance != m_identifiers.EndInstance(rank); ++pInstance)
     {
-        boost::wave::token_id tokenId = GetNonWhitespaceTokenAfter(pItem->second[i]);
+        boost::wave::token_id tokenId = GetNonWhitespaceTokenAfter(*pInstance);
         if (boost::wave::T_LEFTPAREN == tokenId)
             ++result;
     }
     return result;
 }
 
-/// Has an been made between \c start and before \c end
-    bool
-CppFile::HasUpdateBetween(const PositionType& start, const PositionType& end) const
-{
-    static const int MaxUpdatesPerPosition = 100;
-    UpdateKey keyStart(start, -MaxUpdatesPerPosition);
-    UpdateKey keyEnd(end, MaxUpdatesPerPosition);
-    UpdateMap::const_iterator pUpdate = m_updates.lower_bound(keyStart);
-    bool found = m_updates.end() != pUpdate && pUpdate->first < keyEnd;
-    LOG4CXX_TRACE(log_s, "HasUpdateBetween: " << start << " and " << end << " found? " << found);
-    return found;
-}
-
-/// The id (and optionally position) of the first compiler token before \c index
+/// The id (and optionally position) of the first compiler token after \c index
     boost::wave::token_id
-CppFile::GetNonWhitespaceTokenBefore(const PositionType& index, PositionType* resultIndex) const
+CppFile::GetNonWhitespaceTokenAfter(size_t index, size_t* resultIndex) const
 {
     boost::wave::token_id result = boost::wave::T_EOI;
-    IndexedToken::const_iterator pItem = m_tokenPositions.lower_bound(index);
-    while (m_tokenPositions.end() != pItem && (pItem->first == index
-        || IS_CATEGORY(pItem->second, boost::wave::WhiteSpaceTokenType)
-        || IS_CATEGORY(pItem->second, boost::wave::EOLTokenType) ))
-      --pItem;
-    if (m_tokenPositions.end() != pItem)
-    {
-        result = pItem->second;
-        LOG4CXX_TRACE(log_s, "GetNonWhitespaceTokenBefore: " << index
+    size_t ordinal = m_tokens.UpperBound(index);
+    if (ordinal < m_tokens.Size() && m_tokens.IsWhitespace(ordinal))
+        ordinal = m_tokens.NextSignificant(ordinal);
+    if (ordinal < m_tokens.Size())
+    {
+        result = m_tokens.GetId(ordinal);
+        HOT_PATH_TRACE(log_s, "GetNonWhitespaceTokenAfter: " << index
             << " token " << boost::wave::get_token_name(result)
-            << " at " << pItem->first
+            << " at " << m_tokens.GetOffset(ordinal)
             );
         if (resultIndex)
-            *resultIndex = pItem->first;
+            *resultIndex = m_tokens.GetOffset(ordinal);
     }
     return result;
 }
 
-/// The id (and optionally position) of the first compiler token before the parenthesis matching \c index
-    boost::wave::token_id
-CppFile::GetNonWhitespaceTokenBeforeOtherParen(const PositionType& index, PositionType* resultIndex) const
+/// Is any line from \c first to \c last in the ranges given to SetLineRanges (or were none given)?
+    bool
+CppFile::IsInLineRanges(size_t first, size_t last) const
 {
-    LOG4CXX_TRACE(log_s, "GetNonWhitespaceTokenBeforeOtherParen: " << index);
-    boost::wave::token_id result = boost::wave::T_EOI;
-    IndexMap::const_iterator pMate = m_parenMate.find(index);
-    if (m_parenMate.end() != pMate)
-        result = GetNonWhitespaceTokenBefore(pMate->second, resultIndex);
-    return result;
+    if (m_lineRanges.empty())
+        return true;
+    auto pRange = std::upper_bound(m_lineRanges.begin(), m_lineRanges.end(), LineRange{last, SIZE_MAX});
+    return m_lineRanges.begin() != pRange && first <= pRange[-1].last;
 }
 
-/// The id (and optionally position) of the first compiler token after \c index
-    boost::wave::token_id
-CppFile::GetNonWhitespaceTokenAfter(const PositionType& index, PositionType* resultIndex) const
+/// Has this been loaded?
+    bool
+CppFile::IsValid() const
 {
-    boost::wave::token_id result = boost::wave::T_EOI;
-    IndexedToken::const_iterator pItem = m_tokenPositions.upper_bound(index);
-    while (m_tokenPositions.end() != pItem && (pItem->first == index
-        || IS_CATEGORY(pItem->second, boost::wave::WhiteSpaceTokenType)
-        || IS_CATEGORY(pItem->second, boost::wave::EOLTokenType) ))
-      ++pItem;
-    if (m_tokenPositions.end() != pItem)
-    {
-        LOG4CXX_TRACE(log_s, "GetNonWhitespaceTokenAfter: " << index
-            << " token " << boost::wave::get_token_name(pItem->second)
-            << " at " << pItem->first
-            );
-        if (resultIndex)
-            *resultIndex = pItem->first;
-        result = pItem->second;
+    return m_isPrefiltered || m_lineIndex.GetLineCount() - 1 <= m_processed.line;
+}
+
+/// Restrict tokenizing and the function calls iterated to those on lines in \c ranges (all lines when empty).
+/// Outside the ranges (and the ContextLineCount lines before each, or the call still open there)
+/// the fast lexer only skips over comments and literals.
+    void
+CppFile::SetLineRanges(const LineRangeStore& ranges)
+{
+    m_lineRanges = ranges;
+    std::sort(m_lineRanges.begin(), m_lineRanges.end());
+    size_t mergedCount = 0;
+    for (auto& range : m_lineRanges)
+    {
+        if (0 < mergedCount && range.first <= m_lineRanges[mergedCount - 1].last + 1)
+            m_lineRanges[mergedCount - 1].last = std::max(m_lineRanges[mergedCount - 1].last, range.last);
+        else
+            m_lineRanges[mergedCount++] = range;
     }
-    return result;
+    m_lineRanges.resize(mergedCount);
 }
 
-/// Has this been loaded?
-    bool
-CppFile::IsValid() const
+/// Forget the loaded file, retaining the allocated storage for reuse by the next
+    void
+CppFile::Reset()
 {
-    return m_lineIndex.size() - 1 <= m_processed.line;
+    m_lineIndex.Clear();
+    m_processed = PositionType{0, 0};
+    m_isPrefiltered = false;
+    m_content = InputFile::ContentType();
+    m_path.clear();
+    m_input.Close();
+    m_identifiers.Clear();
+    m_tokens.Clear();
+    m_edits.Clear();
 }
 
-/// Load \c read into various indexing attributes
+/// Load \c path into various indexing attributes
     bool
 CppFile::LoadFile(const PathType& path)
 {
     LOG4CXX_DEBUG(log_s, "LoadFile: " << path);
-    std::ifstream instream(path.c_str());
-    if (!instream.is_open())
+    Reset();
+    {
+        PhaseStats::Timer readTimer(m_stats, PhaseStats::Read);
+        if (!m_input.Open(path, MappedInput == m_inputType))
+            return false;
+    }
+    return LoadInput(path);
+}
+
+/// Load the content of \c path (already in \c input) into various indexing attributes.
+/// \c input is left closed.
+    bool
+CppFile::LoadFile(const PathType& path, InputFile& input)
+{
+    LOG4CXX_DEBUG(log_s, "LoadFile: " << path << " (preloaded)");
+    Reset();
+    m_input.Swap(input);
+    return LoadInput(path);
+}
+
+/// Load the content of \c path in \c m_input into various indexing attributes
+    bool
+CppFile::LoadInput(const PathType& path)
+{
+    m_path = path;
+    m_content = m_input.GetContent();
+    if (TokenTable::GetMaxContentSize() < m_content.size())
+    {
+        LOG4CXX_WARN(log_s, "Too large to index (" << m_content.size() << " bytes)" << " at " << path);
+        return false;
+    }
+    PhaseStats::Timer prefilterTimer(m_stats, PhaseStats::Prefilter);
+    if (!m_prefilter.HasCandidate(m_content.data(), m_content.data() + m_content.size()))
+    {
+        LOG4CXX_DEBUG(log_s, "LoadFile: no candidate identifiers in " << path);
+        m_isPrefiltered = true;
+        return true;
+    }
+    prefilterTimer.Stop();
+    PhaseStats::Timer lineIndexTimer(m_stats, PhaseStats::Index);
+    SetLineIndex();
+    lineIndexTimer.Stop();
+    PhaseStats::Timer lexTimer(m_stats, PhaseStats::Lex);
+    bool ok = WaveContext == m_lexerType ? LoadWaveTokens(path) : LoadLexerTokens(path);
+    lexTimer.Stop();
+    PhaseStats::Timer indexTimer(m_stats, PhaseStats::Index);
+    m_identifiers.Index();
+    return ok;
+}
+
+/// Add the token at \c index into \c m_content to the indexing attributes
+    void
+CppFile::IndexToken(TokenId tokenId, size_t index, BracketStack& openBrackets)
+{
+    size_t ordinal = m_tokens.Size();
+    m_tokens.Append(index, tokenId);
+    bool isOpening;
+    TokenTable::BracketKind kind = TokenTable::GetBracketKind(tokenId, isOpening);
+    if (TokenTable::NotBracket == kind)
+        ;
+    else if (isOpening)
+        openBrackets[kind].push_back(ordinal);
+    else if (!openBrackets[kind].empty())
+    {
+        HOT_PATH_TRACE(log_s, "Opening " << m_tokens.GetOffset(openBrackets[kind].back()));
+        m_tokens.SetMate(openBrackets[kind].back(), ordinal);
+        openBrackets[kind].pop_back();
+    }
+}
+
+/// Load the tokens in \c m_content using \c m_lexer
+    bool
+CppFile::LoadLexerTokens(const PathType& path)
+{
+    BracketStack openBrackets;
+    const char* content = m_content.data();
+    m_lexer.Start(content, content + m_content.size());
+    if (m_lineRanges.empty())
+        LoadLexerTokens(path, m_content.size() + 1, openBrackets);
+    else for (auto& range : m_lineRanges)
+    {
+        size_t windowStart = GetLineStart(range.first <= ContextLineCount ? 1 : range.first - ContextLineCount);
+        if (!m_lexer.Off() && m_lexer.Item().offset < windowStart)
+        {
+            // Mark the gap so no neighbouring token is found across it
+            m_tokens.Append(m_lexer.Item().offset, boost::wave::T_EOF);
+            m_lexer.SkipTo(content + windowStart);
+            for (auto& stack : openBrackets)
+                stack.clear();
+        }
+        LoadLexerTokens(path, GetLineStart(range.last + 1), openBrackets);
+    }
+    if (m_lexer.HasError())
+    {
+        LOG4CXX_WARN(log_s, m_lexer.GetError()
+            << " at " << path
+            << '(' << m_processed.line << ')'
+            );
         return false;
-    instream.unsetf(std::ios::skipws);
+    }
+    if (!m_lineRanges.empty()) // The remainder need not be tokenized
+        m_processed.line = std::max(m_processed.line, m_lineIndex.GetLineCount() - 1);
+    return true;
+}
+
+/// Load the tokens of \c m_lexer up to and including the first compiler token at or after \c windowEnd
+/// that does not have an unmatched parenthesis before it
+    void
+CppFile::LoadLexerTokens(const PathType& path, size_t windowEnd, BracketStack& openBrackets)
+{
+    const char* content = m_content.data();
+    for (; !m_lexer.Off(); m_lexer.Forth())
+    {
+        const CppLexer::ItemType& token = m_lexer.Item();
+        m_processed = PositionType{token.line, token.column};
+        if (boost::wave::T_IDENTIFIER == token.id)
+            m_identifiers.Add(IdentifierTable::NameType(content + token.offset, token.length), token.offset);
+        else if (boost::wave::T_UNKNOWN == token.id)
+        {
+            LOG4CXX_WARN(log_s, "Unknown token (" << CStringRef<InputFile::ContentType>(m_content.substr(token.offset, token.length)) << ')'
+                << " at " << path
+                << '(' << token.line
+                << ',' << token.column << ')'
+                );
+        }
+        bool isBalanced = windowEnd <= token.offset && openBrackets[TokenTable::Parenthesis].empty();
+        IndexToken(token.id, token.offset, openBrackets);
+        if (isBalanced && !m_tokens.IsWhitespace(m_tokens.Size() - 1))
+        {
+            m_lexer.Forth();
+            break;
+        }
+    }
+}
+
+/// Load the tokens in \c m_content using a boost::wave::context
+    bool
+CppFile::LoadWaveTokens(const PathType& path)
+{
     bool ok = false;
     position_type current_position;
     try
     {
-        m_identiferPositions.clear();
-        m_parenMate.clear();
-        m_tokenPositions.clear();
-        m_content = std::string
-            ( std::istreambuf_iterator<char>(instream.rdbuf())
-            , std::istreambuf_iterator<char>()
-            );
-        SetLineIndex();
         CustomDirectivesHooks hooks;
-        ContextType ctx(m_content.begin(), m_content.end(), path.string().c_str(), hooks);
+        ContextType ctx(m_content.data(), m_content.data() + m_content.size(), path.string().c_str(), hooks);
         ctx.set_language(boost::wave::enable_preserve_comments(ctx.get_language()));
+        ctx.set_language(boost::wave::enable_emit_line_directives(ctx.get_language(), false));
         ContextType::iterator_type first = ctx.begin();
         ContextType::iterator_type last = ctx.end();
-        std::vector<PositionType> parenStack;
+        BracketStack openBrackets;
+        size_t tokenEnd = 0;
         while (first != last)
         {
-            LOG4CXX_TRACE(log_s, first);
+            HOT_PATH_TRACE(log_s, first);
             boost::wave::token_id tokenId = *first;
             current_position = first->get_position();
             m_processed = PositionType{current_position.get_line(), current_position.get_column()};
-            if (boost::wave::T_LEFTPAREN == tokenId)
-                parenStack.push_back(m_processed);
-            else if (boost::wave::T_RIGHTPAREN == tokenId && !parenStack.empty())
+            // Wave skips directive lines, its columns drift after line continuations
+            // and it generates white space (and macro expansions) that is not in the content,
+            // so the token is expected to follow the previous token unless its text is elsewhere
+            const BOOST_WAVE_STRINGTYPE& value = first->get_value();
+            size_t index = tokenEnd;
+            size_t length = value.size();
+            if (0 != m_content.compare(index, length, value.c_str()))
             {
-                LOG4CXX_TRACE(log_s, "LeftParen " << parenStack.back());
-                m_parenMate[m_processed] = parenStack.back();
-                m_parenMate[parenStack.back()] = m_processed;
-                parenStack.pop_back();
-            }
-            else if (boost::wave::T_IDENTIFIER == tokenId)
-            {
-                StringType identifier = first->get_value().c_str();
-                m_identiferPositions[identifier].push_back(m_processed);
+                size_t lineColIndex = GetContentIndex(m_processed);
+                if (tokenEnd < lineColIndex && lineColIndex <= m_content.size()
+                    && 0 == m_content.compare(lineColIndex, length, value.c_str()))
+                    index = lineColIndex;
+                else
+                    length = 0;
             }
+            tokenEnd = index + length;
+            if (boost::wave::T_IDENTIFIER == tokenId && 0 < length)
+                m_identifiers.Add(IdentifierTable::NameType(m_content.data() + index, length), index);
             else if (boost::wave::T_UNKNOWN == tokenId)
             {
                 LOG4CXX_WARN(log_s, "Unknown token (" << CStringRef<BOOST_WAVE_STRINGTYPE>(first->get_value()) << ')'
@@ -292,9 +463,7 @@ CppFile::LoadFile(const PathType& path)
                     << ',' << current_position.get_column() << ')'
                     );
             }
-            if (boost::wave::T_CCOMMENT == tokenId)
-                m_processed.line += boost::wave::context_policies::util::ccomment_count_newlines(*first);
-            m_tokenPositions[m_processed] = tokenId;
+            IndexToken(tokenId, index, openBrackets);
             ++first;
         }
         ok = true;
@@ -330,88 +499,183 @@ CppFile::LoadFile(const PathType& path)
     return ok;
 }
 
-/// Append \c text after \c lineCol
-    void
-CppFile::AppendText(const PositionType& lineCol, const StringType& text)
-{
-    LOG4CXX_DEBUG(log_s, "AppendText: " << CStringRef<StringType>(text) << " at " << lineCol);
-    size_t contentIndex = GetContentIndex(lineCol) + 1;
-    UpdateData newText = {contentIndex, Insert, text, contentIndex};
-    UpdateKey key(lineCol, 0);
-    while (0 < m_updates.count(key))
-        ++key.second;
-    m_updates[key] = newText;
-}
-
-/// Insert \c text before \c lineCol
+/// Include the changes in \c edits, made by an analysis of this file, in the output
     void
-CppFile::InsertText(const PositionType& lineCol, const StringType& text)
+CppFile::Merge(const EditSet& edits)
 {
-    LOG4CXX_DEBUG(log_s, "InsertText: " << CStringRef<StringType>(text) << " at " << lineCol);
-    size_t contentIndex = GetContentIndex(lineCol);
-    UpdateData newText = {contentIndex, Insert, text, contentIndex};
-    UpdateKey key(lineCol, 0);
-    while (0 < m_updates.count(key))
-        --key.second;
-    m_updates[key] = newText;
+    LOG4CXX_DEBUG(log_s, "Merge: " << edits.Size() << " changes into " << m_edits.Size());
+    m_edits.Merge(edits);
 }
 
 /// Initialize m_lineIndex
     void
 CppFile::SetLineIndex()
 {
-    m_lineIndex.clear();
-    m_lineIndex.push_back(0);
-    for (;;)
-    {
-        size_t eol = m_content.find('\n', m_lineIndex.back());
-        if (m_content.npos == eol)
-            break;
-        m_lineIndex.push_back(eol + 1);
-    }
-    LOG4CXX_DEBUG(log_s, "SetLineIndex: contentSize " << m_content.size() << " lineCount " << m_lineIndex.size());
+    m_lineIndex.Assign(m_content.data(), m_content.data() + m_content.size());
+    LOG4CXX_DEBUG(log_s, "SetLineIndex: contentSize " << m_content.size() << " lineCount " << m_lineIndex.GetLineCount());
 }
 
 
-/// Write the (possibly) modified content to \c path
+/// Write the (possibly) modified content to \c path unless it already holds that content
     bool
 CppFile::StoreFile(const PathType& path)
 {
     LOG4CXX_DEBUG(log_s, "StoreFile: " << path);
-    std::ofstream stream(path.c_str());
-    Store(stream);
-    stream.close();
-    return !stream.bad();
+    OutputFile::SpanStore spans;
+    GetOutput(spans);
+    boost::system::error_code ec;
+    bool isLoaded = !m_path.empty() && boost::filesystem::equivalent(path, m_path, ec);
+    OutputFile output(path);
+    bool ok = output.Store(spans, isLoaded ? &m_content : 0);
+    if (!output.IsChanged())
+        LOG4CXX_DEBUG(log_s, "StoreFile: " << (ok ? "unchanged " : "failed ") << path);
+    return ok;
 }
 
 /// Write the (possibly) modified content to \c os
     void
 CppFile::Store(std::ostream& os)
 {
+    OutputFile::SpanStore spans;
+    GetOutput(spans);
+    for (auto& span : spans)
+        os.write(span.data(), span.size());
+}
+
+/// Write the changes to \c os as a unified diff from \c oldName to \c newName,
+/// reading only the changed lines and DiffContextLineCount lines around them
+    void
+CppFile::StoreDiff(std::ostream& os, const StringType& oldName, const StringType& newName)
+{
+    typedef InputFile::ContentType TextType;
+    typedef std::vector<TextType> LineStore;
+    /// Old lines [first, first + oldLines.size()) are replaced by newLines
+    struct ChangeType
+    {
+        size_t first;
+        LineStore oldLines;
+        LineStore newLines;
+    };
+    const EditSet::UpdateStore& updates = m_edits.GetSortedUpdates();
+    std::vector<ChangeType> changes;
+    std::vector<StringType> newTexts(updates.size()); // Holds the content of ChangeType::newLines
+    size_t lineHint = 0;
+    for (size_t update = 0, changeCount = 0; update < updates.size(); ++changeCount)
+    {
+        // The updates on the same line are a change
+        size_t line = GetPosition(updates[update].at, &lineHint).line;
+        size_t start = GetLineStart(line), end = GetLineStart(line + 1);
+        StringType& newText = newTexts[changeCount];
+        size_t copied = start;
+        for (; update < updates.size() && (updates[update].at < end || m_content.size() <= end); ++update)
+        {
+            const EditSet::UpdateData& item = updates[update];
+            newText.append(m_content.data() + copied, item.at - copied);
+            if (EditSet::Delete != item.type)
+                newText.append(item.text.data(), item.text.size());
+            copied = item.resumeAt;
+            if (end < copied) // Replaced text extends beyond the line
+                end = GetLineStart(GetPosition(copied, &lineHint).line + 1);
+        }
+        newText.append(m_content.data() + copied, end - copied);
+        ChangeType change{line, SplitLines(m_content.substr(start, end - start)), SplitLines(newText)};
+        // Remove the lines that are unchanged
+        size_t prefixCount = 0;
+        while (prefixCount < change.oldLines.size() && prefixCount < change.newLines.size()
+            && change.oldLines[prefixCount] == change.newLines[prefixCount])
+            ++prefixCount;
+        size_t suffixCount = 0;
+        while (prefixCount + suffixCount < change.oldLines.size() && prefixCount + suffixCount < change.newLines.size()
+            && change.oldLines[change.oldLines.size() - suffixCount - 1] == change.newLines[change.newLines.size() - suffixCount - 1])
+            ++suffixCount;
+        change.first += prefixCount;
+        change.oldLines = LineStore(change.oldLines.begin() + prefixCount, change.oldLines.end() - suffixCount);
+        change.newLines = LineStore(change.newLines.begin() + prefixCount, change.newLines.end() - suffixCount);
+        if (change.oldLines.empty() && change.newLines.empty())
+            ;
+        else if (!changes.empty() && change.first == changes.back().first + changes.back().oldLines.size())
+        {
+            // Adjacent changes are one block of removed lines followed by the added lines
+            ChangeType& prev = changes.back();
+            prev.oldLines.insert(prev.oldLines.end(), change.oldLines.begin(), change.oldLines.end());
+            prev.newLines.insert(prev.newLines.end(), change.newLines.begin(), change.newLines.end());
+        }
+        else
+            changes.push_back(std::move(change));
+    }
+    if (changes.empty())
+        return;
+    os << "--- " << oldName << "\n+++ " << newName << "\n";
+    // The number of lines, excluding the empty line after a final line break
+    size_t lineCount = m_lineIndex.GetLineCount();
+    if (m_lineIndex.GetLineStart(lineCount) == m_content.size())
+        --lineCount;
+    ptrdiff_t lineOffset = 0; // The difference in line numbers of the new and old content
+    for (size_t first = 0; first < changes.size(); )
+    {
+        // Changes with overlapping context share a hunk
+        size_t last = first + 1;
+        while (last < changes.size() && changes[last].first
+            <= changes[last - 1].first + changes[last - 1].oldLines.size() + 2 * DiffContextLineCount)
+            ++last;
+        size_t hunkStart = changes[first].first <= DiffContextLineCount ? 1 : changes[first].first - DiffContextLineCount;
+        size_t hunkEnd = std::min(lineCount + 1
+            , changes[last - 1].first + changes[last - 1].oldLines.size() + DiffContextLineCount);
+        size_t oldCount = hunkEnd - hunkStart;
+        size_t newCount = oldCount;
+        for (size_t index = first; index < last; ++index)
+            newCount += changes[index].newLines.size() - changes[index].oldLines.size();
+        size_t newStart = hunkStart + lineOffset;
+        os << "@@ -" << (0 < oldCount ? hunkStart : hunkStart - 1) << ',' << oldCount
+            << " +" << (0 < newCount ? newStart : newStart - 1) << ',' << newCount << " @@\n";
+        size_t line = hunkStart;
+        for (size_t index = first; index < last; ++index)
+        {
+            const ChangeType& change = changes[index];
+            for (; line < change.first; ++line)
+                WriteDiffLine(os, ' ', m_content.substr(GetLineStart(line), GetLineStart(line + 1) - GetLineStart(line)));
+            for (auto& oldLine : change.oldLines)
+                WriteDiffLine(os, '-', oldLine);
+            for (auto& newLine : change.newLines)
+                WriteDiffLine(os, '+', newLine);
+            line += change.oldLines.size();
+        }
+        for (; line < hunkEnd; ++line)
+            WriteDiffLine(os, ' ', m_content.substr(GetLineStart(line), GetLineStart(line + 1) - GetLineStart(line)));
+        lineOffset += ptrdiff_t(newCount) - ptrdiff_t(oldCount);
+        first = last;
+    }
+}
+
+/// The segments of the (possibly) modified content
+    void
+CppFile::GetOutput(OutputFile::SpanStore& spans)
+{
+    const EditSet::UpdateStore& updates = m_edits.GetSortedUpdates();
     size_t outIndex = 0;
-    for (UpdateMap::const_iterator pUpdate = m_updates.begin()
-        ; pUpdate != m_updates.end()
+    for (EditSet::UpdateStore::const_iterator pUpdate = updates.begin()
+        ; pUpdate != updates.end()
         ; ++pUpdate)
     {
-        LOG4CXX_TRACE(log_s, "Store: at " << pUpdate->first.first);
-        const EditType& editType = pUpdate->second.type;
-        size_t copyToIndex = pUpdate->second.at;
+        HOT_PATH_TRACE(log_s, "GetOutput: at " << pUpdate->index);
+        const EditSet::EditType& editType = pUpdate->type;
+        size_t copyToIndex = pUpdate->at;
         if (outIndex < copyToIndex)
         {
-            LOG4CXX_TRACE(log_s, "Store: copy " << outIndex << " to " << copyToIndex);
-            os << m_content.substr(outIndex, copyToIndex - outIndex);
+            HOT_PATH_TRACE(log_s, "GetOutput: copy " << outIndex << " to " << copyToIndex);
+            spans.push_back(m_content.substr(outIndex, copyToIndex - outIndex));
         }
-        if (Delete != editType)
+        if (EditSet::Delete != editType && !pUpdate->text.empty())
         {
-            LOG4CXX_TRACE(log_s, "Store: insert " << CStringRef<StringType>(pUpdate->second.text));
-            os << pUpdate->second.text;
+            HOT_PATH_TRACE(log_s, "GetOutput: insert " << CStringRef<Arena::TextType>(pUpdate->text));
+            spans.push_back(pUpdate->text);
         }
-        outIndex = pUpdate->second.resumeAt;
+        outIndex = pUpdate->resumeAt;
     }
     if (outIndex < m_content.size())
     {
-        LOG4CXX_TRACE(log_s, "Store: copy " << outIndex << " to " << m_content.size());
-        os << m_content.substr(outIndex);
+        HOT_PATH_TRACE(log_s, "GetOutput: copy " << outIndex << " to " << m_content.size());
+        spans.push_back(m_content.substr(outIndex));
     }
 }
 
@@ -424,16 +688,83 @@ CppFile::FunctionIterator::m_log(log4cxx::Logger::getLogger("FunctionIterator"))
 /// An Off() iterator for function call names starting with \c prefix
 CppFile::FunctionIterator::FunctionIterator(CppFile& file, const StringType& prefix)
     : m_file(file)
-    , m_prefix(prefix)
-    , m_identifier(m_file.m_identiferPositions.end())
+    , m_edits(file.m_edits)
+    , m_lineHint(0)
+    , m_range(0)
+    , m_rule(0)
+    , m_identifierIndex(0)
+    , m_paramStartIndex(0)
+    , m_paramEndIndex(0)
+    , m_identifierOrdinal(0)
+    , m_paramEndOrdinal(0)
+    , m_identifier(0)
+    , m_identifierEnd(0)
+{
+    m_rules.AddFamily(prefix);
+}
+
+/// An Off() iterator for the function calls selected by \c rules
+CppFile::FunctionIterator::FunctionIterator(CppFile& file, const MacroRuleSet& rules)
+    : m_file(file)
+    , m_edits(file.m_edits)
+    , m_lineHint(0)
+    , m_rules(rules)
+    , m_range(0)
+    , m_rule(0)
+    , m_identifierIndex(0)
+    , m_paramStartIndex(0)
+    , m_paramEndIndex(0)
+    , m_identifierOrdinal(0)
+    , m_paramEndOrdinal(0)
+    , m_identifier(0)
+    , m_identifierEnd(0)
 {}
 
+/// An Off() iterator for the function calls in \c file selected by \c rules, recording changes in \c edits
+CppFile::FunctionIterator::FunctionIterator(const CppFile& file, EditSet& edits, const MacroRuleSet& rules)
+    : m_file(file)
+    , m_edits(edits)
+    , m_lineHint(0)
+    , m_rules(rules)
+    , m_range(0)
+    , m_rule(0)
+    , m_identifierIndex(0)
+    , m_paramStartIndex(0)
+    , m_paramEndIndex(0)
+    , m_identifierOrdinal(0)
+    , m_paramEndOrdinal(0)
+    , m_identifier(0)
+    , m_identifierEnd(0)
+{}
+
+/// A prefilter that rejects content without any function call names of interest to this
+    IdentifierPrefilter
+CppFile::FunctionIterator::GetPrefilter() const
+{
+    return m_rules.GetPrefilter();
+}
+
+/// A text that changes when the function calls of interest to this change
+    CppFile::StringType
+CppFile::FunctionIterator::GetSelectionKey() const
+{
+    return m_rules.GetSelectionKey();
+}
+
 /// Skip function calls matching \c identifierPrefix
     void
 CppFile::FunctionIterator::AddExclusion(const StringType& identifierPrefix)
 {
     LOG4CXX_DEBUG(m_log, "AddExclusion: " << identifierPrefix);
-    m_exclusions.push_back(identifierPrefix);
+    m_rules.AddExclusion(identifierPrefix);
+}
+
+/// Also select function call names starting with \c prefix, changing them as \c action requires
+    void
+CppFile::FunctionIterator::AddFamily(const StringType& prefix, MacroRuleSet::ActionType action)
+{
+    LOG4CXX_DEBUG(m_log, "AddFamily: " << prefix << ' ' << MacroRuleSet::GetActionName(action));
+    m_rules.AddFamily(prefix, action);
 }
 
 /// Add a semicolan after the closing parenthesis
@@ -441,8 +772,7 @@ CppFile::FunctionIterator::AddExclusion(const StringType& identifierPrefix)
 CppFile::FunctionIterator::AddSemicolon()
 {
     LOG4CXX_DEBUG(m_log, "AddSemicolon: " << m_item.paramEnd);
-    PositionType insertPos = { m_item.paramEnd.line, m_item.paramEnd.column + 1};
-    m_file.InsertText(insertPos, ";");
+    m_edits.InsertText(m_paramEndIndex + 1, ";");
 }
 
 /// Add an opening before the function and a closing brace after the statement
@@ -450,67 +780,60 @@ CppFile::FunctionIterator::AddSemicolon()
 CppFile::FunctionIterator::InsertBraces()
 {
     LOG4CXX_DEBUG(m_log, "InsertBraces: " << m_item.identifier << " to " << m_item.paramEnd);
-    PositionType previousToken;
-    m_file.GetNonWhitespaceTokenBefore(m_item.identifier, &previousToken);
+    const TokenTable& tokens = m_file.m_tokens;
+    size_t previous = tokens.PreviousSignificant(m_identifierOrdinal);
+    size_t previousToken = previous < tokens.Size() ? tokens.GetOffset(previous) : 0;
+    size_t previousLine = m_file.GetPosition(previousToken, &m_lineHint).line;
     StringType indent;
-    if (previousToken.line < m_item.identifier.line)
-    {
-        PositionType startOfPreviousLine = {previousToken.line, 1};
-        PositionType firstTokenOfPreviousLine;
-        m_file.GetNonWhitespaceTokenAfter(startOfPreviousLine, &firstTokenOfPreviousLine);
-        size_t previousIndex[2] =
-            { m_file.GetContentIndex(startOfPreviousLine)
-            , m_file.GetContentIndex(firstTokenOfPreviousLine)
-            };
-        indent = m_file.m_content.substr(previousIndex[0], previousIndex[1] - previousIndex[0]);
-        PositionType startOfLine = {m_item.identifier.line, 1};
-        m_file.InsertText(startOfLine, indent + "{\n");
-    }
-    else
-        m_file.InsertText(m_item.identifier, "{");
-    PositionType nextToken;
-    m_file.GetNonWhitespaceTokenAfter(m_item.paramEnd, &nextToken);
-    if (m_item.identifier.line < nextToken.line)
+    if (previousLine < m_item.identifier.line)
     {
-        PositionType startOfNextLine = {m_item.paramEnd.line + 1, 1};
-        m_file.InsertText(startOfNextLine, indent + "}\n");
+        size_t startOfPreviousLine = m_file.GetLineStart(previousLine);
+        size_t ordinal = tokens.LowerBound(startOfPreviousLine);
+        if (ordinal < tokens.Size() && tokens.IsWhitespace(ordinal))
+            ordinal = tokens.NextSignificant(ordinal);
+        size_t firstTokenOfPreviousLine = ordinal < tokens.Size() ? tokens.GetOffset(ordinal) : m_file.m_content.size();
+        indent = StringType(m_file.m_content.substr(startOfPreviousLine, firstTokenOfPreviousLine - startOfPreviousLine));
+        m_edits.InsertText(m_file.GetLineStart(m_item.identifier.line), indent + "{\n");
     }
     else
-        m_file.AppendText(m_item.paramEnd, " }");
+        m_edits.InsertText(m_identifierIndex, "{");
+    size_t next = tokens.NextSignificant(m_paramEndOrdinal);
+    size_t nextToken = next < tokens.Size() ? tokens.GetOffset(next) : m_file.m_content.size();
+    if (m_item.identifier.line < m_file.GetPosition(nextToken, &m_lineHint).line)
+        m_edits.InsertText(m_file.GetLineStart(m_item.paramEnd.line + 1), indent + "}\n");
+    else
+        m_edits.AppendText(m_paramEndIndex, " }");
 }
 
-/// Is the next non-white-space token a semicolon or comma? - Precondition: !Off()
+/// Is the next non-white-space token a semicolon, colon or comma? - Precondition: !Off()
     bool
 CppFile::FunctionIterator::HasStatementTerminator() const
 {
-    boost::wave::token_id tokenId = m_file.GetNonWhitespaceTokenAfter(m_item.paramEnd);
-    return boost::wave::T_SEMICOLON == tokenId ||
-           boost::wave::T_COLON == tokenId ||
-           boost::wave::T_COMMA == tokenId;
+    const TokenTable& tokens = m_file.m_tokens;
+    return CallStatement::IsTerminated(tokens.GetIdOrEnd(tokens.NextSignificant(m_paramEndOrdinal)));
 }
 
 /// Is the previous non-white-space token not in [else, comma, semicolon, brace]? - Precondition: !Off()
     bool
 CppFile::FunctionIterator::IsCompoundStatementBody() const
 {
-    PositionType previousToken;
-    boost::wave::token_id tokenId = m_file.GetNonWhitespaceTokenBefore(m_item.identifier, &previousToken);
+    const TokenTable& tokens = m_file.m_tokens;
+    size_t previous = tokens.PreviousSignificant(m_identifierOrdinal);
+    boost::wave::token_id tokenId = tokens.GetIdOrEnd(previous);
+    boost::wave::token_id statementId = boost::wave::T_EOI;
+    bool isChangedBefore = false;
     if (boost::wave::T_RIGHTPAREN == tokenId)
     {
-        boost::wave::token_id statementId = m_file.GetNonWhitespaceTokenBeforeOtherParen(previousToken);
-        return boost::wave::T_CATCH == statementId ||
-               boost::wave::T_FOR == statementId ||
-               boost::wave::T_IF == statementId ||
-               boost::wave::T_SWITCH == statementId ||
-               boost::wave::T_WHILE == statementId;
+        size_t mate = tokens.GetMate(previous);
+        if (mate < tokens.Size())
+            statementId = tokens.GetIdOrEnd(tokens.PreviousSignificant(mate));
     }
-    return !m_file.HasUpdateBetween(previousToken, m_item.identifier) &&
-           boost::wave::T_ELSE != tokenId &&
-           boost::wave::T_LEFTBRACE != tokenId &&
-           boost::wave::T_RIGHTBRACE != tokenId &&
-           boost::wave::T_COLON != tokenId &&
-           boost::wave::T_SEMICOLON != tokenId &&
-           boost::wave::T_COMMA != tokenId;
+    else
+    {
+        size_t previousToken = previous < tokens.Size() ? tokens.GetOffset(previous) : 0;
+        isChangedBefore = m_edits.HasUpdateBetween(previousToken, m_identifierIndex);
+    }
+    return CallStatement::IsCompoundStatementBody(tokenId, statementId, isChangedBefore);
 }
 
 /// Move to the next item. Precondition: !Off()
@@ -532,23 +855,31 @@ CppFile::FunctionIterator::Forth()
     bool
 CppFile::FunctionIterator::Off() const
 {
-    return m_file.m_identiferPositions.end() == m_identifier ||
-        0 != m_identifier->first.compare(0, m_prefix.size(), m_prefix);
+    return m_ranges.size() <= m_range;
 }
 
 // Set \c m_item - Precondition: !OffInstance()
     bool
 CppFile::FunctionIterator::SetItem()
 {
-    m_item.identifier = *m_instance;
-    boost::wave::token_id tokenId = m_file.GetNonWhitespaceTokenAfter(*m_instance, &m_item.paramStart);
-    if (boost::wave::T_LEFTPAREN != tokenId)
+    const TokenTable& tokens = m_file.m_tokens;
+    m_identifierIndex = *m_instance;
+    m_item.identifier = m_file.GetPosition(m_identifierIndex, &m_lineHint);
+    m_identifierOrdinal = tokens.LowerBound(m_identifierIndex);
+    size_t paramStart = tokens.NextSignificant(m_identifierOrdinal);
+    if (tokens.Size() <= paramStart || boost::wave::T_LEFTPAREN != tokens.GetId(paramStart))
+        return false;
+    size_t paramEnd = tokens.GetMate(paramStart);
+    if (tokens.Size() <= paramEnd)
         return false;
-    IndexMap::const_iterator closeParen = m_file.m_parenMate.find(m_item.paramStart);
-    if (m_file.m_parenMate.end() == closeParen)
+    m_paramEndOrdinal = paramEnd;
+    m_paramStartIndex = tokens.GetOffset(paramStart);
+    m_paramEndIndex = tokens.GetOffset(paramEnd);
+    m_item.paramStart = m_file.GetPosition(m_paramStartIndex, &m_lineHint);
+    m_item.paramEnd = m_file.GetPosition(m_paramEndIndex, &m_lineHint);
+    if (!m_file.IsInLineRanges(m_item.identifier.line, m_item.paramEnd.line))
         return false;
-    m_item.paramEnd = closeParen->second;
-    LOG4CXX_DEBUG(m_log, m_identifier->first
+    HOT_PATH_DEBUG(m_log, m_file.m_identifiers.GetName(m_identifier)
         << " at " << m_item.identifier
         << " to " << m_item.paramEnd
         );
@@ -559,8 +890,34 @@ CppFile::FunctionIterator::SetItem()
     void
 CppFile::FunctionIterator::Start()
 {
-    LOG4CXX_DEBUG(m_log, "Start: " << m_prefix);
-    m_identifier = m_file.m_identiferPositions.lower_bound(m_prefix);
+    LOG4CXX_DEBUG(m_log, "Start: " << m_rules.GetSelectionKey());
+    // The ranks of the names starting with each family prefix, merging nested prefixes
+    m_ranges.clear();
+    for (size_t index = 0; index < m_rules.Size(); ++index)
+    {
+        const MacroRuleSet::RuleType& rule = m_rules.GetRule(index);
+        if (rule.isExclusion)
+            continue;
+        IdentifierTable::RangeType range = m_file.m_identifiers.GetPrefixRange(rule.prefix);
+        if (range.first < range.second)
+            m_ranges.push_back(range);
+    }
+    std::sort(m_ranges.begin(), m_ranges.end());
+    size_t mergedCount = 0;
+    for (auto& range : m_ranges)
+    {
+        if (0 < mergedCount && range.first <= m_ranges[mergedCount - 1].second)
+            m_ranges[mergedCount - 1].second = std::max(m_ranges[mergedCount - 1].second, range.second);
+        else
+            m_ranges[mergedCount++] = range;
+    }
+    m_ranges.resize(mergedCount);
+    m_range = 0;
+    if (!m_ranges.empty())
+    {
+        m_identifier = m_ranges.front().first;
+        m_identifierEnd = m_ranges.front().second;
+    }
     StartInstance();
 }
 
@@ -570,14 +927,21 @@ CppFile::FunctionIterator::StartInstance()
 {
     while (!Off())
     {
-        LOG4CXX_TRACE(m_log, m_identifier->first);
-        if (m_exclusions.end() == std::find_if(m_exclusions.begin(), m_exclusions.end(),
-            [this](const StringType& prefix) -> bool
-                { return 0 == m_identifier->first.compare(0, prefix.size(), prefix); }
-            ))
+        if (m_identifierEnd <= m_identifier)
+        {
+            if (++m_range < m_ranges.size())
+            {
+                m_identifier = m_ranges[m_range].first;
+                m_identifierEnd = m_ranges[m_range].second;
+            }
+            continue;
+        }
+        HOT_PATH_TRACE(m_log, m_file.m_identifiers.GetName(m_identifier));
+        m_rule = m_rules.FindRule(m_file.m_identifiers.GetName(m_identifier));
+        if (MacroRuleSet::NoRule != m_rule)
         {
-            m_instance = m_identifier->second.begin();
-            m_instanceEnd = m_identifier->second.end();
+            m_instance = m_file.m_identifiers.BeginInstance(m_identifier);
+            m_instanceEnd = m_file.m_identifiers.EndInstance(m_identifier);
             while (!OffInstance())
             {
                 if (SetItem())
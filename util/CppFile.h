@@ -1,11 +1,26 @@
 #if !defined(CPP_FILE_INCLUDED)
 #define CPP_FILE_INCLUDED
+#include "CppLexer.h"
+#include "EditSet.h"
+#include "IdentifierPrefilter.h"
+#include "IdentifierTable.h"
+#include "InputFile.h"
+#include "LineIndex.h"
+#include "MacroRuleSet.h"
+#include "OutputFile.h"
+#include "PhaseStats.h"
+#include "TokenTable.h"
 #include <boost/filesystem.hpp>
 #include <boost/wave/token_ids.hpp>
 #include <boost/wave/wave_config.hpp>
 #include <log4cxx/logger.h>
-#include <map>
+#include <array>
 
+/// The tokens, parentheses and identifiers of a C++ file and the changes to be made to it.
+///
+/// Once loaded, the const methods do not change this, so several FunctionIterators,
+/// each recording its changes in its own EditSet, can analyse the file concurrently.
+/// Their changes are included in the output after being given to Merge().
 class CppFile
 {
 public: // Types
@@ -23,60 +38,109 @@ public: // Types
             return line == other.line && column == other.column;
         }
     };
+    /// Lines \c first to \c last (1-based and inclusive)
+    struct LineRange
+    {
+        size_t first, last;
+        bool operator<(LineRange const& other) const
+        {
+            return first < other.first || (first == other.first && last < other.last);
+        }
+    };
+    typedef std::vector<LineRange> LineRangeStore;
     class FunctionIterator;
     class CustomDirectivesHooks;
+    /// The tokenizer used by LoadFile
+    enum LexerType
+    { LexerOnly   //!< CppLexer, which skips preprocessor directives
+    , WaveContext //!< A boost::wave::context that does not process directives
+    };
+    /// How LoadFile obtains the file content
+    enum InputType
+    { MappedInput   //!< Map regular files into memory, reading other files
+    , BufferedInput //!< Read all files into a buffer
+    };
 
 protected: // Types
     typedef boost::wave::token_id TokenId;
-    typedef std::map<PositionType, TokenId> IndexedToken;
-    typedef std::map<PositionType, PositionType> IndexMap;
-    typedef std::vector<PositionType> PositionStore;
-    typedef std::map<StringType, PositionStore> StringPositionMap;
-    enum EditType { Delete, Insert, Modify };
-    struct UpdateData
-    {
-        size_t     at;
-        EditType   type;
-        StringType text;
-        size_t     resumeAt;
-    };
-    typedef std::pair<PositionType, int> UpdateKey;
-    typedef std::map<UpdateKey, UpdateData> UpdateMap;
     typedef std::vector<size_t> IndexStore;
+    typedef std::array<IndexStore, TokenTable::BracketKindCount> BracketStack;
 
 private: // Attributes
-    std::string m_content;
-    IndexStore m_lineIndex;
+    LexerType m_lexerType;
+    InputType m_inputType;
+    CppLexer m_lexer;
+    IdentifierPrefilter m_prefilter;
+    bool m_isPrefiltered;
+    PathType m_path;
+    InputFile m_input;
+    InputFile::ContentType m_content;
+    LineIndex m_lineIndex;
     PositionType m_processed;
-    IndexedToken m_tokenPositions;
-    IndexMap m_parenMate;
-    StringPositionMap m_identiferPositions;
-    UpdateMap m_updates;
+    TokenTable m_tokens;
+    IdentifierTable m_identifiers;
+    EditSet m_edits; //!< The changes to be output, cleared for each file
+    LineRangeStore m_lineRanges; //!< The lines to which analysis is restricted, in order (or empty)
+    PhaseStats* m_stats;
 
 public: // ...structors
-    CppFile() {}
-    CppFile(const PathType& path)
+    CppFile(LexerType lexerType = LexerOnly, InputType inputType = MappedInput)
+        : m_lexerType(lexerType)
+        , m_inputType(inputType)
+        , m_isPrefiltered(false)
+        , m_stats(0)
+    {}
+    CppFile(const PathType& path, LexerType lexerType = LexerOnly, InputType inputType = MappedInput)
+        : m_lexerType(lexerType)
+        , m_inputType(inputType)
+        , m_isPrefiltered(false)
+        , m_stats(0)
     { LoadFile(path); }
 
 public: // Accessors
-    size_t GetIdentifierCount(const StringType& name) const;
-    size_t GetFunctionCount(const StringType& name) const;
+    size_t GetIdentifierCount(IdentifierTable::NameType name) const;
+    size_t GetFunctionCount(IdentifierTable::NameType name) const;
     bool IsValid() const;
+    bool IsPrefiltered() const { return m_isPrefiltered; }
+    bool IsInLineRanges(size_t first, size_t last) const;
+    size_t GetContentSize() const { return m_content.size(); }
+    size_t GetTokenCount() const { return m_tokens.Size(); }
+    size_t GetDistinctIdentifierCount() const { return m_identifiers.Size(); }
+    LexerType GetLexerType() const { return m_lexerType; }
+    InputType GetInputType() const { return m_inputType; }
+    const Arena& GetArena() const { return m_edits.GetArena(); }
+    const EditSet& GetEdits() const { return m_edits; }
 
 public: // Modifiers
+    void SetLexerType(LexerType lexerType) { m_lexerType = lexerType; }
+    void SetInputType(InputType inputType) { m_inputType = inputType; }
+    void SetPrefilter(const IdentifierPrefilter& prefilter) { m_prefilter = prefilter; }
+    void SetStats(PhaseStats* stats) { m_stats = stats; }
+    void SetLineRanges(const LineRangeStore& ranges);
+    void Reset();
     bool LoadFile(const PathType& path);
+    bool LoadFile(const PathType& path, InputFile& input);
     bool StoreFile(const PathType& path);
     void Store(std::ostream& os);
+    void StoreDiff(std::ostream& os, const StringType& oldName, const StringType& newName);
+    void Merge(const EditSet& edits);
 
 protected: // Support methods
-    void AppendText(const PositionType& lineCol, const StringType& text);
-    void InsertText(const PositionType& lineCol, const StringType& text);
+    void GetOutput(OutputFile::SpanStore& spans);
     size_t GetContentIndex(const PositionType& index) const;
-    boost::wave::token_id GetNonWhitespaceTokenAfter(const PositionType& index, PositionType* resultIndex = 0) const;
-    boost::wave::token_id GetNonWhitespaceTokenBefore(const PositionType& index, PositionType* resultIndex = 0) const;
-    boost::wave::token_id GetNonWhitespaceTokenBeforeOtherParen(const PositionType& index, PositionType* resultIndex = 0) const;
-    bool HasUpdateBetween(const PositionType& start, const PositionType& end) const;
+    size_t GetLineStart(size_t line) const;
+    PositionType GetPosition(size_t index, size_t* lineHint = 0) const;
+    boost::wave::token_id GetNonWhitespaceTokenAfter(size_t index, size_t* resultIndex = 0) const;
+    void IndexToken(TokenId tokenId, size_t index, BracketStack& openBrackets);
+    bool LoadInput(const PathType& path);
+    bool LoadLexerTokens(const PathType& path);
+    void LoadLexerTokens(const PathType& path, size_t windowEnd, BracketStack& openBrackets);
+    bool LoadWaveTokens(const PathType& path);
     void SetLineIndex();
+
+public: // Class data
+    static const size_t ContextLineCount = 10; //!< The lines before a line range that are also tokenized
+    static const size_t DiffContextLineCount = 3; //!< The unchanged lines around each change in a unified diff
 };
 
 /// Allows operations to be selectively performed on matched function call style instances
@@ -91,27 +155,52 @@ public: // Types
         PositionType paramEnd;
     };
 private: // Types
-    typedef std::vector<StringType> StringStore;
+    typedef std::vector<IdentifierTable::RangeType> RangeStore;
 
 private: // Attributes
-    CppFile& m_file; //!< The owner of this
-    StringType m_prefix; //!< Of the function of interest
-    StringStore m_exclusions; //!< Ignored function call identifier prefixes
+    const CppFile& m_file; //!< The owner of this
+    EditSet& m_edits; //!< Where changes are recorded
+    size_t m_lineHint; //!< The line of the position most recently found in m_file
+    MacroRuleSet m_rules; //!< Selects the functions of interest
+    RangeStore m_ranges; //!< The ranks of the identifiers starting with a macro family prefix, in order
+    size_t m_range; //!< The position in m_ranges of the current identifier
+    size_t m_rule; //!< The position in m_rules of the rule governing the current identifier
     ItemType m_item; //!< The current item
-    StringPositionMap::const_iterator m_identifier; //!< Position in the identifier map
-    PositionStore::const_iterator m_instance; //!< Position in the instances of the current identifier
-    PositionStore::const_iterator m_instanceEnd; //!< Sentinal of the instances of the current identifier
+    size_t m_identifierIndex; //!< The content index of m_item.identifier
+    size_t m_paramStartIndex; //!< The content index of m_item.paramStart
+    size_t m_paramEndIndex; //!< The content index of m_item.paramEnd
+    size_t m_identifierOrdinal; //!< The position in the token table of m_item.identifier
+    size_t m_paramEndOrdinal; //!< The position in the token table of m_item.paramEnd
+    size_t m_identifier; //!< The rank of the current identifier
+    size_t m_identifierEnd; //!< The rank after the last identifier in the current range
+    IdentifierTable::InstanceIterator m_instance; //!< Position in the instances of the current identifier
+    IdentifierTable::InstanceIterator m_instanceEnd; //!< Sentinal of the instances of the current identifier
 
 public: // ...structors
     /// An Off() iterator for function call names starting with \c prefix
     FunctionIterator(CppFile& file, const StringType& prefix);
 
+    /// An Off() iterator for the function calls selected by \c rules
+    FunctionIterator(CppFile& file, const MacroRuleSet& rules);
+
+    /// An Off() iterator for the function calls in \c file selected by \c rules, recording changes in \c edits
+    FunctionIterator(const CppFile& file, EditSet& edits, const MacroRuleSet& rules);
+
 public: // Property modifiers
     /// Skip function calls matching \c identifierPrefix
     void AddExclusion(const StringType& identifierPrefix);
 
+    /// Also select function call names starting with \c prefix, changing them as \c action requires
+    void AddFamily(const StringType& prefix, MacroRuleSet::ActionType action = MacroRuleSet::DefaultAction);
+
 public: // Accessors
-    /// Is the next non-white-space token a semicolon or comma? - Precondition: !Off()
+    /// A prefilter that rejects content without any function call names of interest to this
+    IdentifierPrefilter GetPrefilter() const;
+
+    /// A text that changes when the function calls of interest to this change
+    StringType GetSelectionKey() const;
+
+    /// Is the next non-white-space token a semicolon, colon or comma? - Precondition: !Off()
     bool HasStatementTerminator() const;
 
     /// Is the previous non-white-space token not in [else, comma, semicolon, brace]? - Precondition: !Off()
@@ -120,6 +209,12 @@ public: // Accessors
     /// The current item - Precondition: !Off()
     const ItemType& Item() const { return m_item; }
 
+    /// The rule that selected the current item - Precondition: !Off()
+    const MacroRuleSet::RuleType& GetRule() const { return m_rules.GetRule(m_rule); }
+
+    /// The function calls of interest
+    const MacroRuleSet& GetRules() const { return m_rules; }
+
     /// Is this iterator beyond the end or before the start?
     bool Off() const;
 
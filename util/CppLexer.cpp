@@ -0,0 +1,696 @@
+#include "CppLexer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    using namespace boost::wave;
+
+    /// A reserved word and its token
+    struct Keyword
+    {
+        const char* name;
+        token_id    id;
+    };
+
+    /// Reserved words in strcmp order
+    const Keyword s_keywords[] =
+    { { "alignas", T_ALIGNAS }
+    , { "alignof", T_ALIGNOF }
+    , { "and", T_ANDAND_ALT }
+    , { "and_eq", T_ANDASSIGN_ALT }
+    , { "asm", T_ASM }
+    , { "auto", T_AUTO }
+    , { "bitand", T_AND_ALT }
+    , { "bitor", T_OR_ALT }
+    , { "bool", T_BOOL }
+    , { "break", T_BREAK }
+    , { "case", T_CASE }
+    , { "catch", T_CATCH }
+    , { "char", T_CHAR }
+    , { "char16_t", T_CHAR16_T }
+    , { "char32_t", T_CHAR32_T }
+    , { "class", T_CLASS }
+    , { "compl", T_COMPL_ALT }
+    , { "const", T_CONST }
+    , { "const_cast", T_CONSTCAST }
+    , { "constexpr", T_CONSTEXPR }
+    , { "continue", T_CONTINUE }
+    , { "decltype", T_DECLTYPE }
+    , { "default", T_DEFAULT }
+    , { "delete", T_DELETE }
+    , { "do", T_DO }
+    , { "double", T_DOUBLE }
+    , { "dynamic_cast", T_DYNAMICCAST }
+    , { "else", T_ELSE }
+    , { "enum", T_ENUM }
+    , { "explicit", T_EXPLICIT }
+    , { "export", T_EXPORT }
+    , { "extern", T_EXTERN }
+    , { "false", T_FALSE }
+    , { "float", T_FLOAT }
+    , { "for", T_FOR }
+    , { "friend", T_FRIEND }
+    , { "goto", T_GOTO }
+    , { "if", T_IF }
+    , { "inline", T_INLINE }
+    , { "int", T_INT }
+    , { "long", T_LONG }
+    , { "mutable", T_MUTABLE }
+    , { "namespace", T_NAMESPACE }
+    , { "new", T_NEW }
+    , { "noexcept", T_NOEXCEPT }
+    , { "not", T_NOT_ALT }
+    , { "not_eq", T_NOTEQUAL_ALT }
+    , { "nullptr", T_NULLPTR }
+    , { "operator", T_OPERATOR }
+    , { "or", T_OROR_ALT }
+    , { "or_eq", T_ORASSIGN_ALT }
+    , { "private", T_PRIVATE }
+    , { "protected", T_PROTECTED }
+    , { "public", T_PUBLIC }
+    , { "register", T_REGISTER }
+    , { "reinterpret_cast", T_REINTERPRETCAST }
+    , { "return", T_RETURN }
+    , { "short", T_SHORT }
+    , { "signed", T_SIGNED }
+    , { "sizeof", T_SIZEOF }
+    , { "static", T_STATIC }
+    , { "static_assert", T_STATICASSERT }
+    , { "static_cast", T_STATICCAST }
+    , { "struct", T_STRUCT }
+    , { "switch", T_SWITCH }
+    , { "template", T_TEMPLATE }
+    , { "this", T_THIS }
+    , { "thread_local", T_THREADLOCAL }
+    , { "throw", T_THROW }
+    , { "true", T_TRUE }
+    , { "try", T_TRY }
+    , { "typedef", T_TYPEDEF }
+    , { "typeid", T_TYPEID }
+    , { "typename", T_TYPENAME }
+    , { "union", T_UNION }
+    , { "unsigned", T_UNSIGNED }
+    , { "using", T_USING }
+    , { "virtual", T_VIRTUAL }
+    , { "void", T_VOID }
+    , { "volatile", T_VOLATILE }
+    , { "wchar_t", T_WCHART }
+    , { "while", T_WHILE }
+    , { "xor", T_XOR_ALT }
+    , { "xor_eq", T_XORASSIGN_ALT }
+    };
+
+    /// The token for the identifier [first, last)
+    token_id GetWordToken(const char* first, const char* last)
+    {
+        size_t length = last - first;
+        auto pItem = std::lower_bound(std::begin(s_keywords), std::end(s_keywords), first,
+            [length](const Keyword& item, const char* word) -> bool
+            {
+                int diff = strncmp(item.name, word, length);
+                return diff < 0 || (0 == diff && strlen(item.name) < length);
+            });
+        if (std::end(s_keywords) != pItem
+            && 0 == strncmp(pItem->name, first, length)
+            && '\0' == pItem->name[length])
+            return pItem->id;
+        return T_IDENTIFIER;
+    }
+
+    /// Can \c ch start an identifier?
+    inline bool IsIdentifierStart(char ch)
+    {
+        unsigned char uch = static_cast<unsigned char>(ch);
+        return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') || '_' == ch || 0x80 <= uch;
+    }
+
+    /// Can \c ch continue an identifier?
+    inline bool IsIdentifierPart(char ch)
+    {
+        return IsIdentifierStart(ch) || ('0' <= ch && ch <= '9');
+    }
+
+    /// Is \c ch a decimal digit?
+    inline bool IsDigit(char ch)
+    {
+        return '0' <= ch && ch <= '9';
+    }
+
+    /// Is \c ch non-line-breaking white space?
+    inline bool IsSpace(char ch)
+    {
+        return ' ' == ch || '\t' == ch || '\v' == ch || '\f' == ch || '\r' == ch;
+    }
+
+    /// Is [first, last) an encoding prefix of a character or string literal?
+    bool IsEncodingPrefix(const char* first, const char* last)
+    {
+        size_t length = last - first;
+        return (1 == length && ('L' == *first || 'u' == *first || 'U' == *first))
+            || (2 == length && 'u' == first[0] && '8' == first[1]);
+    }
+}
+
+/// An Off() scanner
+CppLexer::CppLexer()
+    : m_begin(0)
+    , m_end(0)
+    , m_next(0)
+    , m_lineStart(0)
+    , m_line(1)
+    , m_atLineStart(true)
+    , m_off(true)
+{}
+
+/// Move to the first token in the content [first, last)
+    void
+CppLexer::Start(const char* first, const char* last)
+{
+    m_begin = m_next = m_lineStart = first;
+    m_end = last;
+    m_line = 1;
+    m_atLineStart = true;
+    m_off = false;
+    m_error.clear();
+    SetItem();
+}
+
+/// Move to the next token. Precondition: !Off()
+    void
+CppLexer::Forth()
+{
+    if (boost::wave::T_EOF == m_item.id)
+        m_off = true;
+    else
+        SetItem();
+}
+
+/// Set m_item to the token at m_next and move m_next beyond it
+    void
+CppLexer::SetItem()
+{
+    while (m_atLineStart && IsDirective(m_next))
+        SkipDirective();
+    const char* first = m_next;
+    const char* last = first + 1;
+    m_item.offset = first - m_begin;
+    m_item.line = m_line;
+    m_item.column = first - m_lineStart + 1;
+    TokenId id = boost::wave::T_UNKNOWN;
+    bool atLineStart = false;
+    if (m_end <= first)
+    {
+        id = boost::wave::T_EOF;
+        last = first;
+    }
+    else if ('\n' == *first || ('\r' == *first && last < m_end && '\n' == *last))
+    {
+        id = boost::wave::T_NEWLINE;
+        if ('\r' == *first)
+            ++last;
+        atLineStart = true;
+    }
+    else if (IsSpace(*first))
+    {
+        id = boost::wave::T_SPACE;
+        while (last < m_end && IsSpace(*last) && !('\r' == *last && last + 1 < m_end && '\n' == last[1]))
+            ++last;
+        atLineStart = m_atLineStart;
+    }
+    else if (size_t length = ContinuationLength(first))
+    {
+        id = boost::wave::T_CONTLINE;
+        last = first + length;
+        atLineStart = m_atLineStart;
+    }
+    else if ('/' == *first && last < m_end && '*' == *last)
+    {
+        id = boost::wave::T_CCOMMENT;
+        last = ScanCComment(first);
+        atLineStart = m_atLineStart;
+    }
+    else if ('/' == *first && last < m_end && '/' == *last)
+    {
+        id = boost::wave::T_CPPCOMMENT;
+        last = ScanCppComment(first);
+        atLineStart = '\n' == last[-1];
+    }
+    else if (IsIdentifierStart(*first))
+    {
+        last = ScanWord(first, id);
+        if (boost::wave::T_IDENTIFIER == id)
+            id = GetWordToken(first, last);
+    }
+    else if (IsDigit(*first) || ('.' == *first && last < m_end && IsDigit(*last)))
+        last = ScanNumber(first, id);
+    else if ('"' == *first || '\'' == *first)
+    {
+        const char* literalEnd = ScanQuoted(first);
+        if (first < literalEnd)
+        {
+            id = '"' == *first ? boost::wave::T_STRINGLIT : boost::wave::T_CHARLIT;
+            last = literalEnd;
+        }
+    }
+    else
+        last = ScanOperator(first, id);
+    if (HasError())
+    {
+        m_off = true;
+        return;
+    }
+    m_item.id = id;
+    m_item.length = last - first;
+    CountLines(first, last);
+    m_item.newlineCount = m_line - m_item.line;
+    m_atLineStart = atLineStart;
+    m_next = last;
+}
+
+/// Move over the content before \c target, stopping at the first token at or after \c target
+/// or, when a parenthesis opened in the skipped content is still open at \c target, at the word before the outermost one.
+/// Only comments, literals, directives and parentheses are recognised in the skipped content. Precondition: !Off()
+    void
+CppLexer::SkipTo(const char* target)
+{
+    const char* p = m_next;
+    bool atLineStart = m_atLineStart;
+    size_t depth = 0; // Of the open parentheses
+    const char* wordStart = 0; // Of the word that is the last token (or null)
+    bool wordAtLineStart = false;
+    const char* groupStart = 0; // Of the word (or parenthesis) that opens the outermost open parenthesis (or null)
+    bool groupAtLineStart = false;
+    while (p < target && !HasError())
+    {
+        if (atLineStart && IsDirective(p))
+        {
+            CountLines(m_next, p);
+            m_next = p;
+            SkipDirective();
+            p = m_next;
+            groupStart = 0; // Lines are counted, so it cannot be returned to
+            continue;
+        }
+        if ('\n' == *p)
+        {
+            ++p;
+            atLineStart = true;
+        }
+        else if (IsSpace(*p))
+            ++p;
+        else if (size_t length = ContinuationLength(p))
+            p += length;
+        else if ('/' == *p && p + 1 < m_end && '*' == p[1])
+            p = ScanCComment(p);
+        else if ('/' == *p && p + 1 < m_end && '/' == p[1])
+        {
+            p = ScanCppComment(p);
+            atLineStart = '\n' == p[-1];
+        }
+        else
+        {
+            bool tokenAtLineStart = atLineStart;
+            const char* tokenStart = p;
+            atLineStart = false;
+            TokenId id;
+            if (IsIdentifierStart(*p))
+                p = ScanWord(p, id);
+            else if (IsDigit(*p) || ('.' == *p && p + 1 < m_end && IsDigit(p[1])))
+                p = ScanNumber(p, id);
+            else if ('"' == *p || '\'' == *p)
+            {
+                const char* literalEnd = ScanQuoted(p);
+                p = p < literalEnd ? literalEnd : p + 1;
+            }
+            else
+            {
+                if ('(' == *p && 0 == depth++)
+                {
+                    groupStart = wordStart ? wordStart : p;
+                    groupAtLineStart = wordStart ? wordAtLineStart : tokenAtLineStart;
+                }
+                else if (')' == *p && 0 < depth)
+                    --depth;
+                ++p;
+            }
+            bool isWord = IsIdentifierStart(*tokenStart);
+            wordStart = isWord ? tokenStart : 0;
+            wordAtLineStart = tokenAtLineStart;
+        }
+    }
+    if (HasError())
+    {
+        m_off = true;
+        return;
+    }
+    if (0 < depth && groupStart)
+    {
+        p = groupStart;
+        atLineStart = groupAtLineStart;
+    }
+    CountLines(m_next, p);
+    m_next = p;
+    m_atLineStart = atLineStart;
+    SetItem();
+}
+
+/// Does a preprocessor directive start at \c p (after any white space)?
+    bool
+CppLexer::IsDirective(const char* p) const
+{
+    while (p < m_end && (' ' == *p || '\t' == *p))
+        ++p;
+    return p < m_end && '#' == *p;
+}
+
+/// Move m_next over a preprocessor directive and its line break
+    void
+CppLexer::SkipDirective()
+{
+    const char* p = static_cast<const char*>(memchr(m_next, '#', m_end - m_next)) + 1;
+    while (p < m_end && !HasError())
+    {
+        if ('\n' == *p)
+        {
+            ++p;
+            break;
+        }
+        else if (size_t length = ContinuationLength(p))
+            p += length;
+        else if ('/' == *p && p + 1 < m_end && '*' == p[1])
+            p = ScanCComment(p);
+        else if ('/' == *p && p + 1 < m_end && '/' == p[1])
+        {
+            p = ScanCppComment(p);
+            break;
+        }
+        else if ('"' == *p || '\'' == *p)
+        {
+            const char* literalEnd = ScanQuoted(p);
+            p = p < literalEnd ? literalEnd : p + 1;
+        }
+        else
+            ++p;
+    }
+    CountLines(m_next, p);
+    m_next = p;
+    m_atLineStart = true;
+}
+
+/// The end of the identifier (or encoding prefixed literal) starting at \c p,
+/// putting T_IDENTIFIER (or the kind of literal) in \c id
+    const char*
+CppLexer::ScanWord(const char* p, TokenId& id)
+{
+    const char* q = p + 1;
+    while (q < m_end && IsIdentifierPart(*q))
+        ++q;
+    const char* literalEnd = q;
+    id = boost::wave::T_IDENTIFIER;
+    if (m_end <= q)
+        ;
+    else if ('"' == *q && 'R' == q[-1] && (q - p == 1 || IsEncodingPrefix(p, q - 1)))
+    {
+        literalEnd = ScanRawString(q);
+        id = boost::wave::T_RAWSTRINGLIT;
+    }
+    else if (('"' == *q || '\'' == *q) && IsEncodingPrefix(p, q))
+    {
+        literalEnd = ScanQuoted(q);
+        id = '"' == *q ? boost::wave::T_STRINGLIT : boost::wave::T_CHARLIT;
+    }
+    if (q < literalEnd)
+        return literalEnd;
+    id = boost::wave::T_IDENTIFIER;
+    return q;
+}
+
+/// The end of the C comment starting at \c p
+    const char*
+CppLexer::ScanCComment(const char* p)
+{
+    for (const char* q = p + 2; q + 1 < m_end; ++q)
+    {
+        q = static_cast<const char*>(memchr(q, '*', m_end - q - 1));
+        if (!q)
+            break;
+        if ('/' == q[1])
+            return q + 2;
+    }
+    m_error = "unterminated C comment";
+    return m_end;
+}
+
+/// The end of the C++ comment starting at \c p
+    const char*
+CppLexer::ScanCppComment(const char* p) const
+{
+    const char* q = p + 2;
+    while (q < m_end)
+    {
+        const char* eol = static_cast<const char*>(memchr(q, '\n', m_end - q));
+        if (!eol)
+            return m_end;
+        q = eol + 1;
+        const char* lastChar = eol - 1;
+        if (p < lastChar && '\r' == *lastChar)
+            --lastChar;
+        if ('\\' != *lastChar)
+            break;
+    }
+    return q;
+}
+
+/// The end of the character or string literal whose opening quote is at \c p, or \c p if not closed
+    const char*
+CppLexer::ScanQuoted(const char* p) const
+{
+    char quote = *p;
+    for (const char* q = p + 1; q < m_end; ++q)
+    {
+        if ('\\' == *q)
+        {
+            if (size_t length = ContinuationLength(q))
+                q += length - 1;
+            else
+                ++q;
+        }
+        else if (quote == *q)
+        {
+            ++q;
+            while (q < m_end && IsIdentifierPart(*q)) // A user defined literal suffix
+                ++q;
+            return q;
+        }
+        else if ('\n' == *q)
+            break;
+    }
+    return p;
+}
+
+/// The end of the raw string literal whose opening quote is at \c p, or \c p if malformed
+    const char*
+CppLexer::ScanRawString(const char* p)
+{
+    static const size_t MaxDelimiterLength = 16;
+    const char* delimiter = p + 1;
+    const char* q = delimiter;
+    while (q < m_end && '(' != *q)
+    {
+        if (delimiter + MaxDelimiterLength <= q || ')' == *q || '\\' == *q || '"' == *q
+            || ' ' == *q || '\t' == *q || '\n' == *q)
+            return p;
+        ++q;
+    }
+    size_t delimiterLength = q - delimiter;
+    for (++q; q < m_end; ++q)
+    {
+        q = static_cast<const char*>(memchr(q, ')', m_end - q));
+        if (!q)
+            break;
+        if (q + delimiterLength + 1 < m_end
+            && 0 == strncmp(q + 1, delimiter, delimiterLength)
+            && '"' == q[1 + delimiterLength])
+        {
+            q += delimiterLength + 2;
+            while (q < m_end && IsIdentifierPart(*q)) // A user defined literal suffix
+                ++q;
+            return q;
+        }
+    }
+    m_error = "unterminated raw string";
+    return m_end;
+}
+
+/// The end of the number starting at \c p
+    const char*
+CppLexer::ScanNumber(const char* p, TokenId& id) const
+{
+    bool isHex = '0' == p[0] && p + 1 < m_end && ('x' == p[1] || 'X' == p[1]);
+    bool isFloat = false;
+    const char* q = p;
+    while (q < m_end)
+    {
+        char ch = *q;
+        bool isExponent = isHex ? ('p' == ch || 'P' == ch) : ('e' == ch || 'E' == ch);
+        if (isExponent)
+        {
+            isFloat = true;
+            ++q;
+            if (q < m_end && ('+' == *q || '-' == *q))
+                ++q;
+        }
+        else if ('.' == ch)
+            isFloat = true, ++q;
+        else if (IsIdentifierPart(ch))
+            ++q;
+        else if ('\'' == ch && p < q && q + 1 < m_end && IsIdentifierPart(q[1])) // A digit separator
+            q += 2;
+        else
+            break;
+    }
+    if (isFloat)
+        id = boost::wave::T_FLOATLIT;
+    else
+    {
+        const char* suffix = q;
+        while (p < suffix && ('u' == suffix[-1] || 'U' == suffix[-1] || 'l' == suffix[-1] || 'L' == suffix[-1]))
+            --suffix;
+        bool isLongLong = std::count(suffix, q, 'l') + std::count(suffix, q, 'L') == 2;
+        id = isLongLong ? boost::wave::T_LONGINTLIT : boost::wave::T_INTLIT;
+    }
+    return q;
+}
+
+/// The end of the operator or punctuator starting at \c p
+    const char*
+CppLexer::ScanOperator(const char* p, TokenId& id) const
+{
+    using namespace boost::wave;
+    char next[3] = { 0, 0, 0 };
+    for (int i = 0; i < 3 && p + i + 1 < m_end; ++i)
+        next[i] = p[i + 1];
+    size_t length = 1;
+    switch (*p)
+    {
+    case '{': id = T_LEFTBRACE; break;
+    case '}': id = T_RIGHTBRACE; break;
+    case '[': id = T_LEFTBRACKET; break;
+    case ']': id = T_RIGHTBRACKET; break;
+    case '(': id = T_LEFTPAREN; break;
+    case ')': id = T_RIGHTPAREN; break;
+    case ';': id = T_SEMICOLON; break;
+    case '?': id = T_QUESTION_MARK; break;
+    case '~': id = T_COMPL; break;
+    case ',': id = T_COMMA; break;
+    case ':':
+        if (':' == next[0]) id = T_COLON_COLON, length = 2;
+        else if ('>' == next[0]) id = T_RIGHTBRACKET_ALT, length = 2;
+        else id = T_COLON;
+        break;
+    case '.':
+        if ('.' == next[0] && '.' == next[1]) id = T_ELLIPSIS, length = 3;
+        else if ('*' == next[0]) id = T_DOTSTAR, length = 2;
+        else id = T_DOT;
+        break;
+    case '+':
+        if ('+' == next[0]) id = T_PLUSPLUS, length = 2;
+        else if ('=' == next[0]) id = T_PLUSASSIGN, length = 2;
+        else id = T_PLUS;
+        break;
+    case '-':
+        if ('-' == next[0]) id = T_MINUSMINUS, length = 2;
+        else if ('=' == next[0]) id = T_MINUSASSIGN, length = 2;
+        else if ('>' == next[0] && '*' == next[1]) id = T_ARROWSTAR, length = 3;
+        else if ('>' == next[0]) id = T_ARROW, length = 2;
+        else id = T_MINUS;
+        break;
+    case '*':
+        if ('=' == next[0]) id = T_STARASSIGN, length = 2;
+        else id = T_STAR;
+        break;
+    case '/':
+        if ('=' == next[0]) id = T_DIVIDEASSIGN, length = 2;
+        else id = T_DIVIDE;
+        break;
+    case '%':
+        if ('=' == next[0]) id = T_PERCENTASSIGN, length = 2;
+        else if ('>' == next[0]) id = T_RIGHTBRACE_ALT, length = 2;
+        else if (':' == next[0] && '%' == next[1] && ':' == next[2]) id = T_POUND_POUND_ALT, length = 4;
+        else if (':' == next[0]) id = T_POUND_ALT, length = 2;
+        else id = T_PERCENT;
+        break;
+    case '^':
+        if ('=' == next[0]) id = T_XORASSIGN, length = 2;
+        else id = T_XOR;
+        break;
+    case '&':
+        if ('&' == next[0]) id = T_ANDAND, length = 2;
+        else if ('=' == next[0]) id = T_ANDASSIGN, length = 2;
+        else id = T_AND;
+        break;
+    case '|':
+        if ('|' == next[0]) id = T_OROR, length = 2;
+        else if ('=' == next[0]) id = T_ORASSIGN, length = 2;
+        else id = T_OR;
+        break;
+    case '!':
+        if ('=' == next[0]) id = T_NOTEQUAL, length = 2;
+        else id = T_NOT;
+        break;
+    case '=':
+        if ('=' == next[0]) id = T_EQUAL, length = 2;
+        else id = T_ASSIGN;
+        break;
+    case '<':
+        if ('<' == next[0] && '=' == next[1]) id = T_SHIFTLEFTASSIGN, length = 3;
+        else if ('<' == next[0]) id = T_SHIFTLEFT, length = 2;
+        else if ('=' == next[0]) id = T_LESSEQUAL, length = 2;
+        else if ('%' == next[0]) id = T_LEFTBRACE_ALT, length = 2;
+        else if (':' == next[0]) id = T_LEFTBRACKET_ALT, length = 2;
+        else id = T_LESS;
+        break;
+    case '>':
+        if ('>' == next[0] && '=' == next[1]) id = T_SHIFTRIGHTASSIGN, length = 3;
+        else if ('>' == next[0]) id = T_SHIFTRIGHT, length = 2;
+        else if ('=' == next[0]) id = T_GREATEREQUAL, length = 2;
+        else id = T_GREATER;
+        break;
+    case '#':
+        if ('#' == next[0]) id = T_POUND_POUND, length = 2;
+        else id = T_POUND;
+        break;
+    default:
+        id = T_UNKNOWN;
+        break;
+    }
+    return p + length;
+}
+
+/// The number of characters in the line continuation at \c p, or zero
+    size_t
+CppLexer::ContinuationLength(const char* p) const
+{
+    if ('\\' != *p || m_end <= p + 1)
+        return 0;
+    if ('\n' == p[1])
+        return 2;
+    if ('\r' == p[1] && p + 2 < m_end && '\n' == p[2])
+        return 3;
+    return 0;
+}
+
+/// Count the line breaks in [first, last)
+    void
+CppLexer::CountLines(const char* first, const char* last)
+{
+    for (const char* p = first; p < last; ++p)
+    {
+        p = static_cast<const char*>(memchr(p, '\n', last - p));
+        if (!p)
+            break;
+        ++m_line;
+        m_lineStart = p + 1;
+    }
+}
@@ -0,0 +1,105 @@
+#if !defined(CPP_LEXER_INCLUDED)
+#define CPP_LEXER_INCLUDED
+#include <boost/wave/token_ids.hpp>
+#include <string>
+
+/// A lexer-only scanner of C++ source text that provides Boost Wave token identifiers.
+///
+/// Preprocessor directive lines are skipped, matching the tokens
+/// provided by a Wave context that does not process directives.
+/// The scanner refers to (does not copy) the content and may be reused for many files.
+class CppLexer
+{
+public: // Types
+    typedef boost::wave::token_id TokenId;
+    //!< The current item
+    struct ItemType
+    {
+        TokenId id;           //!< The kind of token
+        size_t  offset;       //!< The index of the first character in the content
+        size_t  length;       //!< The number of content characters
+        size_t  line;         //!< The (1-based) line of the first character
+        size_t  column;       //!< The (1-based) column of the first character
+        size_t  newlineCount; //!< The number of line breaks within the token
+    };
+
+private: // Attributes
+    const char* m_begin; //!< The start of the content
+    const char* m_end; //!< The end of the content
+    const char* m_next; //!< The start of the token after m_item
+    const char* m_lineStart; //!< The start of the line containing m_next
+    size_t m_line; //!< The (1-based) line of m_next
+    bool m_atLineStart; //!< Is m_next preceded by only white space on its line?
+    bool m_off; //!< Has the end of the content been passed?
+    std::string m_error; //!< Why the scan was abandoned
+    ItemType m_item; //!< The current item
+
+public: // ...structors
+    /// An Off() scanner
+    CppLexer();
+
+public: // Accessors
+    /// Is this iterator beyond the end or before the start?
+    bool Off() const { return m_off; }
+
+    /// The current item - Precondition: !Off()
+    const ItemType& Item() const { return m_item; }
+
+    /// Was the scan abandoned before the end of the content?
+    bool HasError() const { return !m_error.empty(); }
+
+    /// Why the scan was abandoned - Precondition: HasError()
+    const std::string& GetError() const { return m_error; }
+
+public: // Methods
+    /// Move to the first token in the content [first, last)
+    void Start(const char* first, const char* last);
+
+    /// Move to the next token. Precondition: !Off()
+    void Forth();
+
+    /// Move over the content before \c target, stopping at the first token at or after \c target
+    /// or, when a parenthesis opened in the skipped content is still open at \c target, at the word before the outermost one.
+    /// Only comments, literals, directives and parentheses are recognised in the skipped content. Precondition: !Off()
+    void SkipTo(const char* target);
+
+protected: // Support methods
+    /// Does a preprocessor directive start at \c p (after any white space)?
+    bool IsDirective(const char* p) const;
+
+    /// Move m_next over a preprocessor directive and its line break
+    void SkipDirective();
+
+    /// Set m_item to the token at m_next and move m_next beyond it
+    void SetItem();
+
+    /// The end of the identifier (or encoding prefixed literal) starting at \c p,
+    /// putting T_IDENTIFIER (or the kind of literal) in \c id
+    const char* ScanWord(const char* p, TokenId& id);
+
+    /// The end of the C comment starting at \c p
+    const char* ScanCComment(const char* p);
+
+    /// The end of the C++ comment starting at \c p
+    const char* ScanCppComment(const char* p) const;
+
+    /// The end of the character or string literal whose opening quote is at \c p, or \c p if not closed
+    const char* ScanQuoted(const char* p) const;
+
+    /// The end of the raw string literal whose opening quote is at \c p, or \c p if malformed
+    const char* ScanRawString(const char* p);
+
+    /// The end of the number starting at \c p
+    const char* ScanNumber(const char* p, TokenId& id) const;
+
+    /// The end of the operator or punctuator starting at \c p
+    const char* ScanOperator(const char* p, TokenId& id) const;
+
+    /// The number of characters in the line continuation at \c p, or zero
+    size_t ContinuationLength(const char* p) const;
+
+    /// Count the line breaks in [first, last)
+    void CountLines(const char* first, const char* last);
+};
+
+#endif // !defined(CPP_LEXER_INCLUDED)
@@ -0,0 +1,421 @@
+#include "CppStream.h"
+#include "CallStatement.h"
+#include "TokenTable.h"
+#include <log4cxx/logger.h>
+#include "HotPathLogging.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+const size_t CppStream::NoOffset;
+const size_t CppStream::DefaultChunkSize;
+
+    static log4cxx::LoggerPtr
+log_s(log4cxx::Logger::getLogger("CppStream"));
+
+namespace
+{
+    /// Is the line break at \c eol (after \c first) preceded by a line continuation?
+    bool IsContinued(const char* first, const char* eol)
+    {
+        const char* p = eol;
+        if (first < p && '\r' == p[-1])
+            --p;
+        return first < p && '\\' == p[-1];
+    }
+}
+
+/// A stream checking the function calls selected by \c rules, reading \c chunkSize bytes at a time
+CppStream::CppStream(const MacroRuleSet& rules, size_t chunkSize)
+    : m_rules(rules)
+    , m_defaultAction(MacroRuleSet::Terminate)
+    , m_fix(false)
+    , m_chunkSize(std::max(chunkSize, size_t(1)))
+    , m_windowStart(0)
+    , m_contentSize(0)
+    , m_lexStart(0)
+    , m_processed(0)
+    , m_scanned(0)
+    , m_line(1)
+    , m_lineStart(0)
+    , m_isChanged(false)
+    , m_written(0)
+    , m_tokenCount(0)
+    , m_macroCount(0)
+    , m_fixCount(0)
+{}
+
+/// Apply the rule actions when \c fix. Rules without an action add a semicolon, and also braces when \c fix_10_and_11.
+    void
+CppStream::SetFix(bool fix, bool fix_10_and_11)
+{
+    m_fix = fix || fix_10_and_11;
+    m_defaultAction = fix_10_and_11 ? MacroRuleSet::Both : MacroRuleSet::Terminate;
+}
+
+/// Check \c path, replacing it with the changed content when fixing.
+/// Returns false if it could not be read, tokenized or replaced.
+    bool
+CppStream::ProcessFile(const PathType& path)
+{
+    LOG4CXX_DEBUG(log_s, "ProcessFile: " << path);
+    std::ifstream is(path.c_str(), std::ios::binary);
+    if (!is.is_open())
+        return false;
+    if (!m_fix)
+        return Process(is);
+    OutputFile output(path);
+    if (!output.Begin())
+        return false;
+    bool ok = Process(is, [&output](const OutputFile::SpanStore& spans) { return output.Write(spans); });
+    return output.End(ok && m_isChanged) && ok;
+}
+
+/// Check the content of \c is, giving the (possibly) changed content to \c writer (when not empty).
+/// Returns false if the content could not be tokenized or written.
+    bool
+CppStream::Process(std::istream& is, const WriterType& writer)
+{
+    m_writer = writer;
+    m_window.clear();
+    m_windowStart = m_contentSize = m_lexStart = m_processed = m_scanned = m_lineStart = m_written = 0;
+    m_line = 1;
+    m_previous = TokenType{boost::wave::T_EOI, 0, 1, 0, NoOffset, boost::wave::T_EOI};
+    m_openParens.clear();
+    m_calls.clear();
+    m_edits.Clear();
+    m_isChanged = false;
+    m_tokenCount = 0;
+    m_macroCount = m_fixCount = 0;
+    bool ok = true;
+    for (bool atEnd = false; ok && !atEnd; )
+    {
+        size_t windowSize = m_window.size();
+        m_window.resize(windowSize + m_chunkSize);
+        is.read(&m_window[windowSize], std::streamsize(m_chunkSize));
+        size_t count = size_t(is.gcount());
+        m_window.resize(windowSize + count);
+        m_contentSize += count;
+        atEnd = count < m_chunkSize;
+        ok = LexWindow(atEnd);
+        if (ok && atEnd)
+        {
+            ScanTo(m_contentSize);
+            TokenType endToken{boost::wave::T_EOI, m_contentSize, m_line, m_lineStart, NoOffset, boost::wave::T_EOI};
+            for (auto& call : m_calls)
+            {
+                if (CallType::AwaitingNext == call.state)
+                {
+                    call.next = endToken;
+                    call.state = CallType::AwaitingDecision;
+                }
+            }
+        }
+        DecideCalls(atEnd);
+        ok = ok && Flush(atEnd ? NoOffset : GetSafeEnd());
+        Discard();
+    }
+    m_writer = WriterType();
+    return ok;
+}
+
+/// Process the complete tokens in m_window. Returns false if the content could not be tokenized.
+    bool
+CppStream::LexWindow(bool atEnd)
+{
+    // Only whole lines are tokenized until the end of the content
+    size_t end = m_contentSize;
+    if (!atEnd)
+    {
+        const char* first = GetText(m_lexStart);
+        const char* last = m_window.data() + m_window.size();
+        while (first < last && '\n' != last[-1])
+            --last;
+        if (last <= first)
+            return true;
+        end = m_windowStart + (last - m_window.data());
+    }
+    const char* first = GetText(m_lexStart);
+    size_t resume = m_lexStart; // The line start after the last processed token
+    for (m_lexer.Start(first, first + (end - m_lexStart)); !m_lexer.Off(); m_lexer.Forth())
+    {
+        const CppLexer::ItemType& item = m_lexer.Item();
+        size_t offset = m_lexStart + item.offset;
+        if (boost::wave::T_EOF == item.id)
+            break;
+        if (!atEnd && IsIncomplete(item, offset, end))
+            break;
+        if (1 == item.column)
+            resume = offset;
+        if (m_processed <= offset) // Not processed before lexing was resumed
+        {
+            ++m_tokenCount;
+            m_processed = offset + item.length;
+            if (boost::wave::T_UNKNOWN == item.id)
+            {
+                LOG4CXX_WARN(log_s, "Unknown token (" << StringType(GetText(offset), item.length) << ')'
+                    << " at offset " << offset
+                    );
+            }
+            if (!TokenTable::IsWhitespaceId(item.id))
+            {
+                ScanTo(offset);
+                TokenType token{item.id, offset, m_line, m_lineStart, NoOffset, boost::wave::T_EOI};
+                AddSignificant(token);
+            }
+        }
+        if (boost::wave::T_NEWLINE == item.id)
+            resume = offset + item.length;
+    }
+    if (m_lexer.HasError() && atEnd)
+    {
+        ScanTo(m_processed);
+        LOG4CXX_WARN(log_s, m_lexer.GetError() << " at line " << m_line);
+        return false;
+    }
+    ScanTo(m_processed);
+    m_lexStart = atEnd ? end : resume;
+    return true;
+}
+
+/// Could the token \c item, which starts at content index \c offset, continue beyond \c end?
+    bool
+CppStream::IsIncomplete(const CppLexer::ItemType& item, size_t offset, size_t end) const
+{
+    const char* first = GetText(offset);
+    const char* last = GetText(end);
+    if (offset + item.length == end)
+        return boost::wave::T_NEWLINE != item.id;
+    if (boost::wave::T_UNKNOWN == item.id && ('"' == *first || '\'' == *first))
+    {
+        // An unclosed literal is incomplete when continued to the last line
+        for (const char* p = first; (p = static_cast<const char*>(memchr(p, '\n', last - p))) != 0; ++p)
+        {
+            if (!IsContinued(first, p))
+                return false;
+        }
+        return true;
+    }
+    if (boost::wave::T_IDENTIFIER == item.id && '"' == first[item.length] && 'R' == first[item.length - 1])
+        return item.length <= 3; // The prefix of a raw string literal that is not closed
+    return false;
+}
+
+/// Update the calls with the token that is not white space \c token
+    void
+CppStream::AddSignificant(TokenType& token)
+{
+    token.indentEnd = token.line == m_previous.line && NoOffset != m_previous.indentEnd
+        ? m_previous.indentEnd : token.offset;
+    for (auto& call : m_calls)
+    {
+        if (CallType::AwaitingNext == call.state)
+        {
+            call.next = token;
+            call.state = CallType::AwaitingDecision;
+        }
+    }
+    DecideCalls(false);
+    if (!m_calls.empty() && CallType::AwaitingParen == m_calls.back().state)
+    {
+        if (boost::wave::T_LEFTPAREN == token.id)
+        {
+            m_calls.back().state = CallType::AwaitingClose;
+            m_calls.back().depth = m_openParens.size() + 1;
+        }
+        else
+            m_calls.pop_back();
+    }
+    if (boost::wave::T_LEFTPAREN == token.id)
+        m_openParens.push_back(m_previous.id);
+    else if (boost::wave::T_RIGHTPAREN == token.id && !m_openParens.empty())
+    {
+        for (auto& call : m_calls)
+        {
+            if (CallType::AwaitingClose == call.state && call.depth == m_openParens.size())
+            {
+                call.paramEnd = token;
+                call.state = CallType::AwaitingNext;
+            }
+        }
+        token.beforeMate = m_openParens.back();
+        m_openParens.pop_back();
+    }
+    else if (boost::wave::T_IDENTIFIER == token.id)
+    {
+        size_t rule = m_rules.FindRule(MacroRuleSet::NameType(GetText(token.offset), m_processed - token.offset));
+        if (MacroRuleSet::NoRule != rule)
+        {
+            HOT_PATH_TRACE(log_s, "Candidate: " << m_rules.GetRule(rule).prefix << " at " << token.line);
+            size_t indentEnd = NoOffset == m_previous.indentEnd ? token.offset : m_previous.indentEnd;
+            StringType indent(GetText(m_previous.lineStart), indentEnd - m_previous.lineStart);
+            m_calls.push_back(CallType{CallType::AwaitingParen, rule, token, m_previous, indent, 0, token, token});
+        }
+    }
+    m_previous = token;
+}
+
+/// Decide the calls awaiting a decision, in content order, until one needs more content
+    void
+CppStream::DecideCalls(bool atEnd)
+{
+    size_t decidedCount = 0;
+    for (auto& call : m_calls)
+    {
+        if (CallType::AwaitingDecision != call.state)
+            continue;
+        if (!Decide(call, atEnd))
+            break;
+        ++decidedCount;
+        call.state = CallType::AwaitingParen; // Marks a decided call
+        call.rule = MacroRuleSet::NoRule;
+    }
+    if (0 < decidedCount)
+    {
+        m_calls.erase(std::remove_if(m_calls.begin(), m_calls.end()
+            , [](const CallType& call) { return MacroRuleSet::NoRule == call.rule; })
+            , m_calls.end());
+    }
+}
+
+/// Count and change \c call. Returns false if it needs more content.
+    bool
+CppStream::Decide(CallType& call, bool atEnd)
+{
+    bool isTerminated = CallStatement::IsTerminated(call.next.id);
+    MacroRuleSet::ActionType action = m_rules.GetRule(call.rule).action;
+    if (MacroRuleSet::DefaultAction == action)
+        action = m_defaultAction;
+    bool addBraces = m_fix && !isTerminated && (action & MacroRuleSet::Brace) && IsCompoundStatementBody(call);
+    size_t closingLineStart = NoOffset;
+    if (addBraces && call.identifier.line < call.next.line)
+    {
+        // The closing brace goes at the start of the line after the closing parenthesis
+        const char* first = GetText(call.paramEnd.offset);
+        const char* last = m_window.data() + m_window.size();
+        const char* eol = static_cast<const char*>(memchr(first, '\n', last - first));
+        if (eol)
+            closingLineStart = m_windowStart + (eol + 1 - m_window.data());
+        else if (atEnd)
+            closingLineStart = m_contentSize;
+        else
+            return false;
+    }
+    ++m_macroCount;
+    HOT_PATH_DEBUG(log_s, m_rules.GetRule(call.rule).prefix << " at " << call.identifier.line
+        << " to " << call.paramEnd.line
+        << (isTerminated ? " terminated" : " unterminated")
+        );
+    if (isTerminated)
+        return true;
+    ++m_fixCount;
+    if (m_fix && (action & MacroRuleSet::Terminate))
+        InsertText(call.paramEnd.offset + 1, ";");
+    if (addBraces)
+    {
+        StringType indent;
+        if (call.previous.line < call.identifier.line)
+        {
+            indent = call.indent;
+            InsertText(call.identifier.lineStart, indent + "{\n");
+        }
+        else
+            InsertText(call.identifier.offset, "{");
+        if (NoOffset != closingLineStart)
+            InsertText(closingLineStart, indent + "}\n");
+        else
+            AppendText(call.paramEnd.offset, " }");
+    }
+    return true;
+}
+
+/// Is \c call a compound statement body?
+    bool
+CppStream::IsCompoundStatementBody(const CallType& call) const
+{
+    return CallStatement::IsCompoundStatementBody(call.previous.id, call.previous.beforeMate
+        , boost::wave::T_RIGHTPAREN != call.previous.id && m_edits.HasUpdateBetween(call.previous.offset, call.identifier.offset));
+}
+
+/// Insert \c text before the character at \c index
+    void
+CppStream::InsertText(size_t index, const StringType& text)
+{
+    HOT_PATH_DEBUG(log_s, "InsertText: " << text << " at offset " << index);
+    m_edits.InsertText(index, text);
+    m_isChanged = true;
+}
+
+/// Append \c text after the character at \c index
+    void
+CppStream::AppendText(size_t index, const StringType& text)
+{
+    HOT_PATH_DEBUG(log_s, "AppendText: " << text << " at offset " << index);
+    m_edits.AppendText(index, text);
+    m_isChanged = true;
+}
+
+/// Count the line breaks before \c offset
+    void
+CppStream::ScanTo(size_t offset)
+{
+    if (offset <= m_scanned)
+        return;
+    const char* first = GetText(m_scanned);
+    const char* last = GetText(offset);
+    for (const char* p = first; (p = static_cast<const char*>(memchr(p, '\n', last - p))) != 0; )
+    {
+        ++m_line;
+        m_lineStart = m_windowStart + (++p - m_window.data());
+    }
+    m_scanned = offset;
+}
+
+/// Give the output before content index \c end (or all of it given NoOffset) to m_writer. Returns false if it could not be written.
+    bool
+CppStream::Flush(size_t end)
+{
+    OutputFile::SpanStore spans;
+    auto copyTo = [this, &spans](size_t index)
+    {
+        if (m_written < index && m_writer)
+            spans.push_back(OutputFile::SpanType(GetText(m_written), index - m_written));
+        m_written = std::max(m_written, index);
+    };
+    const EditSet::UpdateStore& updates = m_edits.GetSortedUpdates();
+    for (EditSet::UpdateStore::const_iterator pUpdate = updates.begin()
+        ; updates.end() != pUpdate && pUpdate->index < end
+        ; ++pUpdate)
+    {
+        copyTo(pUpdate->at);
+        if (m_writer)
+            spans.push_back(pUpdate->text);
+    }
+    copyTo(std::min(end, m_contentSize));
+    bool ok = spans.empty() || m_writer(spans);
+    m_edits.RemoveBefore(end);
+    return ok;
+}
+
+/// The content index before which nothing can change
+    size_t
+CppStream::GetSafeEnd() const
+{
+    // A call not yet seen may add braces at the start of the line of the last token
+    size_t result = std::min(m_previous.lineStart, m_processed);
+    for (auto& call : m_calls)
+        result = std::min(result, call.previous.lineStart);
+    return result;
+}
+
+/// Remove the content that is no longer required from m_window
+    void
+CppStream::Discard()
+{
+    size_t keep = std::min({m_written, m_lexStart, m_scanned});
+    if (m_windowStart < keep)
+    {
+        m_window.erase(0, keep - m_windowStart);
+        m_windowStart = keep;
+    }
+}
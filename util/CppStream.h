@@ -0,0 +1,163 @@
+#if !defined(CPP_STREAM_INCLUDED)
+#define CPP_STREAM_INCLUDED
+#include "CppLexer.h"
+#include "EditSet.h"
+#include "MacroRuleSet.h"
+#include "OutputFile.h"
+#include <boost/filesystem.hpp>
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+/// Checks (and optionally changes) the selected function calls in C++ source content that is read a chunk at a time.
+///
+/// CppFile indexes every token of the whole content. This instead keeps only the content not yet written,
+/// the open parenthesis stack and the calls awaiting a decision, so memory use depends on
+/// the longest line, token or function call rather than the size of the file.
+/// A call is decided once its closing parenthesis and the following token have been seen,
+/// and the (possibly) changed content before the earliest undecided call is written out progressively.
+/// The changes are those CppFile::FunctionIterator makes using CppLexer tokens, decided by the same CallStatement checks.
+/// They are recorded in an EditSet, from which those before the written content are removed.
+class CppStream
+{
+public: // Types
+    typedef boost::filesystem::path PathType;
+    typedef std::string StringType;
+    /// Puts the next part of the (possibly) changed content somewhere. Returns false on failure.
+    typedef std::function<bool(const OutputFile::SpanStore&)> WriterType;
+
+protected: // Types
+    typedef boost::wave::token_id TokenId;
+    static const size_t NoOffset = size_t(-1);
+
+    /// A token that is not white space
+    struct TokenType
+    {
+        TokenId id;
+        size_t  offset;      //!< The content index of the first character
+        size_t  line;        //!< The (1-based) line of the first character
+        size_t  lineStart;   //!< The content index of the start of \c line
+        size_t  indentEnd;   //!< The content index of the first significant token on \c line
+        TokenId beforeMate;  //!< When a closing parenthesis, the token before the matching opening parenthesis
+    };
+
+    /// A function call that may need a change
+    struct CallType
+    {
+        enum StateType { AwaitingParen, AwaitingClose, AwaitingNext, AwaitingDecision };
+        StateType  state;
+        size_t     rule;       //!< The position in m_rules of the rule selecting the call
+        TokenType  identifier;
+        TokenType  previous;   //!< The significant token before \c identifier
+        StringType indent;     //!< The white space before the first significant token on the line of \c previous
+        size_t     depth;      //!< The number of open parentheses within the call
+        TokenType  paramEnd;   //!< The closing parenthesis
+        TokenType  next;       //!< The significant token after \c paramEnd
+    };
+    typedef std::vector<CallType> CallStore;
+    typedef std::vector<TokenId> TokenIdStore;
+
+private: // Attributes
+    MacroRuleSet m_rules; //!< Selects the function calls of interest
+    MacroRuleSet::ActionType m_defaultAction; //!< Of rules without an action
+    bool m_fix; //!< Apply the rule actions?
+    size_t m_chunkSize; //!< The number of bytes requested by each read
+    CppLexer m_lexer;
+    StringType m_window; //!< The content from m_windowStart that is still required
+    size_t m_windowStart; //!< The content index of the start of m_window
+    size_t m_contentSize; //!< The number of bytes read
+    size_t m_lexStart; //!< The start of the line where lexing resumes
+    size_t m_processed; //!< The content index after the last token processed
+    size_t m_scanned; //!< The content index up to which line breaks have been counted
+    size_t m_line; //!< The (1-based) line containing m_scanned
+    size_t m_lineStart; //!< The content index of the start of m_line
+    TokenType m_previous; //!< The last significant token
+    TokenIdStore m_openParens; //!< The token before each unmatched opening parenthesis
+    CallStore m_calls; //!< The calls awaiting a decision, in content order
+    EditSet m_edits; //!< The changes not yet written
+    bool m_isChanged; //!< Has any change been made?
+    size_t m_written; //!< The content index up to which the output has been written
+    WriterType m_writer; //!< Where the output goes (or empty)
+    size_t m_tokenCount;
+    int m_macroCount;
+    int m_fixCount;
+
+public: // ...structors
+    /// A stream checking the function calls selected by \c rules, reading \c chunkSize bytes at a time
+    CppStream(const MacroRuleSet& rules, size_t chunkSize = DefaultChunkSize);
+
+public: // Accessors
+    /// The number of bytes processed
+    size_t GetContentSize() const { return m_contentSize; }
+
+    /// The number of tokens processed
+    size_t GetTokenCount() const { return m_tokenCount; }
+
+    /// The number of function calls of interest
+    int GetMacroCount() const { return m_macroCount; }
+
+    /// The number of function calls without a statement terminator
+    int GetFixCount() const { return m_fixCount; }
+
+    /// Does the output differ from the input?
+    bool IsChanged() const { return m_isChanged; }
+
+public: // Modifiers
+    /// Apply the rule actions when \c fix. Rules without an action add a semicolon, and also braces when \c fix_10_and_11.
+    void SetFix(bool fix, bool fix_10_and_11);
+
+public: // Methods
+    /// Check the content of \c is, giving the (possibly) changed content to \c writer (when not empty).
+    /// Returns false if the content could not be tokenized or written.
+    bool Process(std::istream& is, const WriterType& writer = WriterType());
+
+    /// Check \c path, replacing it with the changed content when fixing.
+    /// Returns false if it could not be read, tokenized or replaced.
+    bool ProcessFile(const PathType& path);
+
+protected: // Support methods
+    /// Process the complete tokens in m_window. Returns false if the content could not be tokenized.
+    bool LexWindow(bool atEnd);
+
+    /// Could the token \c item, which starts at content index \c offset, continue beyond \c end?
+    bool IsIncomplete(const CppLexer::ItemType& item, size_t offset, size_t end) const;
+
+    /// Update the calls with the token that is not white space \c token
+    void AddSignificant(TokenType& token);
+
+    /// Decide the calls awaiting a decision, in content order, until one needs more content
+    void DecideCalls(bool atEnd);
+
+    /// Count and change \c call. Returns false if it needs more content.
+    bool Decide(CallType& call, bool atEnd);
+
+    /// Is \c call a compound statement body?
+    bool IsCompoundStatementBody(const CallType& call) const;
+
+    /// Insert \c text before the character at \c index
+    void InsertText(size_t index, const StringType& text);
+
+    /// Append \c text after the character at \c index
+    void AppendText(size_t index, const StringType& text);
+
+    /// Count the line breaks before \c offset
+    void ScanTo(size_t offset);
+
+    /// Give the output before content index \c end (or all of it given NoOffset) to m_writer. Returns false if it could not be written.
+    bool Flush(size_t end);
+
+    /// The content index before which nothing can change
+    size_t GetSafeEnd() const;
+
+    /// Remove the content that is no longer required from m_window
+    void Discard();
+
+    /// The content at index \c offset in m_window
+    const char* GetText(size_t offset) const { return m_window.data() + (offset - m_windowStart); }
+
+private: // Class data
+    static const size_t DefaultChunkSize = 1024 * 1024;
+};
+
+#endif // !defined(CPP_STREAM_INCLUDED)
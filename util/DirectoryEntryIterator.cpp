@@ -1,4 +1,6 @@
 #include "DirectoryEntryIterator.h"
+#include "DirectoryWalker.h"
+#include "HotPathLogging.h"
 #include <boost/algorithm/string.hpp>
 #include <log4cxx/logger.h>
 
@@ -30,26 +32,76 @@ DirectoryEntryIterator::ThrowUnlessPathExists() const
     void
 DirectoryEntryIterator::Start()
 {
+    PhaseStats::Timer walkTimer(m_stats, PhaseStats::Walk);
+    m_walker.reset();
     m_pathItem = m_pathStore.begin();
-    while (m_pathStore.end() != m_pathItem)
+    StartPath();
+}
+
+// Move to the first item in or after the next root path
+    void
+DirectoryEntryIterator::StartPath()
+{
+    m_isInDir = false;
+    while (!(m_isOff = !NextRoot()))
     {
-        fs::path path(*m_pathItem);
-        if (!fs::is_directory(path))
+        if (!fs::is_directory(m_root))
         {
-            m_item = path;
+            m_item = m_root;
             break;
         }
-        else if (StartDir(path))
+        else if (StartDir(m_root))
             break;
-        ++m_pathItem;
     }
 }
 
+// Set m_root to the next command line or listed path. Returns false when there are no more.
+    bool
+DirectoryEntryIterator::NextRoot()
+{
+    if (m_pathStore.end() != m_pathItem)
+    {
+        m_root = *m_pathItem++;
+        return true;
+    }
+    return m_pathList && ReadListedPath();
+}
+
+// Set m_root to the next path in m_pathList. Returns false at the end of the list.
+    bool
+DirectoryEntryIterator::ReadListedPath()
+{
+    std::string record;
+    do
+    {
+        if (UnknownSeparator == m_separator) // Use the first separator found for the remainder of the list
+        {
+            std::istream::int_type ch;
+            while (std::istream::traits_type::eof() != (ch = m_pathList->get()) && '\0' != ch && '\n' != ch)
+                record.push_back(char(ch));
+            if (std::istream::traits_type::eof() != ch)
+                m_separator = ('\0' == ch) ? NulSeparator : NewlineSeparator;
+        }
+        else
+            std::getline(*m_pathList, record, NulSeparator == m_separator ? '\0' : '\n');
+        if (NulSeparator != m_separator && !record.empty() && '\r' == record.back())
+            record.pop_back();
+    } while (record.empty() && *m_pathList);
+    if (record.empty())
+        return false;
+    HOT_PATH_DEBUG(log_s, "ReadListedPath: " << record);
+    m_root = record;
+    return true;
+}
+
 // Move to the first item in \c dir
     bool
 DirectoryEntryIterator::StartDir(const fs::path& dir)
 {
-    m_dirItem = fs::recursive_directory_iterator(dir);
+    if (!m_walker)
+        m_walker.reset(new DirectoryWalker(m_test, m_threadCount));
+    m_walker->Start(dir);
+    m_isInDir = true;
     return SetItem();
 }
 
@@ -57,65 +109,29 @@ DirectoryEntryIterator::StartDir(const fs::path& dir)
     void
 DirectoryEntryIterator::Forth()
 {
-    ++m_dirItem;
-    if (!SetItem())
-    {
-        ++m_pathItem;
-        while (m_pathStore.end() != m_pathItem)
-        {
-            fs::path path(*m_pathItem);
-            if (!fs::is_directory(path))
-            {
-                m_item = path;
-                break;
-            }
-            else if (StartDir(path))
-                break;
-            ++m_pathItem;
-        }
-    }
+    PhaseStats::Timer walkTimer(m_stats, PhaseStats::Walk);
+    if (!m_isInDir || !SetItem())
+        StartPath();
 }
 
 // Is this iterator beyond the end or before the start?
     bool
 DirectoryEntryIterator::Off() const
 {
-    return m_pathStore.end() == m_pathItem;
-}
-
-// Is this iterator beyond the end or before the start of the current directory iterator?
-    bool
-DirectoryEntryIterator::OffDir() const
-{
-    return m_dirItem == m_dirEnd;
+    return m_isOff;
 }
 
-// Set m_item
+// Set m_item to the next entry in the current directory
     bool
 DirectoryEntryIterator::SetItem()
 {
-    while (!OffDir())
-    {
-        bool skipDirectory = false;
-        if (!m_test || m_test->IsIncluded(m_dirItem.level(), m_dirItem->path(), skipDirectory))
-        {
-            m_item = m_dirItem->path();
-            return true;
-        }
-        if (skipDirectory && !fs::is_directory(m_dirItem->path()))
-            m_dirItem.pop();
-        else
-        {
-            m_dirItem.no_push(skipDirectory);
-            ++m_dirItem;
-        }
-    }
-    return false;
+    m_isInDir = m_walker->Next(m_item);
+    return m_isInDir;
 }
 
 // Is \c entry at \c level included, and if not, can the remainder of the directory be skipped?
     bool
-DirectoryEntrySelector::IsIncluded(int level, const fs::path& entry, bool& skipDirectory) const
+DirectoryEntrySelector::IsIncluded(int level, const fs::path& /*entry*/, bool& skipDirectory) const
 {
     bool result = m_expectedLevel < 0 || level <= m_expectedLevel;
     if (!result)
@@ -123,18 +139,32 @@ DirectoryEntrySelector::IsIncluded(int level, const fs::path& entry, bool& skipD
     return result;
 }
 
+// Is \c entry (a file of \c type) at \c level included, and if not, can the remainder of the directory be skipped?
+    bool
+DirectoryEntrySelector::IsIncluded(int level, const fs::path& entry, fs::file_type /*type*/, bool& skipDirectory) const
+{
+    return IsIncluded(level, entry, skipDirectory);
+}
+
 // Is \c entry at \c level a selected file, and if not, can the remainder of the directory be skipped?
     bool
 ExtensionSelector::IsIncluded(int level, const fs::path& entry, bool& skipDirectory) const
+{
+    return IsIncluded(level, entry, fs::status(entry).type(), skipDirectory);
+}
+
+// Is \c entry (a file of \c type) at \c level a selected file, and if not, can the remainder of the directory be skipped?
+    bool
+ExtensionSelector::IsIncluded(int level, const fs::path& entry, fs::file_type type, bool& skipDirectory) const
 {
     bool result = DirectoryEntrySelector::IsIncluded(level, entry, skipDirectory);
-    if (!fs::is_regular_file(entry))
+    if (fs::regular_file != type)
         result = false;
     else if (result)
     {
         std::string ext = entry.extension().string();
         result = m_allowed.end() != std::find(m_allowed.begin(), m_allowed.end(), ext);
     }
-    LOG4CXX_DEBUG(log_s, "IsIncluded: level " << level << ' ' << entry << " result " << result << " skipDirectory? " << skipDirectory);
+    HOT_PATH_DEBUG(log_s, "IsIncluded: level " << level << ' ' << entry << " result " << result << " skipDirectory? " << skipDirectory);
     return result;
 }
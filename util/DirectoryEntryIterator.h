@@ -1,7 +1,14 @@
+#if !defined(DIRECTORY_ENTRY_ITERATOR_INCLUDED)
+#define DIRECTORY_ENTRY_ITERATOR_INCLUDED
+#include "PhaseStats.h"
 #include <boost/filesystem.hpp>
 #include <boost/shared_ptr.hpp>
+#include <istream>
+#include <memory>
 #include <stdexcept>
 
+class DirectoryWalker;
+
 /// An base of directory entry selectors
 class DirectoryEntrySelector
 {
@@ -21,10 +28,17 @@ public: // ...structors
 public: // Accessors
     /// Is \c entry at \c level included, and if not, can the remainder of the directory be skipped?
     virtual bool IsIncluded(int level, const PathType& entry, bool& skipDirectory) const;
+
+    /// Is \c entry (a file of \c type) at \c level included, and if not, can the remainder of the directory be skipped?
+    /// This is used during directory traversal, where the type is known without a stat call.
+    virtual bool IsIncluded(int level, const PathType& entry, boost::filesystem::file_type type, bool& skipDirectory) const;
 };
 typedef boost::shared_ptr<DirectoryEntrySelector> DirectoryEntrySelectorPtr;
 
-/// An iterator over directory entries
+/// An iterator over directory entries.
+///
+/// Directories are read ahead of their use by a pool of threads (see DirectoryWalker),
+/// but entries are provided in the same depth first order as a recursive_directory_iterator.
 class DirectoryEntryIterator
 {
 public: // Types
@@ -32,28 +46,46 @@ public: // Types
 
 protected: // Types
     typedef std::vector<PathType> PathStore;
-    typedef boost::filesystem::recursive_directory_iterator IterType;
+    enum SeparatorType { UnknownSeparator, NewlineSeparator, NulSeparator };
 
 private: // Attributes
     PathStore m_pathStore; //!< DirectoryEntrys or directory names
+    std::istream* m_pathList; //!< More file or directory names (or null)
+    SeparatorType m_separator; //!< What ends each name in m_pathList
     DirectoryEntrySelectorPtr m_test; //!< Selects the directory entries
     PathStore::const_iterator m_pathItem; //!< Stepped through m_pathStore
-    IterType m_dirItem; //!< Steps through all the entries
-    IterType m_dirEnd;
+    PathType m_root; //!< The file or directory name providing m_item
+    bool m_isOff; //!< Are there no more items?
+    int m_threadCount; //!< The number of directory reading threads
+    std::shared_ptr<DirectoryWalker> m_walker; //!< Steps through all the entries of a directory (or null)
+    bool m_isInDir; //!< Is m_item from m_walker?
+    PhaseStats* m_stats; //!< Where the time spent walking is recorded (or null)
     PathType m_item; //!< The current directory entry
 
 public: // ...structors
     DirectoryEntryIterator(const PathType& dir, const DirectoryEntrySelectorPtr& test = DirectoryEntrySelectorPtr())
         : m_pathStore(1, dir)
+        , m_pathList(0)
+        , m_separator(UnknownSeparator)
         , m_test(test)
         , m_pathItem(m_pathStore.end())
+        , m_isOff(true)
+        , m_threadCount(DefaultThreadCount)
+        , m_isInDir(false)
+        , m_stats(0)
     { ThrowUnlessPathExists(); }
 
     template <class FwdIter>
     DirectoryEntryIterator(FwdIter first, FwdIter last, const DirectoryEntrySelectorPtr& test = DirectoryEntrySelectorPtr())
         : m_pathStore(first, last)
+        , m_pathList(0)
+        , m_separator(UnknownSeparator)
         , m_test(test)
         , m_pathItem(m_pathStore.end())
+        , m_isOff(true)
+        , m_threadCount(DefaultThreadCount)
+        , m_isInDir(false)
+        , m_stats(0)
     { ThrowUnlessPathExists(); }
 
 public: // Accessors
@@ -63,6 +95,24 @@ public: // Accessors
     /// The full path of the current item. Precondition: !Off()
     const PathType& Item() const { return m_item; }
 
+    /// The number of threads reading directories
+    int GetThreadCount() const { return m_threadCount; }
+
+    /// Where the resources used to find each item are recorded (or null)
+    PhaseStats* GetStats() const { return m_stats; }
+
+public: // Modifiers
+    /// Use \c threadCount threads to read directories (from the next Start())
+    void SetThreadCount(int threadCount) { m_threadCount = threadCount; }
+
+    /// Also provide the files (and directory entries) named in \c pathList, which are separated by newline or NUL characters.
+    /// The names are read as required and are not checked for existence.
+    /// Start() does not rewind \c pathList.
+    void SetPathList(std::istream& pathList) { m_pathList = &pathList; }
+
+    /// Record the resources used to find each item in \c stats (when not null)
+    void SetStats(PhaseStats* stats) { m_stats = stats; }
+
 public: // Methods
     /// Move to the first item
     void Start();
@@ -71,16 +121,26 @@ public: // Methods
     void Forth();
 
 protected: // Support methods
-    /// Is this iterator beyond the end or before the start of the current directory iterator?
-    bool OffDir() const;
-
-    /// Set m_item
+    /// Set m_item to the next entry in the current directory
     bool SetItem();
 
+    /// Move to the first item in \c dir
     bool StartDir(const PathType& dir);
 
+    /// Move to the first item in or after the next root path
+    void StartPath();
+
+    /// Set m_root to the next command line or listed path. Returns false when there are no more.
+    bool NextRoot();
+
+    /// Set m_root to the next path in m_pathList. Returns false at the end of the list.
+    bool ReadListedPath();
+
     // Throw any path that does not exist
     void ThrowUnlessPathExists() const;
+
+private: // Class data
+    static const int DefaultThreadCount = 4; //!< Directory reading is usually limited by latency, not processors
 };
 
 /// Select regular files based on their extension
@@ -102,6 +162,9 @@ public: // ...structors
 public: // Methods
     // Is \c entry at \c level a selected file, and if not, can the remainder of the directory be skipped?
     bool IsIncluded(int level, const PathType& entry, bool& skipDirectory) const;
+
+    // Is \c entry (a file of \c type) at \c level a selected file, and if not, can the remainder of the directory be skipped?
+    bool IsIncluded(int level, const PathType& entry, boost::filesystem::file_type type, bool& skipDirectory) const;
 };
 
 class ExistsException : public std::invalid_argument
@@ -111,3 +174,5 @@ public: // Attributes
 public: // ...stuctors
     ExistsException(const boost::filesystem::path& name) noexcept;
 };
+
+#endif // !defined(DIRECTORY_ENTRY_ITERATOR_INCLUDED)
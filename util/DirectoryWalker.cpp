@@ -0,0 +1,352 @@
+#include "DirectoryWalker.h"
+#include <log4cxx/logger.h>
+#include "HotPathLogging.h"
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace fs = boost::filesystem;
+
+    static log4cxx::LoggerPtr
+log_s(log4cxx::Logger::getLogger("DirectoryWalker"));
+
+namespace
+{
+#if !defined(_WIN32)
+    /// The type of file described by \c mode
+    fs::file_type GetFileType(mode_t mode)
+    {
+        return S_ISREG(mode) ? fs::regular_file
+            : S_ISDIR(mode) ? fs::directory_file
+            : S_ISLNK(mode) ? fs::symlink_file
+            : S_ISBLK(mode) ? fs::block_file
+            : S_ISCHR(mode) ? fs::character_file
+            : S_ISFIFO(mode) ? fs::fifo_file
+            : S_ISSOCK(mode) ? fs::socket_file
+            : fs::type_unknown;
+    }
+
+    /// The type of file described by the readdir value \c type
+    fs::file_type GetFileType(unsigned char type)
+    {
+        switch (type)
+        {
+        case DT_REG: return fs::regular_file;
+        case DT_DIR: return fs::directory_file;
+        case DT_LNK: return fs::symlink_file;
+        case DT_BLK: return fs::block_file;
+        case DT_CHR: return fs::character_file;
+        case DT_FIFO: return fs::fifo_file;
+        case DT_SOCK: return fs::socket_file;
+        default: return fs::status_unknown;
+        }
+    }
+
+    /// The type of the file that \c name (in the open directory \c dirFd) refers to, following symbolic links if \c follow
+    fs::file_type GetFileType(int dirFd, const char* name, bool follow)
+    {
+        struct stat status;
+        if (0 != fstatat(dirFd, name, &status, follow ? 0 : AT_SYMLINK_NOFOLLOW))
+            return fs::file_not_found;
+        return GetFileType(status.st_mode);
+    }
+#endif
+}
+
+/// A walker using \c threadCount workers (none reads directories only when required) and \c test
+DirectoryWalker::DirectoryWalker(const DirectoryEntrySelectorPtr& test, int threadCount)
+    : m_test(test)
+    , m_pendingCount(0)
+    , m_nextQueue(0)
+    , m_isStopping(false)
+{
+    for (int i = 0; i < threadCount; ++i)
+        m_queues.emplace_back(new TaskQueue);
+    for (int i = 0; i < threadCount; ++i)
+        m_workers.emplace_back(&DirectoryWalker::Run, this, size_t(i));
+}
+
+DirectoryWalker::~DirectoryWalker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_taskAdded.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+/// Begin a walk of the tree below \c dir
+    void
+DirectoryWalker::Start(const PathType& dir)
+{
+    // Discard the unread directories of a previous walk
+    for (auto& queue : m_queues)
+    {
+        std::lock_guard<std::mutex> queueLock(queue->mutex);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pendingCount -= queue->tasks.size();
+        queue->tasks.clear();
+    }
+    m_path.clear();
+    m_path.push_back(Frame{Add(dir), 0});
+}
+
+/// Put the next selected entry (in depth first order) into \c item. Returns false at the end of the walk.
+    bool
+DirectoryWalker::Next(PathType& item)
+{
+    while (!m_path.empty())
+    {
+        Listing& listing = *m_path.back().listing;
+        Wait(listing);
+        if (listing.error)
+        {
+            std::exception_ptr error = listing.error;
+            m_path.pop_back();
+            std::rethrow_exception(error);
+        }
+        if (listing.entries.size() <= m_path.back().next)
+        {
+            m_path.pop_back();
+            continue;
+        }
+        Entry& entry = listing.entries[m_path.back().next++];
+        if (entry.subdirectory) // Visit the subdirectory content after the entry
+            m_path.push_back(Frame{std::move(entry.subdirectory), 0});
+        if (entry.isIncluded)
+        {
+            item = entry.path;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// The entries of \c dir (read in the background)
+    DirectoryWalker::ListingPtr
+DirectoryWalker::Add(const PathType& dir)
+{
+    ListingPtr result = std::make_shared<Listing>(dir, 0);
+    if (!m_queues.empty())
+    {
+        TaskQueue& queue = *m_queues[m_nextQueue++ % m_queues.size()];
+        {
+            std::lock_guard<std::mutex> queueLock(queue.mutex);
+            queue.tasks.push_back(result);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_pendingCount;
+        }
+        m_taskAdded.notify_one();
+    }
+    return result;
+}
+
+/// Wait until the entries of \c listing are available, reading it now if no worker has started it
+    void
+DirectoryWalker::Wait(Listing& listing)
+{
+    int expected = Listing::Pending;
+    if (listing.state.compare_exchange_strong(expected, Listing::Reading))
+    {
+        Read(listing);
+        if (!m_queues.empty())
+            Submit(m_nextQueue++ % m_queues.size(), listing);
+        Publish(listing);
+    }
+    else if (Listing::Ready != listing.state)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_listingReady.wait(lock, [&listing] { return Listing::Ready == listing.state; });
+    }
+}
+
+/// Take and read listings until stopping
+    void
+DirectoryWalker::Run(size_t index)
+{
+    while (ListingPtr listing = NextTask(index))
+    {
+        int expected = Listing::Pending;
+        if (!listing->state.compare_exchange_strong(expected, Listing::Reading))
+            continue; // Already read by Wait()
+        Read(*listing);
+        Submit(index, *listing);
+        Publish(*listing);
+    }
+}
+
+/// Wait for a listing to read, preferring the newest in the queue of worker \c index
+    DirectoryWalker::ListingPtr
+DirectoryWalker::NextTask(size_t index)
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_taskAdded.wait(lock, [this] { return m_isStopping || 0 < m_pendingCount; });
+            if (m_isStopping)
+                return ListingPtr();
+        }
+        ListingPtr result;
+        {
+            TaskQueue& own = *m_queues[index];
+            std::lock_guard<std::mutex> queueLock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                result = std::move(own.tasks.back());
+                own.tasks.pop_back();
+            }
+        }
+        for (size_t i = 1; !result && i < m_queues.size(); ++i)
+        {
+            TaskQueue& other = *m_queues[(index + i) % m_queues.size()];
+            std::lock_guard<std::mutex> queueLock(other.mutex);
+            if (!other.tasks.empty())
+            {
+                result = std::move(other.tasks.front());
+                other.tasks.pop_front();
+            }
+        }
+        if (result)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_pendingCount;
+            return result;
+        }
+        std::this_thread::yield(); // The task counted was taken by another worker
+    }
+}
+
+/// Make the listings of \c listing's subdirectories available to worker \c index
+    void
+DirectoryWalker::Submit(size_t index, const Listing& listing)
+{
+    size_t count = 0;
+    {
+        TaskQueue& queue = *m_queues[index];
+        std::lock_guard<std::mutex> queueLock(queue.mutex);
+        // The first subdirectory is walked first, so put it at the back
+        for (auto pEntry = listing.entries.rbegin(); listing.entries.rend() != pEntry; ++pEntry)
+        {
+            if (pEntry->subdirectory)
+            {
+                queue.tasks.push_back(pEntry->subdirectory);
+                ++count;
+            }
+        }
+    }
+    if (0 < count)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pendingCount += count;
+        }
+        if (1 < count)
+            m_taskAdded.notify_all();
+        else
+            m_taskAdded.notify_one();
+    }
+}
+
+/// Mark \c listing Ready
+    void
+DirectoryWalker::Publish(Listing& listing)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        listing.state = Listing::Ready;
+    }
+    m_listingReady.notify_all();
+}
+
+#if defined(_WIN32)
+/// Put the entries of \c listing.directory into \c listing
+    void
+DirectoryWalker::Read(Listing& listing) const
+{
+    try
+    {
+        for (fs::directory_iterator pItem(listing.directory), end; end != pItem; ++pItem)
+        {
+            fs::file_type linkType = pItem->symlink_status().type();
+            fs::file_type type = fs::symlink_file == linkType ? pItem->status().type() : linkType;
+            bool skipDirectory = false;
+            bool isIncluded = !m_test || m_test->IsIncluded(listing.level, pItem->path(), type, skipDirectory);
+            if (!isIncluded && skipDirectory && fs::directory_file != type)
+                break; // Skip the remainder of this directory
+            ListingPtr subdirectory;
+            if (fs::directory_file == linkType && !(!isIncluded && skipDirectory))
+                subdirectory = std::make_shared<Listing>(pItem->path(), listing.level + 1);
+            listing.entries.push_back(Entry{pItem->path(), isIncluded, subdirectory});
+        }
+    }
+    catch (...)
+    {
+        listing.error = std::current_exception();
+    }
+}
+
+#else // !defined(_WIN32)
+/// Put the entries of \c listing.directory into \c listing
+    void
+DirectoryWalker::Read(Listing& listing) const
+{
+    try
+    {
+        int fd = open(listing.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        DIR* dir = fd < 0 ? 0 : fdopendir(fd);
+        if (!dir)
+        {
+            int error = errno;
+            if (0 <= fd)
+                close(fd);
+            throw fs::filesystem_error("directory_iterator::construct", listing.directory
+                , boost::system::error_code(error, boost::system::system_category()));
+        }
+        std::unique_ptr<DIR, int (*)(DIR*)> closer(dir, closedir);
+        for (;;)
+        {
+            errno = 0;
+            struct dirent* item = readdir(dir);
+            if (!item)
+            {
+                if (0 != errno)
+                    throw fs::filesystem_error("directory_iterator::operator++", listing.directory
+                        , boost::system::error_code(errno, boost::system::system_category()));
+                break;
+            }
+            const char* name = item->d_name;
+            if ('.' == name[0] && ('\0' == name[1] || ('.' == name[1] && '\0' == name[2])))
+                continue;
+            // Only call stat when readdir does not provide the type or the entry is a link
+            fs::file_type linkType = GetFileType(item->d_type);
+            if (fs::status_unknown == linkType)
+                linkType = GetFileType(fd, name, false);
+            fs::file_type type = fs::symlink_file == linkType ? GetFileType(fd, name, true) : linkType;
+            PathType path = listing.directory / name;
+            bool skipDirectory = false;
+            bool isIncluded = !m_test || m_test->IsIncluded(listing.level, path, type, skipDirectory);
+            if (!isIncluded && skipDirectory && fs::directory_file != type)
+                break; // Skip the remainder of this directory
+            ListingPtr subdirectory;
+            if (fs::directory_file == linkType && !(!isIncluded && skipDirectory))
+                subdirectory = std::make_shared<Listing>(path, listing.level + 1);
+            listing.entries.push_back(Entry{std::move(path), isIncluded, std::move(subdirectory)});
+        }
+    }
+    catch (...)
+    {
+        listing.error = std::current_exception();
+    }
+    HOT_PATH_DEBUG(log_s, "Read: " << listing.directory << " entryCount " << listing.entries.size());
+}
+#endif // !defined(_WIN32)
@@ -0,0 +1,117 @@
+#if !defined(DIRECTORY_WALKER_INCLUDED)
+#define DIRECTORY_WALKER_INCLUDED
+#include "DirectoryEntryIterator.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Reads the directories of a tree in parallel, ahead of their use.
+///
+/// Each worker thread takes the most recently found directory from its own queue
+/// and, when that is empty, steals the oldest directory from the queue of another worker.
+/// The file type reported by readdir is used to avoid a stat call for each entry.
+/// The selector is applied as each directory is read, so pruned subdirectories are never read.
+class DirectoryWalker
+{
+public: // Types
+    typedef boost::filesystem::path PathType;
+    struct Listing;
+    typedef std::shared_ptr<Listing> ListingPtr;
+
+    /// An item in a directory
+    struct Entry
+    {
+        PathType   path;         //!< The full path of the item
+        bool       isIncluded;   //!< Was the item selected?
+        ListingPtr subdirectory; //!< The content of the item when it is to be walked (or null)
+    };
+
+    /// The entries (in readdir order) of a directory
+    struct Listing
+    {
+        enum StateType { Pending, Reading, Ready };
+        PathType           directory; //!< The directory read
+        int                level;     //!< The depth of the entries below the start directory
+        std::vector<Entry> entries;   //!< Available when Ready
+        std::exception_ptr error;     //!< Why the directory could not be read
+        std::atomic<int>   state;     //!< A StateType value
+
+        Listing(const PathType& dir, int depth)
+            : directory(dir)
+            , level(depth)
+            , state(Pending)
+        {}
+    };
+
+protected: // Types
+    /// The directories found by one worker
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<ListingPtr> tasks;
+    };
+    typedef std::vector<std::unique_ptr<TaskQueue>> QueueStore;
+
+    /// A position in a listing
+    struct Frame
+    {
+        ListingPtr listing;
+        size_t     next; //!< The index of the next entry
+    };
+    typedef std::vector<Frame> FrameStore;
+
+private: // Attributes
+    DirectoryEntrySelectorPtr m_test; //!< Selects the directory entries
+    QueueStore m_queues; //!< One for each worker
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_taskAdded; //!< Signalled when m_pendingCount increases or on stopping
+    std::condition_variable m_listingReady; //!< Signalled when a listing becomes Ready
+    size_t m_pendingCount; //!< The number of listings in m_queues
+    size_t m_nextQueue; //!< Where the next directory not found by a worker is put
+    bool m_isStopping; //!< Should the workers exit?
+    FrameStore m_path; //!< The listings from the start directory to the current entry
+
+public: // ...structors
+    /// A walker using \c threadCount workers (none reads directories only when required) and \c test
+    DirectoryWalker(const DirectoryEntrySelectorPtr& test, int threadCount);
+    DirectoryWalker(const DirectoryWalker&) = delete;
+    DirectoryWalker& operator=(const DirectoryWalker&) = delete;
+    ~DirectoryWalker();
+
+public: // Methods
+    /// Begin a walk of the tree below \c dir
+    void Start(const PathType& dir);
+
+    /// Put the next selected entry (in depth first order) into \c item. Returns false at the end of the walk.
+    bool Next(PathType& item);
+
+protected: // Support methods
+    /// The entries of \c dir (read in the background)
+    ListingPtr Add(const PathType& dir);
+
+    /// Wait until the entries of \c listing are available, reading it now if no worker has started it
+    void Wait(Listing& listing);
+
+    /// Take and read listings until stopping
+    void Run(size_t index);
+
+    /// Wait for a listing to read, preferring the newest in the queue of worker \c index
+    ListingPtr NextTask(size_t index);
+
+    /// Make the listings of \c listing's subdirectories available to worker \c index
+    void Submit(size_t index, const Listing& listing);
+
+    /// Put the entries of \c listing.directory into \c listing
+    void Read(Listing& listing) const;
+
+    /// Mark \c listing Ready
+    void Publish(Listing& listing);
+};
+
+#endif // !defined(DIRECTORY_WALKER_INCLUDED)
@@ -0,0 +1,105 @@
+#include "EditSet.h"
+#include <algorithm>
+
+/// No changes
+EditSet::EditSet()
+    : m_isSorted(true)
+    , m_changeCount(0)
+    , m_updateIndexes(&m_arena)
+{}
+
+/// Has a change been made at a content index from \c start to \c end (inclusive)?
+    bool
+EditSet::HasUpdateBetween(size_t start, size_t end) const
+{
+    IndexSet::const_iterator pIndex = m_updateIndexes.lower_bound(start);
+    return m_updateIndexes.end() != pIndex && *pIndex <= end;
+}
+
+/// Append \c text after the character at \c index
+    void
+EditSet::AppendText(size_t index, const StringType& text)
+{
+    AddUpdate(index, true, index + 1, text);
+}
+
+/// Insert \c text before the character at \c index
+    void
+EditSet::InsertText(size_t index, const StringType& text)
+{
+    AddUpdate(index, false, index, text);
+}
+
+/// Add the changes in \c other as though made after those already in this
+    void
+EditSet::Merge(const EditSet& other)
+{
+    ptrdiff_t sequenceOffset = m_changeCount;
+    m_changeCount += other.m_changeCount;
+    for (auto& item : other.m_updates)
+    {
+        m_updates.push_back(item);
+        UpdateData& update = m_updates.back();
+        update.sequence += update.sequence < 0 ? -sequenceOffset : sequenceOffset;
+        update.text = m_arena.Copy(item.text);
+        m_isSorted = m_isSorted && (m_updates.size() < 2 || m_updates[m_updates.size() - 2] < update);
+        m_updateIndexes.insert(update.index);
+    }
+}
+
+/// Forget the changes, retaining the allocated storage for reuse
+    void
+EditSet::Clear()
+{
+    m_updates.clear();
+    m_isSorted = true;
+    m_changeCount = 0;
+    m_updateIndexes.clear();
+    m_arena.Rewind();
+}
+
+/// Forget the changes at content indexes before \c end, such as those already output
+    void
+EditSet::RemoveBefore(size_t end)
+{
+    const UpdateStore& updates = GetSortedUpdates();
+    UpdateStore::const_iterator pEnd = std::partition_point(updates.begin(), updates.end()
+        , [end](const UpdateData& item) { return item.index < end; });
+    if (updates.begin() == pEnd)
+        return;
+    // The arena only reclaims memory when rewound, so the few remaining changes are copied out and back
+    std::vector<StringType> texts;
+    for (UpdateStore::const_iterator pItem = pEnd; updates.end() != pItem; ++pItem)
+        texts.push_back(StringType(pItem->text));
+    m_updates.erase(m_updates.begin(), m_updates.begin() + (pEnd - updates.begin()));
+    m_updateIndexes.clear();
+    m_arena.Rewind();
+    for (size_t i = 0; i < m_updates.size(); ++i)
+    {
+        m_updates[i].text = m_arena.Copy(texts[i]);
+        m_updateIndexes.insert(m_updates[i].index);
+    }
+}
+
+/// The changes in output order
+    const EditSet::UpdateStore&
+EditSet::GetSortedUpdates()
+{
+    if (!m_isSorted)
+    {
+        std::sort(m_updates.begin(), m_updates.end());
+        m_isSorted = true;
+    }
+    return m_updates;
+}
+
+/// Record the insertion of \c text at content index \c at, made by AppendText (when \c isAppended) or InsertText at \c index.
+/// Insertions at the same index are output in reverse order, followed by the appended text in order.
+    void
+EditSet::AddUpdate(size_t index, bool isAppended, size_t at, const Arena::TextType& text)
+{
+    ptrdiff_t sequence = ++m_changeCount;
+    m_updates.push_back(UpdateData{index, isAppended ? sequence : -sequence, at, Insert, m_arena.Copy(text), at});
+    m_isSorted = m_isSorted && (m_updates.size() < 2 || m_updates[m_updates.size() - 2] < m_updates.back());
+    m_updateIndexes.insert(index);
+}
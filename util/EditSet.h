@@ -0,0 +1,90 @@
+#if !defined(EDIT_SET_INCLUDED)
+#define EDIT_SET_INCLUDED
+#include "Arena.h"
+#include <cstddef>
+#include <memory_resource>
+#include <set>
+#include <string>
+#include <vector>
+
+/// The changes made to a file's content by one analysis, kept apart from the content
+/// so several analyses of the same (unchanging) content can run concurrently and be merged later.
+///
+/// The changes are kept in the order they were made until sorted for output.
+/// Their text is copied into an arena that Clear() rewinds, so a sequence of files stops allocating.
+/// RemoveBefore() lets content read progressively be output as the changes before it are made.
+class EditSet
+{
+public: // Types
+    typedef std::string StringType;
+    enum EditType { Delete, Insert, Modify };
+    struct UpdateData
+    {
+        size_t     index;    //!< The content index given to InsertText or AppendText
+        ptrdiff_t  sequence; //!< The (1-based) order in which the change was made, negated for an insertion
+        size_t     at;
+        EditType   type;
+        Arena::TextType text;
+        size_t     resumeAt;
+        /// Is this output before \c other?
+        bool operator<(const UpdateData& other) const
+        {
+            return index < other.index || (index == other.index && sequence < other.sequence);
+        }
+    };
+    typedef std::vector<UpdateData> UpdateStore;
+
+protected: // Types
+    typedef std::pmr::set<size_t> IndexSet;
+
+private: // Attributes
+    Arena m_arena; //!< Holds m_updateIndexes and the change text
+    UpdateStore m_updates; //!< The changes in the order they were made until sorted for output
+    bool m_isSorted; //!< Are m_updates in output order?
+    ptrdiff_t m_changeCount; //!< The number of changes made since Clear() (including those removed)
+    IndexSet m_updateIndexes; //!< The content index of each change
+
+public: // ...structors
+    /// No changes
+    EditSet();
+    EditSet(const EditSet&) = delete;
+    EditSet& operator=(const EditSet&) = delete;
+
+public: // Accessors
+    /// Are there no changes?
+    bool IsEmpty() const { return m_updates.empty(); }
+
+    /// The number of changes
+    size_t Size() const { return m_updates.size(); }
+
+    /// The memory holding the changes
+    const Arena& GetArena() const { return m_arena; }
+
+    /// Has a change been made at a content index from \c start to \c end (inclusive)?
+    bool HasUpdateBetween(size_t start, size_t end) const;
+
+public: // Modifiers
+    /// Append \c text after the character at \c index
+    void AppendText(size_t index, const StringType& text);
+
+    /// Insert \c text before the character at \c index
+    void InsertText(size_t index, const StringType& text);
+
+    /// Add the changes in \c other as though made after those already in this
+    void Merge(const EditSet& other);
+
+    /// Forget the changes, retaining the allocated storage for reuse
+    void Clear();
+
+    /// Forget the changes at content indexes before \c end, such as those already output
+    void RemoveBefore(size_t end);
+
+    /// The changes in output order
+    const UpdateStore& GetSortedUpdates();
+
+protected: // Support methods
+    /// Record the insertion of \c text at content index \c at, made by AppendText (when \c isAppended) or InsertText at \c index
+    void AddUpdate(size_t index, bool isAppended, size_t at, const Arena::TextType& text);
+};
+
+#endif // !defined(EDIT_SET_INCLUDED)
@@ -0,0 +1,194 @@
+#include "FileProcessor.h"
+#include <sstream>
+
+/// A processor checking files as \c options require
+FileProcessor::FileProcessor(const ProcessingOptions& options)
+    : m_file(options.lexerType, options.inputType)
+    , m_macro(m_file, options.rules)
+    , m_stream(options.rules)
+    , m_streamSize(options.streamSize)
+    , m_fix(options.fix)
+    , m_fix_10_and_11(options.fix_10_and_11)
+    , m_diff(options.diff)
+    , m_changedLines(options.changedLines)
+    , m_allowMapping(CppFile::MappedInput == options.inputType)
+    , m_collectStats(options.collectStats)
+    , m_counters(options.collectStats)
+    , m_stats(&m_counters)
+{
+    m_file.SetPrefilter(m_macro.GetPrefilter());
+    m_stream.SetFix(m_fix, m_fix_10_and_11);
+    if (m_collectStats)
+        m_file.SetStats(&m_stats);
+    if (!options.cacheDir.empty())
+    {
+        // Results depend on the macros selected, the changes made and the tokenizer
+        std::string ruleSet = m_macro.GetSelectionKey()
+            + " fix=" + std::to_string(m_fix)
+            + " fix_10_and_11=" + std::to_string(m_fix_10_and_11)
+            + " lexer=" + std::to_string(int(options.lexerType));
+        m_cache.reset(new ResultCache(options.cacheDir, ruleSet));
+    }
+}
+
+/// Check (and optionally change) \c path, using its \c content when already read
+    FileResult
+FileProcessor::Process(const PathType& path, InputFile* content)
+{
+    FileResult result(path);
+    m_stats.Clear();
+    Check(result, content);
+    if (m_collectStats)
+        result.stats = m_stats;
+    return result;
+}
+
+/// Check (and optionally change) \c content named \c name, putting the changed content (if any) in \c output
+    FileResult
+FileProcessor::ProcessBuffer(const PathType& name, const StringType& content, StringType& output)
+{
+    FileResult result(name);
+    output.clear();
+    m_file.SetLineRanges(CppFile::LineRangeStore());
+    m_input.Assign(content);
+    m_file.LoadFile(name, m_input);
+    m_input.Close();
+    result.isValid = m_file.IsValid();
+    result.isPrefiltered = m_file.IsPrefiltered();
+    int macroCount = 0;
+    if (result.isValid)
+        result.fixCount = ProcessMacros(macroCount);
+    if (m_fix && 0 < result.fixCount)
+    {
+        std::ostringstream os;
+        m_file.Store(os);
+        output = os.str();
+    }
+    return result;
+}
+
+/// Check (and optionally change) \c result.path (with \c content when already read), putting the outcome in \c result
+    void
+FileProcessor::Check(FileResult& result, InputFile* content)
+{
+    PhaseStats* stats = m_collectStats ? &m_stats : 0;
+    const CppFile::LineRangeStore* lineRanges = m_changedLines.Find(result.path);
+    m_file.SetLineRanges(lineRanges ? *lineRanges : CppFile::LineRangeStore());
+    if (!lineRanges && !m_diff && IsStreamed(result.path))
+    {
+        if (content)
+            content->Close();
+        PhaseStats::Timer analyseTimer(stats, PhaseStats::Analyse);
+        result.isValid = m_stream.ProcessFile(result.path);
+        analyseTimer.Stop();
+        result.fixCount = m_stream.GetFixCount();
+        m_stats.AddCount(PhaseStats::Bytes, m_stream.GetContentSize());
+        m_stats.AddCount(PhaseStats::Tokens, m_stream.GetTokenCount());
+        m_stats.AddCount(PhaseStats::Macros, m_stream.GetMacroCount());
+        m_stats.AddCount(PhaseStats::Fixes, result.fixCount);
+        return;
+    }
+    ResultCache::KeyType key{0, 0};
+    bool isCached = m_cache && !lineRanges; // The outcome of a whole file is cached
+    if (!isCached && content)
+        m_file.LoadFile(result.path, *content);
+    else if (!isCached)
+        m_file.LoadFile(result.path);
+    else
+    {
+        PhaseStats::Timer readTimer(stats, PhaseStats::Read);
+        if (content)
+            m_input.Swap(*content);
+        else if (!m_input.Open(result.path, m_allowMapping))
+            return;
+        key = m_cache->GetKey(m_input.GetContent());
+        ResultCache::ValueType value;
+        // A change must be made even though the outcome is known
+        if (m_cache->Find(key, value) && !(m_fix && 0 < value.fixCount))
+        {
+            m_stats.AddCount(PhaseStats::Bytes, m_input.GetContent().size());
+            m_stats.AddCount(PhaseStats::Macros, value.macroCount);
+            m_stats.AddCount(PhaseStats::Fixes, value.fixCount);
+            m_input.Close();
+            result.isValid = true;
+            result.fixCount = value.fixCount;
+            result.isCached = true;
+            return;
+        }
+        readTimer.Stop();
+        m_file.LoadFile(result.path, m_input);
+        m_input.Close();
+    }
+    result.isValid = m_file.IsValid();
+    result.isPrefiltered = m_file.IsPrefiltered();
+    int macroCount = 0;
+    if (result.isValid)
+    {
+        PhaseStats::Timer analyseTimer(stats, PhaseStats::Analyse);
+        result.fixCount = ProcessMacros(macroCount);
+    }
+    PhaseStats::Timer writeTimer(stats, PhaseStats::Write);
+    if (m_fix && 0 < result.fixCount && m_diff)
+        result.patch = GetPatch(result.path);
+    else if (m_fix && 0 < result.fixCount)
+        m_file.StoreFile(result.path);
+    if (isCached && result.isValid)
+        m_cache->Store(key, ResultCache::ValueType{macroCount, result.fixCount});
+    writeTimer.Stop();
+    m_stats.AddCount(PhaseStats::Bytes, m_file.GetContentSize());
+    m_stats.AddCount(PhaseStats::Tokens, m_file.GetTokenCount());
+    m_stats.AddCount(PhaseStats::Identifiers, m_file.GetDistinctIdentifierCount());
+    m_stats.AddCount(PhaseStats::Macros, macroCount);
+    m_stats.AddCount(PhaseStats::Fixes, result.fixCount);
+    m_stats.AddPeak(PhaseStats::ArenaBytes, m_file.GetArena().GetUsed());
+    m_stats.AddPeak(PhaseStats::ArenaCapacity, m_file.GetArena().GetCapacity());
+}
+
+/// The number of macros in m_file without a statement terminator, changing them when m_fix.
+/// A rule without an action adds a semicolon, and also braces when m_fix_10_and_11.
+/// The number of macros is put in \c macroCount.
+    int
+FileProcessor::ProcessMacros(int& macroCount)
+{
+    MacroRuleSet::ActionType defaultAction = m_fix_10_and_11 ? MacroRuleSet::Both : MacroRuleSet::Terminate;
+    macroCount = 0;
+    int fixCount = 0;
+    for (m_macro.Start(); !m_macro.Off(); m_macro.Forth())
+    {
+        ++macroCount;
+        if (!m_macro.HasStatementTerminator())
+        {
+            ++fixCount;
+            MacroRuleSet::ActionType action = m_macro.GetRule().action;
+            if (MacroRuleSet::DefaultAction == action)
+                action = defaultAction;
+            if (m_fix && (action & MacroRuleSet::Terminate))
+                m_macro.AddSemicolon();
+            if (m_fix && (action & MacroRuleSet::Brace) && m_macro.IsCompoundStatementBody())
+                m_macro.InsertBraces();
+        }
+    }
+    return fixCount;
+}
+
+/// The modifications to \c path as a unified diff, with the a/ and b/ name prefixes of git when \c path is relative
+    FileProcessor::StringType
+FileProcessor::GetPatch(const PathType& path)
+{
+    StringType name = path.lexically_normal().generic_string();
+    bool isRelative = path.is_relative();
+    std::ostringstream os;
+    m_file.StoreDiff(os, isRelative ? "a/" + name : name, isRelative ? "b/" + name : name);
+    return os.str();
+}
+
+/// Is \c path too large to load?
+    bool
+FileProcessor::IsStreamed(const PathType& path) const
+{
+    if (UINTMAX_MAX == m_streamSize)
+        return false;
+    boost::system::error_code ec;
+    uintmax_t size = boost::filesystem::file_size(path, ec);
+    return !ec && m_streamSize <= size;
+}
@@ -0,0 +1,104 @@
+#if !defined(FILE_PROCESSOR_INCLUDED)
+#define FILE_PROCESSOR_INCLUDED
+#include "ChangedLines.h"
+#include "CppFile.h"
+#include "CppStream.h"
+#include "InputFile.h"
+#include "MacroRuleSet.h"
+#include "PhaseStats.h"
+#include "ResultCache.h"
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/// The outcome of checking a file
+struct FileResult
+{
+    typedef boost::filesystem::path PathType;
+    typedef std::string StringType;
+
+    PathType path;
+    bool     isValid;
+    int      fixCount;
+    bool     isPrefiltered; //!< Was the file skipped without tokenizing?
+    bool     isCached;      //!< Was the outcome of a previous run reused?
+    PhaseStats stats;       //!< The resources used (when collecting statistics)
+    StringType patch;       //!< The modifications as a unified diff (when requested)
+
+    /// An invalid, unchanged outcome for \c file
+    FileResult(const PathType& file = PathType())
+        : path(file)
+        , isValid(false)
+        , fixCount(0)
+        , isPrefiltered(false)
+        , isCached(false)
+    {}
+};
+
+/// How each file is checked
+struct ProcessingOptions
+{
+    bool               fix;           //!< Add missing semicolons?
+    bool               fix_10_and_11; //!< Add braces around compound statement bodies?
+    bool               diff;          //!< Put modifications in FileResult::patch instead of the file?
+    CppFile::LexerType lexerType;     //!< The tokenizer to use
+    CppFile::InputType inputType;     //!< How files are loaded
+    MacroRuleSet       rules;         //!< The function calls to check
+    std::string        cacheDir;      //!< Where results are kept for later runs (when not empty)
+    uintmax_t          streamSize;    //!< The size from which files are processed a chunk at a time (or UINTMAX_MAX)
+    bool               collectStats;  //!< Record the resources used in each phase?
+    size_t             readAheadDepth; //!< The number of files read ahead of processing (or 0)
+    ChangedLines       changedLines;  //!< The lines to check in some files (other files are checked entirely)
+};
+
+/// Checks (and optionally changes) the macro usage in one file at a time
+class FileProcessor
+{
+public: // Types
+    typedef FileResult::PathType PathType;
+    typedef FileResult::StringType StringType;
+
+private: // Attributes
+    CppFile m_file; //!< The current file
+    CppFile::FunctionIterator m_macro; //!< Steps through the macros in m_file
+    CppStream m_stream; //!< Checks files too large to load
+    uintmax_t m_streamSize; //!< The size from which m_stream is used (or UINTMAX_MAX)
+    bool m_fix; //!< Add missing semicolons?
+    bool m_fix_10_and_11; //!< Add braces around compound statement bodies?
+    bool m_diff; //!< Put modifications in FileResult::patch instead of the file?
+    ChangedLines m_changedLines; //!< The lines to check in some files
+    std::unique_ptr<ResultCache> m_cache; //!< Results of previous runs (or null)
+    InputFile m_input; //!< The content to look up in m_cache
+    bool m_allowMapping; //!< Map m_input into memory?
+    bool m_collectStats; //!< Record the resources used in each phase?
+    HardwareCounters m_counters; //!< Of the thread using this
+    PhaseStats m_stats; //!< The resources used by the current file
+
+public: // ...structors
+    /// A processor checking files as \c options require
+    FileProcessor(const ProcessingOptions& options);
+
+public: // Methods
+    /// Check (and optionally change) \c path, using its \c content when already read
+    FileResult Process(const PathType& path, InputFile* content = 0);
+
+    /// Check (and optionally change) \c content named \c name, putting the changed content (if any) in \c output
+    FileResult ProcessBuffer(const PathType& name, const StringType& content, StringType& output);
+
+protected: // Support methods
+    /// Check (and optionally change) \c result.path (with \c content when already read), putting the outcome in \c result
+    void Check(FileResult& result, InputFile* content);
+
+    /// The number of macros in m_file without a statement terminator, changing them when m_fix.
+    /// The number of macros is put in \c macroCount.
+    int ProcessMacros(int& macroCount);
+
+    /// The modifications to \c path as a unified diff, with the a/ and b/ name prefixes of git when \c path is relative
+    StringType GetPatch(const PathType& path);
+
+    /// Is \c path too large to load?
+    bool IsStreamed(const PathType& path) const;
+};
+
+#endif // !defined(FILE_PROCESSOR_INCLUDED)
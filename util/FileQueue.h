@@ -0,0 +1,123 @@
+#if !defined(FILE_QUEUE_INCLUDED)
+#define FILE_QUEUE_INCLUDED
+#include <boost/filesystem.hpp>
+#include <condition_variable>
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/// A bounded queue of files to be processed by a pool of worker threads
+/// that provides the processing results in the order the files were added.
+///
+/// The next idle worker is given the largest of the pending files,
+/// so a large file added late in the sequence does not become the only work left.
+template <class ResultT>
+class FileQueue
+{
+public: // Types
+    typedef boost::filesystem::path PathType;
+    typedef ResultT ResultType;
+    struct JobType
+    {
+        size_t    sequence; //!< The position of this in the order files were added
+        uintmax_t size;     //!< The byte count used to prioritise this
+        PathType  path;     //!< The file to be processed
+    };
+
+protected: // Types
+    typedef std::vector<JobType> JobStore;
+    typedef std::map<size_t, ResultType> ResultMap;
+
+private: // Attributes
+    std::mutex m_mutex;
+    std::condition_variable m_jobAdded; //!< Signalled when m_pending has an item or is closed
+    std::condition_variable m_resultAdded; //!< Signalled when m_completed has the next result
+    std::condition_variable m_spaceAvailable; //!< Signalled when a result is removed
+    JobStore m_pending; //!< A heap ordered on JobType::size
+    ResultMap m_completed; //!< Results not yet removed, keyed on JobType::sequence
+    size_t m_capacity; //!< The maximum number of files added but not yet removed as a result
+    size_t m_addedCount; //!< The sequence number of the next added file
+    size_t m_removedCount; //!< The sequence number of the next result to be removed
+    bool m_closed; //!< Will no more files be added?
+
+public: // ...structors
+    /// An empty queue holding at most \c capacity unfinished files
+    FileQueue(size_t capacity)
+        : m_capacity(std::max<size_t>(1, capacity))
+        , m_addedCount(0)
+        , m_removedCount(0)
+        , m_closed(false)
+    {}
+
+public: // Modifiers
+    /// Append \c path (of \c size bytes), waiting until there is space available
+    void Add(const PathType& path, uintmax_t size)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_spaceAvailable.wait(lock, [this] { return m_addedCount - m_removedCount < m_capacity; });
+        m_pending.push_back(JobType{m_addedCount++, size, path});
+        std::push_heap(m_pending.begin(), m_pending.end(), IsSmaller);
+        m_jobAdded.notify_one();
+    }
+
+    /// Indicate no more files will be added
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_jobAdded.notify_all();
+        m_resultAdded.notify_all();
+    }
+
+    /// Wait for a file to process and move it into \c job. Returns false when the queue is closed and empty.
+    bool NextJob(JobType& job)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobAdded.wait(lock, [this] { return m_closed || !m_pending.empty(); });
+        if (m_pending.empty())
+            return false;
+        std::pop_heap(m_pending.begin(), m_pending.end(), IsSmaller);
+        job = std::move(m_pending.back());
+        m_pending.pop_back();
+        return true;
+    }
+
+    /// Store the \c result of processing the file added at \c sequence
+    void Complete(size_t sequence, ResultType&& result)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_completed.emplace(sequence, std::move(result));
+        if (sequence == m_removedCount)
+            m_resultAdded.notify_all();
+    }
+
+    /// Wait for the next result in file order and move it into \c result.
+    /// Returns false when the queue is closed and all results have been removed.
+    bool NextResult(ResultType& result)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_resultAdded.wait(lock, [this]
+            { return (m_closed && m_removedCount == m_addedCount)
+                  || m_completed.count(m_removedCount);
+            });
+        typename ResultMap::iterator pItem = m_completed.find(m_removedCount);
+        if (m_completed.end() == pItem)
+            return false;
+        result = std::move(pItem->second);
+        m_completed.erase(pItem);
+        ++m_removedCount;
+        m_spaceAvailable.notify_one();
+        return true;
+    }
+
+protected: // Support methods
+    /// Heap ordering that puts the largest file first
+    static bool IsSmaller(const JobType& left, const JobType& right)
+    {
+        return left.size < right.size || (left.size == right.size && right.sequence < left.sequence);
+    }
+};
+
+#endif // !defined(FILE_QUEUE_INCLUDED)
@@ -0,0 +1,23 @@
+#if !defined(HOT_PATH_LOGGING_INCLUDED)
+#define HOT_PATH_LOGGING_INCLUDED
+#include <log4cxx/logger.h>
+
+/// Logging requests in loops that run for each token, identifier or directory entry.
+///
+/// These are kept only in diagnostic builds (Debug configurations or the HOT_PATH_LOGGING CMake option),
+/// where they are controlled at run time by the loggers named in log4cxx_10_to_11.properties.
+/// Otherwise the request (including the logger level check) is discarded at compile time,
+/// though the message expression is still type checked.
+#if defined(HOT_PATH_LOGGING)
+constexpr bool IsHotPathLogged = true;
+#else
+constexpr bool IsHotPathLogged = false;
+#endif
+
+#define HOT_PATH_TRACE(logger, message) \
+    do { if constexpr (IsHotPathLogged) { LOG4CXX_TRACE(logger, message); } } while (false)
+
+#define HOT_PATH_DEBUG(logger, message) \
+    do { if constexpr (IsHotPathLogged) { LOG4CXX_DEBUG(logger, message); } } while (false)
+
+#endif // !defined(HOT_PATH_LOGGING_INCLUDED)
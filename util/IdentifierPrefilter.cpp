@@ -0,0 +1,72 @@
+#include "IdentifierPrefilter.h"
+#include "TextSearch.h"
+#include <cstring>
+
+namespace
+{
+    /// Can \c ch continue an identifier?
+    inline bool IsIdentifierPart(char ch)
+    {
+        unsigned char uch = static_cast<unsigned char>(ch);
+        return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') || ('0' <= ch && ch <= '9')
+            || '_' == ch || 0x80 <= uch;
+    }
+}
+
+/// Select identifiers starting with \c prefix
+    void
+IdentifierPrefilter::AddPrefix(const StringType& prefix)
+{
+    m_prefixes.push_back(prefix);
+    if (1 < m_prefixes.size())
+        m_matcher = PatternMatcher(m_prefixes);
+}
+
+/// Do not select identifiers starting with \c prefix
+    void
+IdentifierPrefilter::AddExclusion(const StringType& prefix)
+{
+    m_exclusions.push_back(prefix);
+}
+
+/// Does [first, last) contain the start of an identifier of interest?
+    bool
+IdentifierPrefilter::HasCandidate(const char* first, const char* last) const
+{
+    if (m_prefixes.empty())
+        return true;
+    if (1 < m_prefixes.size())
+    {
+        return m_matcher.FindEach(first, last, [this, first, last](const char* p, uint32_t)
+        {
+            return (first == p || !IsIdentifierPart(p[-1])) && !IsExcluded(p, last);
+        });
+    }
+    const StringType& prefix = m_prefixes.front();
+    const char* p = first;
+    while ((p = TextSearch::Find(p, last, prefix.data(), prefix.size())) != last)
+    {
+        if ((first == p || !IsIdentifierPart(p[-1])) && !IsExcluded(p, last))
+            return true;
+        ++p;
+    }
+    return false;
+}
+
+/// Does the identifier starting at \c p (before \c last) start with an excluded prefix longer than its selected prefix?
+    bool
+IdentifierPrefilter::IsExcluded(const char* p, const char* last) const
+{
+    auto startsWith = [p, last](const StringType& prefix)
+    {
+        return prefix.size() <= size_t(last - p) && 0 == memcmp(p, prefix.data(), prefix.size());
+    };
+    size_t selectedSize = 0;
+    for (auto& prefix : m_prefixes)
+        if (selectedSize < prefix.size() && startsWith(prefix))
+            selectedSize = prefix.size();
+    for (auto& exclusion : m_exclusions)
+        if (selectedSize < exclusion.size() && startsWith(exclusion))
+            return true;
+    return false;
+}
@@ -0,0 +1,46 @@
+#if !defined(IDENTIFIER_PREFILTER_INCLUDED)
+#define IDENTIFIER_PREFILTER_INCLUDED
+#include "PatternMatcher.h"
+#include <string>
+#include <vector>
+
+/// Detects content that cannot contain an identifier of interest without tokenizing it.
+///
+/// An identifier of interest starts with a selected prefix and does not start with a longer excluded prefix.
+/// A single prefix is found using the TextSearch kernels; several prefixes are found in one pass by a PatternMatcher.
+/// Text in comments and literals is not distinguished, so content may be accepted needlessly but never rejected wrongly.
+class IdentifierPrefilter
+{
+public: // Types
+    typedef std::string StringType;
+    typedef std::vector<StringType> StringStore;
+
+private: // Attributes
+    StringStore m_prefixes; //!< Of the identifiers of interest
+    StringStore m_exclusions; //!< Of identifiers that are not of interest
+    PatternMatcher m_matcher; //!< Finds any of m_prefixes (when there are several)
+
+public: // ...structors
+    /// A prefilter that accepts everything
+    IdentifierPrefilter() {}
+
+public: // Accessors
+    /// Does [first, last) contain the start of an identifier of interest?
+    bool HasCandidate(const char* first, const char* last) const;
+
+    /// Are all identifiers of interest?
+    bool IsEmpty() const { return m_prefixes.empty(); }
+
+public: // Modifiers
+    /// Select identifiers starting with \c prefix
+    void AddPrefix(const StringType& prefix);
+
+    /// Do not select identifiers starting with \c prefix
+    void AddExclusion(const StringType& prefix);
+
+protected: // Support methods
+    /// Does the identifier starting at \c p (before \c last) start with an excluded prefix longer than its selected prefix?
+    bool IsExcluded(const char* p, const char* last) const;
+};
+
+#endif // !defined(IDENTIFIER_PREFILTER_INCLUDED)
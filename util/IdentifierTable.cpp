@@ -0,0 +1,125 @@
+#include "IdentifierTable.h"
+#include <algorithm>
+#include <functional>
+
+const size_t IdentifierTable::MinimumSlotCount;
+
+/// An empty table
+IdentifierTable::IdentifierTable()
+    : m_slots(MinimumSlotCount, 0)
+    , m_firstInstance(1, 0)
+{}
+
+/// The rank of \c name, or Size() if not present
+    size_t
+IdentifierTable::Find(NameType name) const
+{
+    NumberStore::const_iterator pRank = std::lower_bound(m_idOfRank.begin(), m_idOfRank.end(), name,
+        [this](uint32_t id, NameType value) { return m_names[id] < value; });
+    if (m_idOfRank.end() == pRank || m_names[*pRank] != name)
+        return Size();
+    return pRank - m_idOfRank.begin();
+}
+
+/// The ranks of the identifiers that start with \c prefix
+    IdentifierTable::RangeType
+IdentifierTable::GetPrefixRange(NameType prefix) const
+{
+    NumberStore::const_iterator pFirst = std::lower_bound(m_idOfRank.begin(), m_idOfRank.end(), prefix,
+        [this](uint32_t id, NameType value) { return m_names[id] < value; });
+    NumberStore::const_iterator pLast = std::partition_point(pFirst, m_idOfRank.end(),
+        [this, prefix](uint32_t id) { return 0 == m_names[id].compare(0, prefix.size(), prefix); });
+    return RangeType(pFirst - m_idOfRank.begin(), pLast - m_idOfRank.begin());
+}
+
+/// Remove all identifiers (retaining the allocated storage)
+    void
+IdentifierTable::Clear()
+{
+    // The names may no longer be readable, so the slots are not found by hashing them.
+    // Instead the table is shrunk when it is far larger than the names just cleared need,
+    // so emptying it costs time proportional to the size of the last file rather than the largest.
+    size_t neededSlotCount = MinimumSlotCount;
+    while (neededSlotCount < m_names.size() * 2)
+        neededSlotCount *= 2;
+    if (neededSlotCount * 8 < m_slots.size())
+        m_slots.assign(neededSlotCount, 0);
+    else
+        std::fill(m_slots.begin(), m_slots.end(), 0);
+    m_names.clear();
+    m_instanceIds.clear();
+    m_instanceOffsets.clear();
+    m_idOfRank.clear();
+    m_rankOfId.clear();
+    m_firstInstance.assign(1, 0);
+    m_rankedOffsets.clear();
+}
+
+/// Add an instance of \c name at \c offset - Precondition: \c name refers to the content
+    void
+IdentifierTable::Add(NameType name, size_t offset)
+{
+    size_t slot = FindSlot(name);
+    uint32_t id = m_slots[slot] - 1;
+    if (0 == m_slots[slot])
+    {
+        id = uint32_t(m_names.size());
+        m_names.push_back(name);
+        m_slots[slot] = id + 1;
+        if (m_slots.size() < m_names.size() * 2)
+            Grow();
+    }
+    m_instanceIds.push_back(id);
+    m_instanceOffsets.push_back(OffsetType(offset));
+}
+
+/// Rank the identifiers and group the instances by rank
+    void
+IdentifierTable::Index()
+{
+    m_idOfRank.resize(m_names.size());
+    for (uint32_t id = 0; id < m_idOfRank.size(); ++id)
+        m_idOfRank[id] = id;
+    std::sort(m_idOfRank.begin(), m_idOfRank.end(),
+        [this](uint32_t left, uint32_t right) { return m_names[left] < m_names[right]; });
+
+    m_rankOfId.resize(m_names.size());
+    for (uint32_t rank = 0; rank < m_idOfRank.size(); ++rank)
+        m_rankOfId[m_idOfRank[rank]] = rank;
+
+    // Count the instances of each rank, then convert the counts to the position of the first instance
+    m_firstInstance.assign(m_names.size() + 1, 0);
+    for (uint32_t id : m_instanceIds)
+        ++m_firstInstance[m_rankOfId[id] + 1];
+    for (size_t rank = 1; rank < m_firstInstance.size(); ++rank)
+        m_firstInstance[rank] += m_firstInstance[rank - 1];
+
+    // Distribute the offsets (keeping content order within a rank),
+    // which moves each m_firstInstance item to the start of the next rank
+    m_rankedOffsets.resize(m_instanceOffsets.size());
+    for (size_t i = 0; i < m_instanceOffsets.size(); ++i)
+        m_rankedOffsets[m_firstInstance[m_rankOfId[m_instanceIds[i]]]++] = m_instanceOffsets[i];
+    for (size_t rank = m_names.size(); 0 < rank; --rank)
+        m_firstInstance[rank] = m_firstInstance[rank - 1];
+    m_firstInstance[0] = 0;
+}
+
+/// The position in m_slots of \c name or the empty slot where it belongs
+    size_t
+IdentifierTable::FindSlot(NameType name) const
+{
+    size_t mask = m_slots.size() - 1;
+    size_t slot = std::hash<NameType>()(name) & mask;
+    while (0 != m_slots[slot] && m_names[m_slots[slot] - 1] != name)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+/// Double the size of m_slots
+    void
+IdentifierTable::Grow()
+{
+    m_slots.assign(m_slots.size() * 2, 0);
+    for (uint32_t id = 0; id < m_names.size(); ++id)
+        m_slots[FindSlot(m_names[id])] = id + 1;
+}
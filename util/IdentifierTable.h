@@ -0,0 +1,86 @@
+#if !defined(IDENTIFIER_TABLE_INCLUDED)
+#define IDENTIFIER_TABLE_INCLUDED
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// The distinct identifiers in some content and the content offsets of their instances.
+///
+/// A name is a view of its first instance in the content, so the content must outlive the names.
+/// Names are interned using an open addressing hash table while instances are added.
+/// Index() then ranks the names in sorted order, so the names starting with a prefix
+/// are a contiguous range of ranks, and groups the instance offsets by rank.
+/// Clear() retains the allocated storage, so reuse for many files does not allocate per identifier.
+/// It shrinks the hash table when it is far larger than the last file needed.
+class IdentifierTable
+{
+public: // Types
+    typedef std::string_view NameType;
+    typedef uint32_t OffsetType; //!< The index of the first character of an instance in the content
+    typedef const OffsetType* InstanceIterator;
+    typedef std::pair<size_t, size_t> RangeType; //!< The ranks [first, second)
+
+protected: // Types
+    typedef std::vector<NameType> NameStore;
+    typedef std::vector<uint32_t> NumberStore;
+    typedef std::vector<OffsetType> OffsetStore;
+
+private: // Class data
+    static const size_t MinimumSlotCount = 256; //!< The initial size of the hash table (a power of 2)
+
+private: // Attributes
+    NameStore m_names; //!< The name of each identifier, in order of first instance
+    NumberStore m_slots; //!< The hash table of (one more than) positions in m_names
+    NumberStore m_instanceIds; //!< The position in m_names of each instance, in content order
+    OffsetStore m_instanceOffsets; //!< The content offset of each instance, in content order
+    NumberStore m_idOfRank; //!< The position in m_names of each rank
+    NumberStore m_rankOfId; //!< The rank of each position in m_names
+    NumberStore m_firstInstance; //!< The position in m_rankedOffsets of the first instance of each rank
+    OffsetStore m_rankedOffsets; //!< The instance offsets in rank order
+
+public: // ...structors
+    /// An empty table
+    IdentifierTable();
+
+public: // Accessors - Precondition: Index() has been called since the last Add()
+    /// The number of distinct identifiers
+    size_t Size() const { return m_idOfRank.size(); }
+
+    /// The rank of \c name, or Size() if not present
+    size_t Find(NameType name) const;
+
+    /// The name of the identifier at \c rank - Precondition: rank < Size()
+    NameType GetName(size_t rank) const { return m_names[m_idOfRank[rank]]; }
+
+    /// The first instance of the identifier at \c rank - Precondition: rank < Size()
+    InstanceIterator BeginInstance(size_t rank) const { return m_rankedOffsets.data() + m_firstInstance[rank]; }
+
+    /// The sentinal of the instances of the identifier at \c rank - Precondition: rank < Size()
+    InstanceIterator EndInstance(size_t rank) const { return m_rankedOffsets.data() + m_firstInstance[rank + 1]; }
+
+    /// The number of instances of the identifier at \c rank - Precondition: rank < Size()
+    size_t GetInstanceCount(size_t rank) const { return m_firstInstance[rank + 1] - m_firstInstance[rank]; }
+
+    /// The ranks of the identifiers that start with \c prefix
+    RangeType GetPrefixRange(NameType prefix) const;
+
+public: // Modifiers
+    /// Remove all identifiers (retaining the allocated storage)
+    void Clear();
+
+    /// Add an instance of \c name at \c offset - Precondition: \c name refers to the content
+    void Add(NameType name, size_t offset);
+
+    /// Rank the identifiers and group the instances by rank
+    void Index();
+
+protected: // Support methods
+    /// The position in m_slots of \c name or the empty slot where it belongs
+    size_t FindSlot(NameType name) const;
+
+    /// Double the size of m_slots
+    void Grow();
+};
+
+#endif // !defined(IDENTIFIER_TABLE_INCLUDED)
@@ -0,0 +1,155 @@
+#include "InputFile.h"
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+/// An empty file
+InputFile::InputFile()
+    : m_mapping(0)
+    , m_mappingSize(0)
+{}
+
+InputFile::~InputFile()
+{
+    Close();
+}
+
+/// Exchange the content of this with \c other
+    void
+InputFile::Swap(InputFile& other)
+{
+    std::swap(m_buffer, other.m_buffer);
+    std::swap(m_mapping, other.m_mapping);
+    std::swap(m_mappingSize, other.m_mappingSize);
+    std::swap(m_content, other.m_content);
+    // A short buffer is held within the string object, so its content moved
+    if (!m_mapping)
+        m_content = ContentType(m_buffer);
+    if (!other.m_mapping)
+        other.m_content = ContentType(other.m_buffer);
+}
+
+/// Make a copy of \c content available as though read from a file
+    void
+InputFile::Assign(ContentType content)
+{
+    Close();
+    m_buffer.assign(content.data(), content.size());
+    m_content = ContentType(m_buffer);
+}
+
+/// Make \c buffer the content without copying it, leaving \c buffer empty
+    void
+InputFile::Adopt(std::string& buffer)
+{
+    Close();
+    m_buffer.swap(buffer);
+    m_content = ContentType(m_buffer);
+}
+
+#if defined(_WIN32)
+/// Make the content of \c path available, mapping it into memory if \c allowMapping.
+/// Returns false if \c path cannot be opened.
+    bool
+InputFile::Open(const PathType& path, bool allowMapping)
+{
+    Close();
+    std::ifstream instream(path.c_str());
+    if (!instream.is_open())
+        return false;
+    for (;;)
+    {
+        size_t used = m_buffer.size();
+        m_buffer.resize(used + BlockSize);
+        instream.read(&m_buffer[used], BlockSize);
+        m_buffer.resize(used + size_t(instream.gcount()));
+        if (!instream)
+            break;
+    }
+    m_content = ContentType(m_buffer);
+    return true;
+}
+
+/// Release the content
+    void
+InputFile::Close()
+{
+    m_buffer.clear();
+    m_content = ContentType();
+}
+
+#else // !defined(_WIN32)
+/// Make the content of \c path available, mapping it into memory if \c allowMapping.
+/// Returns false if \c path cannot be opened.
+    bool
+InputFile::Open(const PathType& path, bool allowMapping)
+{
+    Close();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat status;
+    bool ok = 0 == fstat(fd, &status);
+    if (ok && !(allowMapping && S_ISREG(status.st_mode) && 0 < status.st_size && Map(fd, size_t(status.st_size))))
+        ok = Read(fd);
+    close(fd);
+    return ok;
+}
+
+/// Release the content
+    void
+InputFile::Close()
+{
+    if (m_mapping)
+        munmap(m_mapping, m_mappingSize);
+    m_mapping = 0;
+    m_mappingSize = 0;
+    m_buffer.clear();
+    m_content = ContentType();
+}
+
+/// Map \c size bytes of the open file \c fd into memory
+    bool
+InputFile::Map(int fd, size_t size)
+{
+    void* mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == mapping)
+        return false;
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    m_mapping = mapping;
+    m_mappingSize = size;
+    m_content = ContentType(static_cast<const char*>(m_mapping), m_mappingSize);
+    return true;
+}
+
+/// Read the remaining content of the open file \c fd into m_buffer
+    bool
+InputFile::Read(int fd)
+{
+    for (;;)
+    {
+        size_t used = m_buffer.size();
+        m_buffer.resize(used + BlockSize);
+        ssize_t count = read(fd, &m_buffer[used], BlockSize);
+        if (count < 0 && EINTR == errno)
+            count = 0;
+        else if (count <= 0)
+        {
+            m_buffer.resize(used);
+            if (count < 0)
+                return false;
+            break;
+        }
+        m_buffer.resize(used + size_t(count));
+    }
+    m_content = ContentType(m_buffer);
+    return true;
+}
+#endif // !defined(_WIN32)
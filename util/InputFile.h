@@ -0,0 +1,68 @@
+#if !defined(INPUT_FILE_INCLUDED)
+#define INPUT_FILE_INCLUDED
+#include <boost/filesystem.hpp>
+#include <string>
+#include <string_view>
+
+/// The read-only content of a file.
+///
+/// A regular file is mapped into memory when mapping is allowed and supported.
+/// Other files (pipes, special files) and files that cannot be mapped are read into a buffer.
+/// The content remains available until the next Open() or Close().
+class InputFile
+{
+public: // Types
+    typedef boost::filesystem::path PathType;
+    typedef std::string_view ContentType;
+
+private: // Attributes
+    std::string m_buffer; //!< The content when not mapped
+    void* m_mapping; //!< The start of the mapped content, or null
+    size_t m_mappingSize; //!< The number of bytes mapped
+    ContentType m_content; //!< The mapped or buffered content
+
+public: // ...structors
+    /// An empty file
+    InputFile();
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+    ~InputFile();
+
+public: // Accessors
+    /// The bytes in the file
+    const ContentType& GetContent() const { return m_content; }
+
+    /// Is the content mapped into memory?
+    bool IsMapped() const { return 0 != m_mapping; }
+
+public: // Modifiers
+    /// Make the content of \c path available, mapping it into memory if \c allowMapping.
+    /// Returns false if \c path cannot be opened.
+    bool Open(const PathType& path, bool allowMapping = true);
+
+    /// Release the content
+    void Close();
+
+    /// Exchange the content of this with \c other
+    void Swap(InputFile& other);
+
+    /// Make a copy of \c content available as though read from a file
+    void Assign(ContentType content);
+
+    /// Make \c buffer the content without copying it, leaving \c buffer empty
+    void Adopt(std::string& buffer);
+
+protected: // Support methods
+#if !defined(_WIN32)
+    /// Map \c size bytes of the open file \c fd into memory
+    bool Map(int fd, size_t size);
+
+    /// Read the remaining content of the open file \c fd into m_buffer
+    bool Read(int fd);
+#endif
+
+private: // Class data
+    static const size_t BlockSize = 64 * 1024; //!< The number of bytes requested by each read
+};
+
+#endif // !defined(INPUT_FILE_INCLUDED)
@@ -0,0 +1,48 @@
+#include "LineIndex.h"
+#include "TextSearch.h"
+#include <algorithm>
+
+/// No content
+LineIndex::LineIndex()
+    : m_contentSize(0)
+{
+}
+
+/// The (1-based) line holding content index \c index (zero if nothing is indexed).
+/// O(1) when \c index is on or just after the line in \c hint (which is updated), otherwise O(log n).
+    size_t
+LineIndex::GetLine(size_t index, size_t* hint) const
+{
+    size_t lineCount = m_lineStart.size();
+    size_t result = hint ? *hint : 0;
+    // Positions are mostly requested in ascending order
+    if (0 < result && result <= lineCount && m_lineStart[result - 1] <= index
+        && (lineCount == result || index < m_lineStart[result]))
+        ; // On the hinted line
+    else if (0 < result && result < lineCount && m_lineStart[result] <= index
+        && (lineCount == result + 1 || index < m_lineStart[result + 1]))
+        ++result;
+    else
+        result = std::upper_bound(m_lineStart.begin(), m_lineStart.end(), index) - m_lineStart.begin();
+    if (hint)
+        *hint = result;
+    return result;
+}
+
+/// Index the lines of [first, last)
+    void
+LineIndex::Assign(const char* first, const char* last)
+{
+    m_lineStart.clear();
+    m_lineStart.push_back(0);
+    TextSearch::FindLineStarts(first, last, m_lineStart);
+    m_contentSize = last - first;
+}
+
+/// Index nothing
+    void
+LineIndex::Clear()
+{
+    m_lineStart.clear();
+    m_contentSize = 0;
+}
@@ -0,0 +1,50 @@
+#if !defined(LINE_INDEX_INCLUDED)
+#define LINE_INDEX_INCLUDED
+#include <cstddef>
+#include <vector>
+
+/// The start of each line of some content, translating content indexes to and from (1-based) line and column numbers.
+///
+/// A line ends after its line feed, so the carriage return of a CRLF line break is the last column of its line.
+/// Content ending with a line feed has an empty last line. Content without a final line feed has no empty last line.
+class LineIndex
+{
+public: // Types
+    typedef std::vector<size_t> IndexStore;
+
+private: // Attributes
+    IndexStore m_lineStart; //!< The content index of the start of each line
+    size_t m_contentSize; //!< The number of characters indexed
+
+public: // ...structors
+    /// No content
+    LineIndex();
+
+public: // Accessors
+    /// The number of lines (zero if nothing is indexed)
+    size_t GetLineCount() const { return m_lineStart.size(); }
+
+    /// The number of characters indexed
+    size_t GetContentSize() const { return m_contentSize; }
+
+    /// The content index of the start of the (1-based) \c line or the content size if there is no such line
+    size_t GetLineStart(size_t line) const
+    { return 0 < line && line <= m_lineStart.size() ? m_lineStart[line - 1] : m_contentSize; }
+
+    /// The content index of the (1-based) \c line and \c column or the content size if there is no such line
+    size_t GetIndex(size_t line, size_t column) const
+    { return 0 < line && line <= m_lineStart.size() ? m_lineStart[line - 1] + column - 1 : m_contentSize; }
+
+    /// The (1-based) line holding content index \c index (zero if nothing is indexed).
+    /// O(1) when \c index is on or just after the line in \c hint (which is updated), otherwise O(log n).
+    size_t GetLine(size_t index, size_t* hint = 0) const;
+
+public: // Methods
+    /// Index the lines of [first, last)
+    void Assign(const char* first, const char* last);
+
+    /// Index nothing
+    void Clear();
+};
+
+#endif // !defined(LINE_INDEX_INCLUDED)
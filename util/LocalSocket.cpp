@@ -0,0 +1,249 @@
+#include "LocalSocket.h"
+#include <algorithm>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace
+{
+    const size_t ReceiveSize = 64 * 1024; //!< The number of bytes requested by each receive
+}
+
+/// A closed socket
+LocalSocket::LocalSocket()
+    : m_fd(-1)
+    , m_inputStart(0)
+{}
+
+LocalSocket::~LocalSocket()
+{
+    Close();
+}
+
+/// Put the bytes up to the next line break into \c line. Returns false at the end of the input.
+    bool
+LocalSocket::ReadLine(StringType& line)
+{
+    size_t searchStart = m_inputStart;
+    for (;;)
+    {
+        size_t eol = m_input.find('\n', searchStart);
+        if (StringType::npos != eol)
+        {
+            line.assign(m_input, m_inputStart, eol - m_inputStart);
+            m_inputStart = eol + 1;
+            return true;
+        }
+        searchStart = m_input.size() - m_inputStart;
+        if (!Receive())
+            return false;
+        searchStart += m_inputStart;
+    }
+}
+
+/// Put the next \c size bytes into \c data. Returns false if the input ends before then.
+    bool
+LocalSocket::ReadBlock(size_t size, StringType& data)
+{
+    while (m_input.size() - m_inputStart < size)
+    {
+        if (!Receive())
+            return false;
+    }
+    data.assign(m_input, m_inputStart, size);
+    m_inputStart += size;
+    return true;
+}
+
+#if defined(_WIN32)
+    bool
+LocalSocket::Listen(const PathType&)
+{
+    return false;
+}
+
+    bool
+LocalSocket::Accept(LocalSocket&)
+{
+    return false;
+}
+
+    bool
+LocalSocket::Connect(const PathType&)
+{
+    return false;
+}
+
+    bool
+LocalSocket::Flush()
+{
+    return false;
+}
+
+    bool
+LocalSocket::Shutdown()
+{
+    return false;
+}
+
+    void
+LocalSocket::Close()
+{
+}
+
+    bool
+LocalSocket::Receive()
+{
+    return false;
+}
+
+#else // !defined(_WIN32)
+namespace
+{
+    /// The address of the socket named \c path. Returns false if the name is too long.
+    bool SetAddress(const boost::filesystem::path& path, sockaddr_un& address)
+    {
+        std::memset(&address, 0, sizeof (address));
+        address.sun_family = AF_UNIX;
+        if (sizeof (address.sun_path) <= path.native().size())
+            return false;
+        std::memcpy(address.sun_path, path.c_str(), path.native().size());
+        return true;
+    }
+
+    /// A new socket that is not inherited by child processes, or -1
+    int NewSocket()
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (0 <= fd)
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        return fd;
+    }
+}
+
+/// Accept connections on \c path, replacing a stale socket. Returns false on failure.
+    bool
+LocalSocket::Listen(const PathType& path)
+{
+    Close();
+    sockaddr_un address;
+    if (!SetAddress(path, address))
+        return false;
+    LocalSocket probe;
+    if (probe.Connect(path)) // Another server is using it
+        return false;
+    unlink(path.c_str());
+    m_fd = NewSocket();
+    if (m_fd < 0)
+        return false;
+    if (0 != bind(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof (address)) || 0 != listen(m_fd, 16))
+    {
+        Close();
+        return false;
+    }
+    m_listenPath = path;
+    return true;
+}
+
+/// Put the next connection into \c connection. Returns false when interrupted or on failure.
+    bool
+LocalSocket::Accept(LocalSocket& connection)
+{
+    connection.Close();
+    connection.m_fd = accept(m_fd, 0, 0);
+    if (!connection.IsOpen())
+        return false;
+    fcntl(connection.m_fd, F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+/// Connect to the socket at \c path. Returns false on failure.
+    bool
+LocalSocket::Connect(const PathType& path)
+{
+    Close();
+    sockaddr_un address;
+    if (!SetAddress(path, address))
+        return false;
+    m_fd = NewSocket();
+    if (m_fd < 0)
+        return false;
+    if (0 != connect(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof (address)))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+/// Send the pending output. Returns false if the peer cannot receive it.
+    bool
+LocalSocket::Flush()
+{
+    size_t sent = 0;
+    while (sent < m_output.size())
+    {
+        ssize_t count = send(m_fd, m_output.data() + sent, m_output.size() - sent, MSG_NOSIGNAL);
+        if (count < 0 && EINTR == errno)
+            continue;
+        if (count <= 0)
+            return false;
+        sent += size_t(count);
+    }
+    m_output.clear();
+    return true;
+}
+
+/// Stop sending, so the peer sees the end of the input. Returns false on failure.
+    bool
+LocalSocket::Shutdown()
+{
+    return Flush() && 0 == shutdown(m_fd, SHUT_WR);
+}
+
+/// Release the socket, removing the name bound by Listen()
+    void
+LocalSocket::Close()
+{
+    if (0 <= m_fd)
+        close(m_fd);
+    m_fd = -1;
+    if (!m_listenPath.empty())
+        unlink(m_listenPath.c_str());
+    m_listenPath.clear();
+    m_input.clear();
+    m_inputStart = 0;
+    m_output.clear();
+}
+
+/// Receive more input. Returns false at the end of the input.
+    bool
+LocalSocket::Receive()
+{
+    if (m_fd < 0)
+        return false;
+    if (0 < m_inputStart) // Keep only the unread bytes
+    {
+        m_input.erase(0, m_inputStart);
+        m_inputStart = 0;
+    }
+    size_t used = m_input.size();
+    m_input.resize(used + ReceiveSize);
+    ssize_t count;
+    do
+        count = recv(m_fd, &m_input[used], ReceiveSize, 0);
+    while (count < 0 && EINTR == errno);
+    m_input.resize(used + std::max(count, ssize_t(0)));
+    return 0 < count;
+}
+#endif // !defined(_WIN32)
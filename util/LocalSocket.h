@@ -0,0 +1,69 @@
+#if !defined(LOCAL_SOCKET_INCLUDED)
+#define LOCAL_SOCKET_INCLUDED
+#include <boost/filesystem.hpp>
+#include <string>
+#include <string_view>
+
+/// A Unix domain stream socket that is either listening for connections or connected to a peer.
+///
+/// Received bytes are buffered so a peer's message can be read as text lines and blocks of known size.
+/// Sent bytes are buffered until Flush(). Sockets are not supported on Windows, where every operation fails.
+class LocalSocket
+{
+public: // Types
+    typedef boost::filesystem::path PathType;
+    typedef std::string StringType;
+    typedef std::string_view TextType;
+
+private: // Attributes
+    int m_fd; //!< The socket (or -1)
+    PathType m_listenPath; //!< The name bound by Listen() (or empty)
+    StringType m_input; //!< Bytes received but not yet read
+    size_t m_inputStart; //!< The position in m_input of the next byte to read
+    StringType m_output; //!< Bytes not yet sent
+
+public: // ...structors
+    /// A closed socket
+    LocalSocket();
+    LocalSocket(const LocalSocket&) = delete;
+    LocalSocket& operator=(const LocalSocket&) = delete;
+    ~LocalSocket();
+
+public: // Accessors
+    /// Is this listening or connected?
+    bool IsOpen() const { return 0 <= m_fd; }
+
+public: // Methods
+    /// Accept connections on \c path, replacing a stale socket. Returns false on failure.
+    bool Listen(const PathType& path);
+
+    /// Put the next connection into \c connection. Returns false when interrupted or on failure.
+    bool Accept(LocalSocket& connection);
+
+    /// Connect to the socket at \c path. Returns false on failure.
+    bool Connect(const PathType& path);
+
+    /// Put the bytes up to the next line break into \c line. Returns false at the end of the input.
+    bool ReadLine(StringType& line);
+
+    /// Put the next \c size bytes into \c data. Returns false if the input ends before then.
+    bool ReadBlock(size_t size, StringType& data);
+
+    /// Send \c data after the pending output
+    void Write(TextType data) { m_output.append(data.data(), data.size()); }
+
+    /// Send the pending output. Returns false if the peer cannot receive it.
+    bool Flush();
+
+    /// Stop sending, so the peer sees the end of the input. Returns false on failure.
+    bool Shutdown();
+
+    /// Release the socket, removing the name bound by Listen()
+    void Close();
+
+protected: // Support methods
+    /// Receive more input. Returns false at the end of the input.
+    bool Receive();
+};
+
+#endif // !defined(LOCAL_SOCKET_INCLUDED)
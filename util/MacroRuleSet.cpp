@@ -0,0 +1,165 @@
+#include "MacroRuleSet.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+const size_t MacroRuleSet::NoRule;
+
+namespace
+{
+    /// Can \c ch continue an identifier?
+    inline bool IsIdentifierPart(char ch)
+    {
+        unsigned char uch = static_cast<unsigned char>(ch);
+        return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') || ('0' <= ch && ch <= '9')
+            || '_' == ch || 0x80 <= uch;
+    }
+
+    /// Is \c text the start of an identifier?
+    bool IsIdentifierPrefix(const std::string& text)
+    {
+        if (text.empty() || ('0' <= text[0] && text[0] <= '9'))
+            return false;
+        for (char ch : text)
+            if (!IsIdentifierPart(ch))
+                return false;
+        return true;
+    }
+}
+
+/// The index of the macro family rule that selects \c name, or NoRule
+    size_t
+MacroRuleSet::FindRule(NameType name) const
+{
+    uint32_t index = m_matcher.FindLongestPrefix(name.data(), name.data() + name.size());
+    if (PatternMatcher::NoPattern == index || m_rules[index].isExclusion)
+        return NoRule;
+    return index;
+}
+
+/// A prefilter that rejects content without any selected identifiers
+    IdentifierPrefilter
+MacroRuleSet::GetPrefilter() const
+{
+    IdentifierPrefilter result;
+    for (auto& rule : m_rules)
+    {
+        if (rule.isExclusion)
+            result.AddExclusion(rule.prefix);
+        else
+            result.AddPrefix(rule.prefix);
+    }
+    return result;
+}
+
+/// A text that changes when the rules change
+    MacroRuleSet::StringType
+MacroRuleSet::GetSelectionKey() const
+{
+    StringType result;
+    for (auto& rule : m_rules)
+    {
+        if (!result.empty())
+            result += ' ';
+        result += (rule.isExclusion ? "exclude=" : "prefix=") + rule.prefix;
+        if (!rule.isExclusion && DefaultAction != rule.action)
+            result += StringType(":") + GetActionName(rule.action);
+    }
+    return result;
+}
+
+/// The name of \c action in a rule file
+    const char*
+MacroRuleSet::GetActionName(ActionType action)
+{
+    static const char* names[] = { "default", "terminate", "brace", "both" };
+    return names[action];
+}
+
+/// Select identifiers starting with \c prefix for \c action
+    void
+MacroRuleSet::AddFamily(const StringType& prefix, ActionType action)
+{
+    Add(RuleType{prefix, false, action});
+}
+
+/// Do not select identifiers starting with \c prefix
+    void
+MacroRuleSet::AddExclusion(const StringType& prefix)
+{
+    Add(RuleType{prefix, true, DefaultAction});
+}
+
+/// Add the rules in \c is, using \c sourceName in error messages
+    void
+MacroRuleSet::Load(std::istream& is, const StringType& sourceName)
+{
+    StringType line;
+    for (int lineNumber = 1; std::getline(is, line); ++lineNumber)
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        StringType keyword, prefix, actionName, extra;
+        if (!(fields >> keyword))
+            continue;
+        fields >> prefix >> actionName >> extra;
+        auto fail = [&sourceName, lineNumber](const StringType& message)
+        {
+            throw std::invalid_argument(sourceName + ":" + std::to_string(lineNumber) + ": " + message);
+        };
+        if ("macro" != keyword && "exclude" != keyword)
+            fail("expected macro or exclude, not " + keyword);
+        if (!IsIdentifierPrefix(prefix))
+            fail("expected an identifier prefix after " + keyword);
+        if (!extra.empty() || ("exclude" == keyword && !actionName.empty()))
+            fail("unexpected text after " + prefix);
+        if ("exclude" == keyword)
+        {
+            AddExclusion(prefix);
+            continue;
+        }
+        ActionType action = DefaultAction;
+        if ("terminate" == actionName)
+            action = Terminate;
+        else if ("brace" == actionName)
+            action = Brace;
+        else if ("both" == actionName)
+            action = Both;
+        else if (!actionName.empty())
+            fail("expected terminate, brace or both, not " + actionName);
+        AddFamily(prefix, action);
+    }
+}
+
+/// Add the rules in the file at \c path
+    void
+MacroRuleSet::LoadFile(const PathType& path)
+{
+    std::ifstream is(path.c_str());
+    if (!is.is_open())
+        throw std::invalid_argument(path.string() + ": cannot open the rule file");
+    Load(is, path.string());
+}
+
+/// Add \c rule, replacing a rule with the same prefix
+    void
+MacroRuleSet::Add(const RuleType& rule)
+{
+    if (!IsIdentifierPrefix(rule.prefix))
+        throw std::invalid_argument("not an identifier prefix: " + rule.prefix);
+    bool isReplaced = false;
+    for (auto& existing : m_rules)
+    {
+        if (existing.prefix == rule.prefix)
+        {
+            existing = rule;
+            isReplaced = true;
+        }
+    }
+    if (!isReplaced)
+        m_rules.push_back(rule);
+    PatternMatcher::StringStore prefixes;
+    for (auto& existing : m_rules)
+        prefixes.push_back(existing.prefix);
+    m_matcher = PatternMatcher(prefixes);
+}
@@ -0,0 +1,99 @@
+#if !defined(MACRO_RULE_SET_INCLUDED)
+#define MACRO_RULE_SET_INCLUDED
+#include "IdentifierPrefilter.h"
+#include "PatternMatcher.h"
+#include <boost/filesystem.hpp>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// The function call style macros of interest and the changes to make to them.
+///
+/// Each rule selects (or excludes) the identifiers starting with its prefix.
+/// An identifier is governed by the rule with the longest matching prefix,
+/// so an exclusion can remove part of a family and a family can be nested in an exclusion.
+/// All prefixes are compiled into one PatternMatcher, so classifying an identifier takes one pass over its name.
+///
+/// A rule file has one rule per line, with '#' starting a comment:
+///
+///     macro LOG4CXX_ both
+///     exclude LOG4CXX_STR
+///     macro MYCO_LOG_ terminate
+///     macro TRACE_SCOPE brace
+///
+/// where the optional action of a macro family is terminate (add a missing semicolon),
+/// brace (enclose a compound statement body in braces) or both.
+class MacroRuleSet
+{
+public: // Types
+    typedef boost::filesystem::path PathType;
+    typedef std::string StringType;
+    typedef std::string_view NameType;
+
+    /// The changes made to a function call without a statement terminator
+    enum ActionType
+    { DefaultAction = 0 //!< Decided by the program options
+    , Terminate     = 1 //!< Add a semicolon
+    , Brace         = 2 //!< Add braces when it is a compound statement body
+    , Both          = Terminate | Brace
+    };
+
+    struct RuleType
+    {
+        StringType prefix;
+        bool       isExclusion;
+        ActionType action;
+    };
+    typedef std::vector<RuleType> RuleStore;
+    static const size_t NoRule = size_t(-1);
+
+private: // Attributes
+    RuleStore m_rules;
+    PatternMatcher m_matcher; //!< The rule prefixes
+
+public: // ...structors
+    /// No rules
+    MacroRuleSet() {}
+
+public: // Accessors
+    /// Are there no rules?
+    bool IsEmpty() const { return m_rules.empty(); }
+
+    /// The number of rules
+    size_t Size() const { return m_rules.size(); }
+
+    /// The rule at \c index - Precondition: index < Size()
+    const RuleType& GetRule(size_t index) const { return m_rules[index]; }
+
+    /// The index of the macro family rule that selects \c name, or NoRule
+    size_t FindRule(NameType name) const;
+
+    /// A prefilter that rejects content without any selected identifiers
+    IdentifierPrefilter GetPrefilter() const;
+
+    /// A text that changes when the rules change
+    StringType GetSelectionKey() const;
+
+    /// The name of \c action in a rule file
+    static const char* GetActionName(ActionType action);
+
+public: // Modifiers
+    /// Select identifiers starting with \c prefix for \c action
+    void AddFamily(const StringType& prefix, ActionType action = DefaultAction);
+
+    /// Do not select identifiers starting with \c prefix
+    void AddExclusion(const StringType& prefix);
+
+    /// Add the rules in \c is, using \c sourceName in error messages
+    void Load(std::istream& is, const StringType& sourceName);
+
+    /// Add the rules in the file at \c path
+    void LoadFile(const PathType& path);
+
+protected: // Support methods
+    /// Add \c rule, replacing a rule with the same prefix
+    void Add(const RuleType& rule);
+};
+
+#endif // !defined(MACRO_RULE_SET_INCLUDED)
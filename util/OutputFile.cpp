@@ -0,0 +1,264 @@
+#include "OutputFile.h"
+#include "InputFile.h"
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#endif
+
+namespace
+{
+    /// A name in the directory of \c target that is unlikely to be in use
+    OutputFile::PathType GetTemporaryPath(const OutputFile::PathType& target)
+    {
+        static std::atomic<unsigned> sequence(0);
+        std::string name = "." + target.filename().string()
+            + ".tmp" + std::to_string(getpid())
+            + "." + std::to_string(++sequence);
+        return target.parent_path() / name;
+    }
+
+#if !defined(_WIN32)
+    /// Make the entries of \c dir durable, so a rename into it survives a crash.
+    /// Failure is ignored, as not all file systems support it.
+    void SyncDirectory(const OutputFile::PathType& dir)
+    {
+        int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+        (void)fsync(fd);
+        close(fd);
+    }
+
+    /// Put \c spans into the open file \c fd using as few system calls as possible
+    bool WriteSpans(int fd, const OutputFile::SpanStore& spans)
+    {
+#if defined(IOV_MAX)
+        static const size_t MaxBatch = IOV_MAX;
+#else
+        static const size_t MaxBatch = 1024;
+#endif
+        std::vector<iovec> batch;
+        batch.reserve(std::min(spans.size(), MaxBatch));
+        for (size_t first = 0; first < spans.size(); first += MaxBatch)
+        {
+            batch.clear();
+            for (size_t i = first; i < spans.size() && batch.size() < MaxBatch; ++i)
+                batch.push_back(iovec{const_cast<char*>(spans[i].data()), spans[i].size()});
+            iovec* pending = batch.data();
+            int pendingCount = int(batch.size());
+            while (0 < pendingCount)
+            {
+                ssize_t count = writev(fd, pending, pendingCount);
+                if (count < 0)
+                {
+                    if (EINTR == errno)
+                        continue;
+                    return false;
+                }
+                // Skip the fully written spans and adjust the partially written one
+                while (0 < pendingCount && size_t(count) >= pending->iov_len)
+                {
+                    count -= ssize_t(pending->iov_len);
+                    ++pending;
+                    --pendingCount;
+                }
+                if (0 < pendingCount)
+                {
+                    pending->iov_base = static_cast<char*>(pending->iov_base) + count;
+                    pending->iov_len -= size_t(count);
+                }
+            }
+        }
+        return true;
+    }
+#endif
+}
+
+/// Is the concatenation of \c spans the same as \c content?
+    bool
+OutputFile::IsSameContent(const SpanStore& spans, SpanType content)
+{
+    size_t offset = 0;
+    for (auto& span : spans)
+    {
+        if (content.size() - offset < span.size() || 0 != content.compare(offset, span.size(), span))
+            return false;
+        offset += span.size();
+    }
+    return offset == content.size();
+}
+
+/// Make the file content the concatenation of \c spans unless it already is.
+/// Provide \c current when the present content is already loaded.
+/// Returns false if the file could not be written.
+    bool
+OutputFile::Store(const SpanStore& spans, const SpanType* current)
+{
+    m_isChanged = false;
+    PathType target = GetTarget();
+    if (target.empty())
+        return false;
+    boost::system::error_code ec;
+    if (current)
+    {
+        if (IsSameContent(spans, *current))
+            return true;
+    }
+    else if (boost::filesystem::exists(target, ec))
+    {
+        InputFile existing;
+        if (existing.Open(target) && IsSameContent(spans, existing.GetContent()))
+            return true;
+    }
+    return Replace(target, spans);
+}
+
+/// Start writing new content progressively. Returns false if the new file could not be created.
+    bool
+OutputFile::Begin()
+{
+    m_isChanged = false;
+    PathType target = GetTarget();
+    return !target.empty() && Create(target);
+}
+
+/// The file to replace: the target of \c m_path when it is a symbolic link. Empty on error.
+    OutputFile::PathType
+OutputFile::GetTarget() const
+{
+    boost::system::error_code ec;
+    if (!boost::filesystem::is_symlink(m_path, ec)) // Replace the file, not the link
+        return m_path;
+    PathType result = boost::filesystem::canonical(m_path, ec);
+    return ec ? PathType() : result;
+}
+
+/// Write \c spans to a new file that replaces \c target
+    bool
+OutputFile::Replace(const PathType& target, const SpanStore& spans)
+{
+    bool ok = Create(target) && Write(spans);
+    return End(ok) && ok;
+}
+
+#if defined(_WIN32)
+/// Start writing a new file that will replace \c target
+    bool
+OutputFile::Create(const PathType& target)
+{
+    End(false);
+    m_temporary = GetTemporaryPath(target);
+    m_stream.open(m_temporary.c_str());
+    if (!m_stream.is_open())
+    {
+        m_temporary.clear();
+        return false;
+    }
+    m_target = target;
+    return true;
+}
+
+/// Append \c spans to the content started by Begin(). Returns false if they could not be written.
+    bool
+OutputFile::Write(const SpanStore& spans)
+{
+    if (!m_stream.is_open())
+        return false;
+    for (auto& span : spans)
+        m_stream.write(span.data(), span.size());
+    return !m_stream.bad();
+}
+
+/// Replace the file with the content written since Begin() when \c keep, otherwise discard it.
+/// Returns false if the file could not be replaced.
+    bool
+OutputFile::End(bool keep)
+{
+    if (!m_stream.is_open())
+        return !keep;
+    m_stream.close();
+    bool ok = keep && !m_stream.bad();
+    boost::system::error_code ec;
+    if (ok)
+        boost::filesystem::rename(m_temporary, m_target, ec);
+    ok = ok && !ec;
+    if (!ok)
+        boost::filesystem::remove(m_temporary, ec);
+    m_stream.clear();
+    m_temporary.clear();
+    m_target.clear();
+    m_isChanged = ok;
+    return ok || !keep;
+}
+
+#else // !defined(_WIN32)
+/// Start writing a new file that will replace \c target
+    bool
+OutputFile::Create(const PathType& target)
+{
+    End(false);
+    for (int attempt = 0; m_fd < 0 && attempt < 100; ++attempt)
+    {
+        m_temporary = GetTemporaryPath(target);
+        m_fd = open(m_temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (m_fd < 0 && EEXIST != errno)
+            break;
+    }
+    if (m_fd < 0)
+    {
+        m_temporary.clear();
+        return false;
+    }
+    m_target = target;
+    return true;
+}
+
+/// Append \c spans to the content started by Begin(). Returns false if they could not be written.
+    bool
+OutputFile::Write(const SpanStore& spans)
+{
+    return 0 <= m_fd && WriteSpans(m_fd, spans);
+}
+
+/// Replace the file with the content written since Begin() when \c keep, otherwise discard it.
+/// Returns false if the file could not be replaced.
+    bool
+OutputFile::End(bool keep)
+{
+    if (m_fd < 0)
+        return !keep;
+    bool ok = keep;
+    struct stat status;
+    if (ok && 0 == stat(m_target.c_str(), &status))
+    {
+        if (0 != fchown(m_fd, status.st_uid, status.st_gid)) // Keep the group at least
+            (void)(0 != fchown(m_fd, uid_t(-1), status.st_gid));
+        ok = 0 == fchmod(m_fd, status.st_mode & 07777);
+    }
+    // The content must be on disk before the rename is, or a crash could leave an empty file
+    ok = ok && 0 == fsync(m_fd);
+    ok = 0 == close(m_fd) && ok;
+    m_fd = -1;
+    if (ok)
+        ok = 0 == rename(m_temporary.c_str(), m_target.c_str());
+    if (ok)
+        SyncDirectory(m_target.parent_path());
+    else
+        unlink(m_temporary.c_str());
+    m_temporary.clear();
+    m_target.clear();
+    m_isChanged = ok;
+    return ok || !keep;
+}
+#endif // !defined(_WIN32)
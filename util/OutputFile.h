@@ -0,0 +1,83 @@
+#if !defined(OUTPUT_FILE_INCLUDED)
+#define OUTPUT_FILE_INCLUDED
+#include <boost/filesystem.hpp>
+#include <string_view>
+#include <vector>
+#if defined(_WIN32)
+#include <fstream>
+#endif
+
+/// A file whose content is replaced by a sequence of text spans.
+///
+/// The spans are written (without copying) to a new file in the same directory,
+/// which is given the permissions of the original, flushed to disk and then renamed over it,
+/// so an interrupted store (or a crash) never leaves a partially written file.
+/// Nothing is written when the file already holds the same bytes, so its modification time is retained.
+/// Content too large to hold in memory can instead be written progressively using Begin(), Write() and End().
+class OutputFile
+{
+public: // Types
+    typedef boost::filesystem::path PathType;
+    typedef std::string_view SpanType;
+    typedef std::vector<SpanType> SpanStore;
+
+private: // Attributes
+    PathType m_path; //!< The file to be replaced
+    bool m_isChanged; //!< Did the last Store() replace the file?
+    PathType m_target; //!< The file being replaced progressively (or empty)
+    PathType m_temporary; //!< The new content of m_target (or empty)
+#if defined(_WIN32)
+    std::ofstream m_stream; //!< Writes m_temporary
+#else
+    int m_fd; //!< Writes m_temporary (or -1)
+#endif
+
+public: // ...structors
+    /// An output to \c path
+    OutputFile(const PathType& path)
+        : m_path(path)
+        , m_isChanged(false)
+#if !defined(_WIN32)
+        , m_fd(-1)
+#endif
+    {}
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+    /// Discard any unfinished progressive output
+    ~OutputFile() { End(false); }
+
+public: // Accessors
+    /// Did the last Store() write the file?
+    bool IsChanged() const { return m_isChanged; }
+
+    /// Is the concatenation of \c spans the same as \c content?
+    static bool IsSameContent(const SpanStore& spans, SpanType content);
+
+public: // Methods
+    /// Make the file content the concatenation of \c spans unless it already is.
+    /// Provide \c current when the present content is already loaded.
+    /// Returns false if the file could not be written.
+    bool Store(const SpanStore& spans, const SpanType* current = 0);
+
+    /// Start writing new content progressively. Returns false if the new file could not be created.
+    bool Begin();
+
+    /// Append \c spans to the content started by Begin(). Returns false if they could not be written.
+    bool Write(const SpanStore& spans);
+
+    /// Replace the file with the content written since Begin() when \c keep, otherwise discard it.
+    /// Returns false if the file could not be replaced.
+    bool End(bool keep);
+
+protected: // Support methods
+    /// The file to replace: the target of \c m_path when it is a symbolic link. Empty on error.
+    PathType GetTarget() const;
+
+    /// Start writing a new file that will replace \c target
+    bool Create(const PathType& target);
+
+    /// Write \c spans to a new file that replaces \c target
+    bool Replace(const PathType& target, const SpanStore& spans);
+};
+
+#endif // !defined(OUTPUT_FILE_INCLUDED)
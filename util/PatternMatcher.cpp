@@ -0,0 +1,103 @@
+#include "PatternMatcher.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+const uint32_t PatternMatcher::NoPattern;
+
+/// A matcher of \c patterns (ignoring empty and repeated patterns)
+PatternMatcher::PatternMatcher(const StringStore& patterns)
+    : m_classCount(1)
+{
+    std::memset(m_classOfByte, 0, sizeof (m_classOfByte));
+    for (auto& pattern : patterns)
+    {
+        if (pattern.empty() || m_patterns.end() != std::find(m_patterns.begin(), m_patterns.end(), pattern))
+            continue;
+        m_patterns.push_back(pattern);
+        for (char ch : pattern)
+        {
+            uint8_t& column = m_classOfByte[static_cast<unsigned char>(ch)];
+            if (0 == column)
+                column = uint8_t(m_classCount++);
+        }
+    }
+    // The root state
+    m_next.resize(m_classCount, 0);
+    m_depth.push_back(0);
+    m_pattern.push_back(NoPattern);
+    m_outputLink.push_back(0);
+    for (size_t index = 0; index < m_patterns.size(); ++index)
+        AddPattern(index);
+    AddFailureTransitions();
+}
+
+/// The index of the longest pattern that starts [first, last), or NoPattern
+    uint32_t
+PatternMatcher::FindLongestPrefix(const char* first, const char* last) const
+{
+    uint32_t result = NoPattern;
+    uint32_t state = 0;
+    for (const char* p = first; p != last; ++p)
+    {
+        uint32_t next = m_next[state * m_classCount + m_classOfByte[static_cast<unsigned char>(*p)]];
+        if (m_depth[next] != m_depth[state] + 1) // Not an extension of [first, p)
+            break;
+        state = next;
+        if (NoPattern != m_pattern[state])
+            result = m_pattern[state];
+    }
+    return result;
+}
+
+/// Add the states for the pattern at \c index
+    void
+PatternMatcher::AddPattern(size_t index)
+{
+    uint32_t state = 0;
+    for (char ch : m_patterns[index])
+    {
+        size_t transition = state * m_classCount + m_classOfByte[static_cast<unsigned char>(ch)];
+        if (0 == m_next[transition]) // The root is never a child
+        {
+            uint32_t child = uint32_t(m_depth.size());
+            m_next[transition] = child;
+            m_next.resize(m_next.size() + m_classCount, 0);
+            m_depth.push_back(m_depth[state] + 1);
+            m_pattern.push_back(NoPattern);
+            m_outputLink.push_back(0);
+        }
+        state = m_next[transition];
+    }
+    m_pattern[state] = uint32_t(index);
+}
+
+/// Replace the missing transitions with those of the failure states
+    void
+PatternMatcher::AddFailureTransitions()
+{
+    NumberStore failure(m_depth.size(), 0);
+    std::deque<uint32_t> pending; // States in breadth first order
+    for (size_t column = 0; column < m_classCount; ++column)
+        if (uint32_t child = m_next[column])
+            pending.push_back(child);
+    while (!pending.empty())
+    {
+        uint32_t state = pending.front();
+        pending.pop_front();
+        uint32_t fallback = failure[state];
+        m_outputLink[state] = NoPattern != m_pattern[fallback] ? fallback : m_outputLink[fallback];
+        for (size_t column = 0; column < m_classCount; ++column)
+        {
+            uint32_t& next = m_next[state * m_classCount + column];
+            uint32_t fallbackNext = m_next[fallback * m_classCount + column];
+            if (0 == next)
+                next = fallbackNext;
+            else // A child, whose failure state is reached from this state's failure state
+            {
+                failure[next] = fallbackNext;
+                pending.push_back(next);
+            }
+        }
+    }
+}
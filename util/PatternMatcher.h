@@ -0,0 +1,78 @@
+#if !defined(PATTERN_MATCHER_INCLUDED)
+#define PATTERN_MATCHER_INCLUDED
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Finds the occurrences of any number of patterns in one pass over a text (an Aho-Corasick automaton).
+///
+/// The failure links are resolved when the patterns are set, so each state has a transition for every byte.
+/// Bytes that are not in any pattern share one column of the transition table,
+/// which keeps the table small enough to stay in cache for hundreds of patterns.
+class PatternMatcher
+{
+public: // Types
+    typedef std::string StringType;
+    typedef std::vector<StringType> StringStore;
+    static const uint32_t NoPattern = UINT32_MAX;
+
+protected: // Types
+    typedef std::vector<uint32_t> NumberStore;
+
+private: // Attributes
+    StringStore m_patterns;
+    uint8_t m_classOfByte[256]; //!< The transition table column of each byte
+    size_t m_classCount; //!< The number of transition table columns
+    NumberStore m_next; //!< The state after each (state, class) pair
+    NumberStore m_depth; //!< The length of the text each state represents
+    NumberStore m_pattern; //!< The position in m_patterns of the text of each state (or NoPattern)
+    NumberStore m_outputLink; //!< The longest proper suffix state of each state that is a pattern (or 0)
+
+public: // ...structors
+    /// A matcher of \c patterns (ignoring empty and repeated patterns)
+    PatternMatcher(const StringStore& patterns = StringStore());
+
+public: // Accessors
+    /// Are there no patterns?
+    bool IsEmpty() const { return m_patterns.empty(); }
+
+    /// The number of patterns
+    size_t Size() const { return m_patterns.size(); }
+
+    /// The pattern at \c index - Precondition: index < Size()
+    const StringType& GetPattern(size_t index) const { return m_patterns[index]; }
+
+    /// The index of the longest pattern that starts [first, last), or NoPattern
+    uint32_t FindLongestPrefix(const char* first, const char* last) const;
+
+    /// Call \c visit(start, index) for each occurrence in [first, last) of the pattern at \c index,
+    /// in order of the occurrence end, until \c visit returns true. Returns true if \c visit stopped the search.
+    template <class Visitor>
+    bool FindEach(const char* first, const char* last, Visitor visit) const
+    {
+        if (m_patterns.empty())
+            return false;
+        uint32_t state = 0;
+        for (const char* p = first; p != last; ++p)
+        {
+            state = m_next[state * m_classCount + m_classOfByte[static_cast<unsigned char>(*p)]];
+            for (uint32_t output = NoPattern == m_pattern[state] ? m_outputLink[state] : state
+                ; 0 != output
+                ; output = m_outputLink[output])
+            {
+                if (visit(p + 1 - m_depth[output], m_pattern[output]))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+protected: // Support methods
+    /// Add the states for the pattern at \c index
+    void AddPattern(size_t index);
+
+    /// Replace the missing transitions with those of the failure states
+    void AddFailureTransitions();
+};
+
+#endif // !defined(PATTERN_MATCHER_INCLUDED)
@@ -0,0 +1,227 @@
+#include "PhaseStats.h"
+#include <cstdio>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+#if defined(__linux__)
+namespace
+{
+    /// Open a counter of the hardware \c event for the calling thread in the group led by \c groupFd
+    int OpenCounter(uint64_t event, int groupFd)
+    {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof (attr));
+        attr.size = sizeof (attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = event;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return int(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+    }
+}
+
+/// Counters of the calling thread, if \c isRequested
+HardwareCounters::HardwareCounters(bool isRequested)
+    : m_groupFd(-1)
+    , m_cacheMissFd(-1)
+{
+    if (isRequested)
+        m_groupFd = OpenCounter(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (0 <= m_groupFd)
+        m_cacheMissFd = OpenCounter(PERF_COUNT_HW_CACHE_MISSES, m_groupFd);
+}
+
+HardwareCounters::~HardwareCounters()
+{
+    if (0 <= m_cacheMissFd)
+        close(m_cacheMissFd);
+    if (0 <= m_groupFd)
+        close(m_groupFd);
+}
+
+/// Put the current counts into \c cycles and \c cacheMisses. Returns false if they are not available.
+    bool
+HardwareCounters::Read(uint64_t& cycles, uint64_t& cacheMisses) const
+{
+    struct { uint64_t count; uint64_t values[2]; } data = { 0, { 0, 0 } };
+    if (m_groupFd < 0 || read(m_groupFd, &data, sizeof (data)) <= 0 || data.count < 1)
+        return false;
+    cycles = data.values[0];
+    cacheMisses = 1 < data.count ? data.values[1] : 0;
+    return true;
+}
+
+#else // !defined(__linux__)
+/// Counters of the calling thread, if \c isRequested
+HardwareCounters::HardwareCounters(bool /*isRequested*/)
+    : m_groupFd(-1)
+    , m_cacheMissFd(-1)
+{}
+
+HardwareCounters::~HardwareCounters()
+{}
+
+/// Put the current counts into \c cycles and \c cacheMisses. Returns false if they are not available.
+    bool
+HardwareCounters::Read(uint64_t& /*cycles*/, uint64_t& /*cacheMisses*/) const
+{
+    return false;
+}
+#endif // !defined(__linux__)
+
+/// No time in any phase, recording hardware events from \c counters (when not null)
+PhaseStats::PhaseStats(const HardwareCounters* counters)
+    : m_counters(counters)
+{
+    Clear();
+}
+
+/// The seconds spent in all phases
+    double
+PhaseStats::GetTotalSeconds() const
+{
+    double result = 0;
+    for (auto& measure : m_phases)
+        result += measure.seconds;
+    return result;
+}
+
+/// Include \c measure in \c phase
+    void
+PhaseStats::AddPhase(PhaseType phase, const MeasureType& measure)
+{
+    m_phases[phase].seconds += measure.seconds;
+    m_phases[phase].cycles += measure.cycles;
+    m_phases[phase].cacheMisses += measure.cacheMisses;
+}
+
+/// Include all of \c other in this
+    void
+PhaseStats::Add(const PhaseStats& other)
+{
+    for (int phase = 0; phase < PhaseCount; ++phase)
+        AddPhase(PhaseType(phase), other.m_phases[phase]);
+    for (int type = 0; type < CountTypeCount; ++type)
+        m_counts[type] += other.m_counts[type];
+    for (int type = 0; type < PeakTypeCount; ++type)
+        AddPeak(PeakType(type), other.m_peaks[type]);
+    m_hasEvents = m_hasEvents || other.m_hasEvents;
+}
+
+/// Remove all phases and counts
+    void
+PhaseStats::Clear()
+{
+    for (auto& measure : m_phases)
+        measure = MeasureType{0, 0, 0};
+    for (auto& count : m_counts)
+        count = 0;
+    for (auto& count : m_peaks)
+        count = 0;
+    m_hasEvents = false;
+}
+
+/// The JSON name of \c phase
+    const char*
+PhaseStats::GetPhaseName(PhaseType phase)
+{
+    static const char* names[PhaseCount] = { "walk", "read", "prefilter", "lex", "index", "analyse", "write" };
+    return names[phase];
+}
+
+/// The JSON name of \c type
+    const char*
+PhaseStats::GetCountName(CountType type)
+{
+    static const char* names[CountTypeCount] = { "bytes", "tokens", "identifiers", "macros", "fixes" };
+    return names[type];
+}
+
+/// The JSON name of \c type
+    const char*
+PhaseStats::GetPeakName(PeakType type)
+{
+    static const char* names[PeakTypeCount] = { "arena_bytes", "arena_capacity" };
+    return names[type];
+}
+
+/// Put the phases, counts and peaks as JSON object members onto \c os
+    void
+PhaseStats::WriteJson(std::ostream& os) const
+{
+    os << "\"seconds\": " << GetTotalSeconds() << ", \"phases\": {";
+    for (int phase = 0; phase < PhaseCount; ++phase)
+    {
+        const MeasureType& measure = m_phases[phase];
+        os << (0 < phase ? ", " : "") << '"' << GetPhaseName(PhaseType(phase)) << "\": {\"seconds\": " << measure.seconds;
+        if (m_hasEvents)
+            os << ", \"cycles\": " << measure.cycles << ", \"cache_misses\": " << measure.cacheMisses;
+        os << "}";
+    }
+    os << "}, \"counts\": {";
+    for (int type = 0; type < CountTypeCount; ++type)
+        os << (0 < type ? ", " : "") << '"' << GetCountName(CountType(type)) << "\": " << m_counts[type];
+    os << "}, \"peaks\": {";
+    for (int type = 0; type < PeakTypeCount; ++type)
+        os << (0 < type ? ", " : "") << '"' << GetPeakName(PeakType(type)) << "\": " << m_peaks[type];
+    os << "}";
+}
+
+/// Put \c text as a JSON string onto \c os
+    void
+PhaseStats::WriteJsonString(std::ostream& os, const std::string& text)
+{
+    os << '"';
+    for (char ch : text)
+    {
+        if ('"' == ch || '\\' == ch)
+            os << '\\' << ch;
+        else if (0 <= ch && ch < 0x20)
+        {
+            char escape[8];
+            std::snprintf(escape, sizeof (escape), "\\u%04x", unsigned(ch));
+            os << escape;
+        }
+        else
+            os << ch;
+    }
+    os << '"';
+}
+
+/// Start measuring \c phase for \c stats (when not null)
+PhaseStats::Timer::Timer(PhaseStats* stats, PhaseType phase)
+    : m_stats(stats)
+    , m_phase(phase)
+    , m_startCycles(0)
+    , m_startCacheMisses(0)
+{
+    if (!m_stats)
+        return;
+    if (m_stats->m_counters)
+        m_stats->m_counters->Read(m_startCycles, m_startCacheMisses);
+    m_start = ClockType::now();
+}
+
+/// Add the resources used since construction to the phase
+    void
+PhaseStats::Timer::Stop()
+{
+    if (!m_stats)
+        return;
+    MeasureType measure{std::chrono::duration<double>(ClockType::now() - m_start).count(), 0, 0};
+    uint64_t cycles, cacheMisses;
+    if (m_stats->m_counters && m_stats->m_counters->Read(cycles, cacheMisses))
+    {
+        measure.cycles = cycles - m_startCycles;
+        measure.cacheMisses = cacheMisses - m_startCacheMisses;
+        m_stats->m_hasEvents = true;
+    }
+    m_stats->AddPhase(m_phase, measure);
+    m_stats = 0;
+}
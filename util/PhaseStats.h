@@ -0,0 +1,141 @@
+#if !defined(PHASE_STATS_INCLUDED)
+#define PHASE_STATS_INCLUDED
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/// Hardware event counts (CPU cycles and cache misses) of the thread that constructed this.
+///
+/// The counts are unavailable when not requested, on systems without perf_event_open
+/// or where the kernel does not allow user processes to access the counters.
+class HardwareCounters
+{
+private: // Attributes
+    int m_groupFd; //!< The cycle counter, which leads the group (or -1)
+    int m_cacheMissFd; //!< The cache miss counter (or -1)
+
+public: // ...structors
+    /// Counters of the calling thread, if \c isRequested
+    HardwareCounters(bool isRequested = true);
+    HardwareCounters(const HardwareCounters&) = delete;
+    HardwareCounters& operator=(const HardwareCounters&) = delete;
+    ~HardwareCounters();
+
+public: // Accessors
+    /// Can the counters be read?
+    bool IsAvailable() const { return 0 <= m_groupFd; }
+
+    /// Put the current counts into \c cycles and \c cacheMisses. Returns false if they are not available.
+    bool Read(uint64_t& cycles, uint64_t& cacheMisses) const;
+};
+
+/// The time (and hardware events) spent in each phase of processing, with the quantities processed
+class PhaseStats
+{
+public: // Types
+    class Timer;
+    enum PhaseType { Walk, Read, Prefilter, Lex, Index, Analyse, Write, PhaseCount };
+    enum CountType { Bytes, Tokens, Identifiers, Macros, Fixes, CountTypeCount };
+    enum PeakType { ArenaBytes, ArenaCapacity, PeakTypeCount }; //!< Quantities combined by taking the largest
+
+    /// The resources used by a phase
+    struct MeasureType
+    {
+        double   seconds;
+        uint64_t cycles;
+        uint64_t cacheMisses;
+    };
+
+private: // Attributes
+    const HardwareCounters* m_counters; //!< Of the thread recording phases (or null)
+    MeasureType m_phases[PhaseCount];
+    uint64_t m_counts[CountTypeCount];
+    uint64_t m_peaks[PeakTypeCount];
+    bool m_hasEvents; //!< Were hardware events recorded?
+
+public: // ...structors
+    /// No time in any phase, recording hardware events from \c counters (when not null)
+    PhaseStats(const HardwareCounters* counters = 0);
+
+public: // Accessors
+    /// The resources used by \c phase
+    const MeasureType& GetPhase(PhaseType phase) const { return m_phases[phase]; }
+
+    /// The quantity of \c type processed
+    uint64_t GetCount(CountType type) const { return m_counts[type]; }
+
+    /// The largest quantity of \c type used
+    uint64_t GetPeak(PeakType type) const { return m_peaks[type]; }
+
+    /// The seconds spent in all phases
+    double GetTotalSeconds() const;
+
+    /// The source of hardware event counts (or null)
+    const HardwareCounters* GetCounters() const { return m_counters; }
+
+    /// Were hardware events recorded?
+    bool HasEvents() const { return m_hasEvents; }
+
+    /// Put the phases, counts and peaks as JSON object members onto \c os
+    void WriteJson(std::ostream& os) const;
+
+    /// The JSON name of \c phase
+    static const char* GetPhaseName(PhaseType phase);
+
+    /// The JSON name of \c type
+    static const char* GetCountName(CountType type);
+
+    /// The JSON name of \c type
+    static const char* GetPeakName(PeakType type);
+
+    /// Put \c text as a JSON string onto \c os
+    static void WriteJsonString(std::ostream& os, const std::string& text);
+
+public: // Modifiers
+    /// Record hardware events from \c counters (when not null)
+    void SetCounters(const HardwareCounters* counters) { m_counters = counters; }
+
+    /// Include \c measure in \c phase
+    void AddPhase(PhaseType phase, const MeasureType& measure);
+
+    /// Include \c count in the quantity of \c type
+    void AddCount(CountType type, uint64_t count) { m_counts[type] += count; }
+
+    /// Include \c count in the largest quantity of \c type
+    void AddPeak(PeakType type, uint64_t count) { m_peaks[type] = std::max(m_peaks[type], count); }
+
+    /// Include all of \c other in this
+    void Add(const PhaseStats& other);
+
+    /// Remove all phases and counts
+    void Clear();
+};
+
+/// Adds the resources used from construction to destruction to a phase (unless no PhaseStats is provided)
+class PhaseStats::Timer
+{
+public: // Types
+    typedef std::chrono::steady_clock ClockType;
+
+private: // Attributes
+    PhaseStats* m_stats; //!< Where the measure is added (or null)
+    PhaseType m_phase;
+    ClockType::time_point m_start;
+    uint64_t m_startCycles;
+    uint64_t m_startCacheMisses;
+
+public: // ...structors
+    /// Start measuring \c phase for \c stats (when not null)
+    Timer(PhaseStats* stats, PhaseType phase);
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+    ~Timer() { Stop(); }
+
+public: // Methods
+    /// Add the resources used since construction to the phase
+    void Stop();
+};
+
+#endif // !defined(PHASE_STATS_INCLUDED)
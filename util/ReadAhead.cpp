@@ -0,0 +1,414 @@
+#include "ReadAhead.h"
+#include <log4cxx/logger.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// io_uring is used when the kernel headers (5.1 or later) declare it
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define READ_AHEAD_IO_URING
+#endif
+#endif
+#endif
+
+    static log4cxx::LoggerPtr
+log_s(log4cxx::Logger::getLogger("ReadAhead"));
+
+#if defined(READ_AHEAD_IO_URING)
+/// The submission and completion queues shared with the kernel by an io_uring instance
+class ReadAhead::Ring
+{
+private: // Attributes
+    int m_fd; //!< The io_uring instance (or -1)
+    void* m_sqRing; //!< The mapped submission queue (or null)
+    size_t m_sqRingSize;
+    void* m_cqRing; //!< The mapped completion queue (or null)
+    size_t m_cqRingSize;
+    io_uring_sqe* m_sqes; //!< The mapped submission queue entries (or null)
+    size_t m_sqesSize;
+    unsigned* m_sqHead; //!< Advanced by the kernel as entries are consumed
+    unsigned* m_sqTail; //!< Advanced by Read()
+    unsigned* m_sqArray; //!< The entry index at each submission queue position
+    unsigned m_sqMask;
+    unsigned* m_cqHead; //!< Advanced by Reap()
+    unsigned* m_cqTail; //!< Advanced by the kernel as reads complete
+    io_uring_cqe* m_cqes;
+    unsigned m_cqMask;
+
+public: // ...structors
+    Ring()
+        : m_fd(-1)
+        , m_sqRing(0)
+        , m_sqRingSize(0)
+        , m_cqRing(0)
+        , m_cqRingSize(0)
+        , m_sqes(0)
+        , m_sqesSize(0)
+    {}
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    ~Ring()
+    {
+        if (m_sqes)
+            munmap(m_sqes, m_sqesSize);
+        if (m_cqRing && m_cqRing != m_sqRing)
+            munmap(m_cqRing, m_cqRingSize);
+        if (m_sqRing)
+            munmap(m_sqRing, m_sqRingSize);
+        if (0 <= m_fd)
+            close(m_fd);
+    }
+
+public: // Methods
+    /// Create an instance with at least \c entryCount submission queue entries. Returns false if io_uring is not available.
+    bool Open(unsigned entryCount)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        m_fd = int(syscall(__NR_io_uring_setup, entryCount, &params));
+        if (m_fd < 0)
+            return false;
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool isSingleMapping = 0 != (params.features & IORING_FEAT_SINGLE_MMAP);
+        if (isSingleMapping)
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        m_sqRing = Map(m_sqRingSize, IORING_OFF_SQ_RING);
+        m_cqRing = isSingleMapping ? m_sqRing : Map(m_cqRingSize, IORING_OFF_CQ_RING);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe*>(Map(m_sqesSize, IORING_OFF_SQES));
+        if (!m_sqRing || !m_cqRing || !m_sqes)
+            return false;
+        char* sq = static_cast<char*>(m_sqRing);
+        m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        m_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        char* cq = static_cast<char*>(m_cqRing);
+        m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        m_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        return true;
+    }
+
+    /// Queue a read of up to \c size bytes at \c offset in \c fd into \c data, identified by \c key
+    void Read(int fd, char* data, size_t size, size_t offset, uint64_t key)
+    {
+        unsigned tail = *m_sqTail;
+        unsigned index = tail & m_sqMask;
+        io_uring_sqe& entry = m_sqes[index];
+        memset(&entry, 0, sizeof(entry));
+        entry.opcode = IORING_OP_READ;
+        entry.fd = fd;
+        entry.addr = uint64_t(uintptr_t(data));
+        entry.len = unsigned(std::min<size_t>(size, 1u << 30));
+        entry.off = offset;
+        entry.user_data = key;
+        m_sqArray[index] = index;
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    /// Submit the queued reads and wait for at least one to complete. Returns false if the kernel rejects the request.
+    bool Submit()
+    {
+        for (;;)
+        {
+            unsigned submitCount = *m_sqTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+            if (0 <= syscall(__NR_io_uring_enter, m_fd, submitCount, 1, IORING_ENTER_GETEVENTS, 0, 0))
+                return true;
+            if (EINTR != errno && EAGAIN != errno && EBUSY != errno)
+                return false;
+        }
+    }
+
+    /// Pass the identifier and result of each completed read to \c handler
+    template <class HandlerT>
+    void Reap(HandlerT handler)
+    {
+        unsigned head = *m_cqHead;
+        unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe& entry = m_cqes[head & m_cqMask];
+            handler(entry.user_data, entry.res);
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    }
+
+protected: // Support methods
+    /// Map \c size bytes of the instance at \c offset into memory
+    void* Map(size_t size, off_t offset)
+    {
+        void* result = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+        return MAP_FAILED == result ? 0 : result;
+    }
+};
+#else // !defined(READ_AHEAD_IO_URING)
+/// io_uring is not available
+class ReadAhead::Ring
+{
+public: // Methods
+    bool Open(unsigned) { return false; }
+    void Read(int, char*, size_t, size_t, uint64_t) {}
+    bool Submit() { return false; }
+    template <class HandlerT>
+    void Reap(HandlerT) {}
+};
+#endif // !defined(READ_AHEAD_IO_URING)
+
+/// Up to \c depth reads in flight using the \c preferred method if it is available
+ReadAhead::ReadAhead(size_t depth, MethodType preferred)
+    : m_nextRead(0)
+    , m_depth(std::max<size_t>(1, depth))
+    , m_closed(false)
+{
+    if (IoUring == preferred)
+    {
+        m_ring.reset(new Ring);
+        if (m_ring->Open(unsigned(m_depth)))
+            m_readers.emplace_back(&ReadAhead::SubmitReads, this);
+        else
+        {
+            LOG4CXX_DEBUG(log_s, "io_uring is not available: " << strerror(errno));
+            m_ring.reset();
+        }
+    }
+    if (!m_ring)
+    {
+        for (size_t i = 0; i < m_depth; ++i)
+            m_readers.emplace_back(&ReadAhead::ReadFiles, this);
+    }
+}
+
+/// Wait for the reads in flight
+ReadAhead::~ReadAhead()
+{
+    Close();
+    for (auto& reader : m_readers)
+        reader.join();
+    for (auto& item : m_items)
+        if (0 <= item.second.fd)
+            close(item.second.fd);
+}
+
+/// Read \c path (identified by \c sequence, which increases with each call) when a read is available
+    void
+ReadAhead::Add(size_t sequence, const PathType& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_items.emplace(sequence, ItemType{path, Pending, -1, 0, std::string()});
+    m_added.notify_one();
+}
+
+/// Move the content of the file added as \c sequence into \c input, waiting for its read to finish.
+/// Returns false (and forgets the file) if it could not be read or its read has not started.
+    bool
+ReadAhead::Take(size_t sequence, InputFile& input)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    ItemMap::iterator pItem = m_items.find(sequence);
+    if (m_items.end() == pItem)
+        return false;
+    m_finished.wait(lock, [pItem] { return Reading != pItem->second.state; });
+    bool result = Loaded == pItem->second.state;
+    if (result)
+        input.Adopt(pItem->second.buffer);
+    m_items.erase(pItem);
+    return result;
+}
+
+/// Indicate no more files will be added
+    void
+ReadAhead::Close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_added.notify_all();
+}
+
+/// Wait until every file added has been read (or has failed)
+    void
+ReadAhead::WaitForReads()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_finished.wait(lock, [this]
+        { return !HasPending() && std::none_of(m_items.begin(), m_items.end(),
+            [](const ItemMap::value_type& item) { return Reading == item.second.state; });
+        });
+}
+
+/// Put the next item to read in \c pItem, marking it as Reading. Returns false if no item is Pending.
+    bool
+ReadAhead::StartNext(ItemMap::iterator& pItem)
+{
+    pItem = m_items.lower_bound(m_nextRead);
+    if (m_items.end() == pItem)
+        return false;
+    pItem->second.state = Reading;
+    m_nextRead = pItem->first + 1;
+    return true;
+}
+
+/// Open \c item.path and size \c item.buffer to hold its content
+    bool
+ReadAhead::Open(ItemType& item)
+{
+#if defined(_WIN32)
+    return false;
+#else
+    item.fd = open(item.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (item.fd < 0)
+        return false;
+    struct stat status;
+    if (0 != fstat(item.fd, &status) || !S_ISREG(status.st_mode))
+        return false;
+    item.buffer.resize(size_t(status.st_size));
+    item.done = 0;
+    return true;
+#endif
+}
+
+/// Read the content of \c item.path into \c item.buffer
+    bool
+ReadAhead::Load(ItemType& item)
+{
+#if defined(_WIN32)
+    std::ifstream instream(item.path.c_str(), std::ios::binary);
+    if (!instream.is_open())
+        return false;
+    item.buffer.assign(std::istreambuf_iterator<char>(instream), std::istreambuf_iterator<char>());
+    return !instream.bad();
+#else
+    if (!Open(item))
+        return false;
+#if defined(POSIX_FADV_WILLNEED)
+    posix_fadvise(item.fd, 0, 0, POSIX_FADV_WILLNEED); // Request the whole file rather than a window at a time
+#endif
+    while (item.done < item.buffer.size())
+    {
+        ssize_t count = pread(item.fd, &item.buffer[item.done], item.buffer.size() - item.done, off_t(item.done));
+        if (count < 0 && EINTR == errno)
+            continue;
+        if (count < 0)
+            return false;
+        if (0 == count) // Truncated since Open()
+        {
+            item.buffer.resize(item.done);
+            break;
+        }
+        item.done += size_t(count);
+    }
+    return true;
+#endif
+}
+
+/// Release the resources used to read \c item and mark it as Loaded (if \c ok) or Failed
+    void
+ReadAhead::Finish(ItemType& item, bool ok)
+{
+    if (0 <= item.fd)
+        close(item.fd);
+    item.fd = -1;
+    item.state = ok ? Loaded : Failed;
+    if (!ok)
+        item.buffer.clear();
+    m_finished.notify_all();
+}
+
+/// Read files until closed - the body of each ThreadPool reader
+    void
+ReadAhead::ReadFiles()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_added.wait(lock, [this] { return m_closed || HasPending(); });
+        ItemMap::iterator pItem;
+        if (!StartNext(pItem))
+            break;
+        ItemType& item = pItem->second;
+        lock.unlock();
+        bool ok = Load(item);
+        lock.lock();
+        Finish(item, ok);
+    }
+}
+
+/// Submit reads to m_ring until closed
+    void
+ReadAhead::SubmitReads()
+{
+    size_t inFlightCount = 0;
+    auto handleCompletion = [this, &inFlightCount](uint64_t key, int result)
+    {
+        ItemType& item = m_items.find(size_t(key))->second; // Not erased while Reading
+        if (0 < result)
+            item.done += size_t(result);
+        if (-EINTR == result || -EAGAIN == result || (0 < result && item.done < item.buffer.size()))
+            m_ring->Read(item.fd, &item.buffer[item.done], item.buffer.size() - item.done, item.done, key);
+        else
+        {
+            if (0 == result) // Truncated since Open()
+                item.buffer.resize(item.done);
+            Finish(item, 0 <= result);
+            --inFlightCount;
+        }
+    };
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        ItemMap::iterator pItem;
+        while (inFlightCount < m_depth && StartNext(pItem))
+        {
+            ItemType& item = pItem->second;
+            lock.unlock();
+            bool ok = Open(item);
+            lock.lock();
+            if (!ok || item.buffer.empty())
+                Finish(item, ok);
+            else
+            {
+                m_ring->Read(item.fd, &item.buffer[0], item.buffer.size(), 0, pItem->first);
+                ++inFlightCount;
+            }
+        }
+        if (0 == inFlightCount)
+        {
+            if (m_closed && !HasPending())
+                break;
+            m_added.wait(lock, [this] { return m_closed || HasPending(); });
+            continue;
+        }
+        lock.unlock();
+        bool ok = m_ring->Submit();
+        lock.lock();
+        if (ok)
+            m_ring->Reap(handleCompletion);
+        else
+        {
+            LOG4CXX_WARN(log_s, "io_uring_enter: " << strerror(errno));
+            for (auto& item : m_items) // The kernel rejected the ring, so leave the files to be read when taken
+                if (Reading == item.second.state)
+                    Finish(item.second, false);
+            inFlightCount = 0;
+        }
+    }
+}
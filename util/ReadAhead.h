@@ -0,0 +1,100 @@
+#if !defined(READ_AHEAD_INCLUDED)
+#define READ_AHEAD_INCLUDED
+#include "InputFile.h"
+#include <boost/filesystem.hpp>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Reads files before they are processed, keeping up to a given number of reads in flight.
+///
+/// Files are read in the order they are added, through io_uring when the kernel allows it,
+/// otherwise by a pool of reader threads that first start the transfer of the whole file with posix_fadvise.
+/// The buffer read becomes the content of the InputFile it is taken into, so it is not copied again.
+class ReadAhead
+{
+public: // Types
+    typedef boost::filesystem::path PathType;
+    enum MethodType { ThreadPool, IoUring };
+
+protected: // Types
+    enum StateType { Pending, Reading, Loaded, Failed };
+    struct ItemType
+    {
+        PathType    path;
+        StateType   state;
+        int         fd;     //!< The open file (or -1)
+        size_t      done;   //!< The number of bytes read into buffer
+        std::string buffer; //!< The content
+    };
+    typedef std::map<size_t, ItemType> ItemMap;
+    class Ring;
+
+private: // Attributes
+    std::mutex m_mutex;
+    std::condition_variable m_added; //!< Signalled when an item is added or this is closed
+    std::condition_variable m_finished; //!< Signalled when a read is finished
+    ItemMap m_items; //!< The files added but not yet taken, keyed on sequence
+    size_t m_nextRead; //!< Items from this sequence on are Pending
+    size_t m_depth; //!< The maximum number of reads in flight
+    bool m_closed; //!< Will no more files be added?
+    std::unique_ptr<Ring> m_ring; //!< Performs the reads (or null when m_readers do)
+    std::vector<std::thread> m_readers; //!< The threads reading or submitting reads
+
+public: // ...structors
+    /// Up to \c depth reads in flight using the \c preferred method if it is available
+    ReadAhead(size_t depth, MethodType preferred = IoUring);
+    ReadAhead(const ReadAhead&) = delete;
+    ReadAhead& operator=(const ReadAhead&) = delete;
+    /// Wait for the reads in flight
+    ~ReadAhead();
+
+public: // Accessors
+    /// How files are read
+    MethodType GetMethod() const { return m_ring ? IoUring : ThreadPool; }
+
+    /// The name of the method used to read files
+    const char* GetMethodName() const { return m_ring ? "io_uring" : "threads"; }
+
+public: // Modifiers
+    /// Read \c path (identified by \c sequence, which increases with each call) when a read is available
+    void Add(size_t sequence, const PathType& path);
+
+    /// Move the content of the file added as \c sequence into \c input, waiting for its read to finish.
+    /// Returns false (and forgets the file) if it could not be read or its read has not started.
+    bool Take(size_t sequence, InputFile& input);
+
+    /// Indicate no more files will be added
+    void Close();
+
+    /// Wait until every file added has been read (or has failed)
+    void WaitForReads();
+
+protected: // Support methods
+    /// Is an item waiting to be read?
+    bool HasPending() const { return m_items.end() != m_items.lower_bound(m_nextRead); }
+
+    /// Put the next item to read in \c pItem, marking it as Reading. Returns false if no item is Pending.
+    bool StartNext(ItemMap::iterator& pItem);
+
+    /// Open \c item.path and size \c item.buffer to hold its content
+    bool Open(ItemType& item);
+
+    /// Read the content of \c item.path into \c item.buffer
+    bool Load(ItemType& item);
+
+    /// Release the resources used to read \c item and mark it as Loaded (if \c ok) or Failed
+    void Finish(ItemType& item, bool ok);
+
+    /// Read files until closed - the body of each ThreadPool reader
+    void ReadFiles();
+
+    /// Submit reads to m_ring until closed
+    void SubmitReads();
+};
+
+#endif // !defined(READ_AHEAD_INCLUDED)
@@ -0,0 +1,115 @@
+#include "RequestServer.h"
+#include <log4cxx/logger.h>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+    static log4cxx::LoggerPtr
+log_s(log4cxx::Logger::getLogger("RequestServer"));
+
+/// A server checking files as \c options require, selecting those in a directory using \c selector
+RequestServer::RequestServer(const ProcessingOptions& options, const DirectoryEntrySelectorPtr& selector)
+    : m_options(options)
+    , m_selector(selector)
+{}
+
+/// Reply to the requests sent through \c connection until the client stops sending
+    void
+RequestServer::Serve(LocalSocket& connection)
+{
+    StringType line;
+    while (connection.ReadLine(line))
+    {
+        try
+        {
+            Serve(connection, line);
+        }
+        catch (std::exception& ex)
+        {
+            LOG4CXX_ERROR(log_s, "Request: " << ex.what());
+            connection.Write("error " + StringType(ex.what()) + "\n");
+            connection.Flush();
+            return;
+        }
+    }
+}
+
+/// Put the outcome in the reply \c line into \c result. Returns false if \c line is not a result.
+    bool
+RequestServer::ParseResult(const StringType& line, FileResult& result)
+{
+    std::istringstream is(line);
+    StringType tag;
+    is >> tag >> result.isValid >> result.fixCount >> result.isPrefiltered >> result.isCached;
+    if ("result" != tag || !is.ignore(1))
+        return false;
+    StringType name;
+    std::getline(is, name);
+    result.path = name;
+    return true;
+}
+
+/// Reply to the request starting with \c header
+    void
+RequestServer::Serve(LocalSocket& connection, const StringType& header)
+{
+    FileProcessor& processor = GetProcessor(header);
+    StringType line, content, output;
+    while (connection.ReadLine(line) && "end" != line)
+    {
+        if (0 == line.compare(0, 5, "path "))
+        {
+            std::vector<StringType> itemStore{line.substr(5)};
+            DirectoryEntryIterator fileIter(itemStore.begin(), itemStore.end(), m_selector);
+            for (fileIter.Start(); !fileIter.Off(); fileIter.Forth())
+                Reply(connection, processor.Process(fileIter.Item()));
+        }
+        else if (0 == line.compare(0, 7, "buffer "))
+        {
+            size_t nameStart = line.find(' ', 7);
+            if (StringType::npos == nameStart)
+                throw std::invalid_argument("no buffer name in: " + line);
+            if (!connection.ReadBlock(std::stoul(line.substr(7, nameStart - 7)), content))
+                throw std::invalid_argument("incomplete buffer: " + line);
+            Reply(connection, processor.ProcessBuffer(line.substr(nameStart + 1), content, output));
+            connection.Write("content " + std::to_string(output.size()) + "\n");
+            connection.Write(output);
+        }
+        else
+            throw std::invalid_argument("unknown request item: " + line);
+    }
+    connection.Write("done\n");
+    connection.Flush();
+}
+
+/// Send \c result
+    void
+RequestServer::Reply(LocalSocket& connection, const FileResult& result)
+{
+    std::ostringstream os;
+    os << "result " << result.isValid << ' ' << result.fixCount
+        << ' ' << result.isPrefiltered << ' ' << result.isCached
+        << ' ' << result.path.string() << '\n';
+    connection.Write(os.str());
+}
+
+/// The processor for the mode named in \c header
+    FileProcessor&
+RequestServer::GetProcessor(const StringType& header)
+{
+    static const char* modeName[ModeCount] = { "request check", "request only_11", "request both_10_and_11" };
+    int mode = 0;
+    while (mode < ModeCount && header != modeName[mode])
+        ++mode;
+    if (ModeCount <= mode)
+        throw std::invalid_argument("unknown request: " + header);
+    if (!m_processor[mode])
+    {
+        ProcessingOptions options = m_options;
+        options.fix = Check != mode;
+        options.fix_10_and_11 = Both10And11 == mode;
+        options.diff = false;
+        m_processor[mode].reset(new FileProcessor(options));
+    }
+    return *m_processor[mode];
+}
@@ -0,0 +1,54 @@
+#if !defined(REQUEST_SERVER_INCLUDED)
+#define REQUEST_SERVER_INCLUDED
+#include "DirectoryEntryIterator.h"
+#include "FileProcessor.h"
+#include "LocalSocket.h"
+#include <memory>
+#include <string>
+
+/// Checks the files requested by clients, keeping a processor for each mode so loaded state is reused.
+///
+/// The request protocol, spoken over a Unix socket, is a sequence of text lines:
+///   request {check|only_11|both_10_and_11}
+///   path {file or directory}         -- any number of path and buffer items
+///   buffer {size} {name}             -- followed by {size} bytes of content
+///   end
+/// The server replies to each file checked with
+///   result {isValid} {fixCount} {isPrefiltered} {isCached} {name}
+///   content {size}                   -- for a buffer, followed by the {size} bytes of changed content (if any)
+/// then a 'done' line. A 'error {message}' line ends the connection.
+class RequestServer
+{
+public: // Types
+    typedef std::string StringType;
+    enum ModeType { Check, Only11, Both10And11, ModeCount };
+
+private: // Attributes
+    ProcessingOptions m_options; //!< How files are checked (ignoring fix and fix_10_and_11)
+    DirectoryEntrySelectorPtr m_selector; //!< Selects the files in a requested directory
+    std::unique_ptr<FileProcessor> m_processor[ModeCount]; //!< Created when first requested
+
+public: // ...structors
+    /// A server checking files as \c options require, selecting those in a directory using \c selector
+    RequestServer(const ProcessingOptions& options, const DirectoryEntrySelectorPtr& selector);
+
+public: // Methods
+    /// Reply to the requests sent through \c connection until the client stops sending
+    void Serve(LocalSocket& connection);
+
+public: // Class methods
+    /// Put the outcome in the reply \c line into \c result. Returns false if \c line is not a result.
+    static bool ParseResult(const StringType& line, FileResult& result);
+
+protected: // Support methods
+    /// Reply to the request starting with \c header
+    void Serve(LocalSocket& connection, const StringType& header);
+
+    /// Send \c result
+    void Reply(LocalSocket& connection, const FileResult& result);
+
+    /// The processor for the mode named in \c header
+    FileProcessor& GetProcessor(const StringType& header);
+};
+
+#endif // !defined(REQUEST_SERVER_INCLUDED)
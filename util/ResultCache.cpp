@@ -0,0 +1,62 @@
+#include "ResultCache.h"
+#include "InputFile.h"
+#include "OutputFile.h"
+#include <sstream>
+
+/// Entries in \c directory for results produced under \c ruleSet
+ResultCache::ResultCache(const PathType& directory, const std::string& ruleSet)
+    : m_directory(directory)
+{
+    std::string versionedRuleSet = "version=" + std::to_string(FormatVersion) + " " + ruleSet;
+    m_ruleSetHash = ContentHash::Compute(versionedRuleSet.data(), versionedRuleSet.size());
+}
+
+/// The key of the result of checking \c content
+    ResultCache::KeyType
+ResultCache::GetKey(std::string_view content) const
+{
+    return ContentHash::Combine(ContentHash::Compute(content.data(), content.size()), m_ruleSetHash);
+}
+
+/// The file holding the entry for \c key
+    ResultCache::PathType
+ResultCache::GetEntryPath(const KeyType& key) const
+{
+    std::string name = ContentHash::ToString(key);
+    return m_directory / name.substr(0, 2) / name.substr(2);
+}
+
+/// Put the result stored for \c key into \c value. Returns false if there is no valid entry.
+    bool
+ResultCache::Find(const KeyType& key, ValueType& value) const
+{
+    InputFile entry;
+    if (!entry.Open(GetEntryPath(key), false))
+        return false;
+    std::istringstream is{std::string(entry.GetContent())};
+    std::string tag;
+    int version = 0;
+    ValueType result{0, 0};
+    if (!(is >> tag >> version >> result.macroCount >> result.fixCount)
+        || "log4cxx_10_to_11" != tag || FormatVersion != version
+        || result.macroCount < 0 || result.fixCount < 0 || result.macroCount < result.fixCount)
+        return false;
+    value = result;
+    return true;
+}
+
+/// Record \c value as the result for \c key. Returns false if the entry could not be written.
+    bool
+ResultCache::Store(const KeyType& key, const ValueType& value) const
+{
+    PathType path = GetEntryPath(key);
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(path.parent_path(), ec);
+    if (ec && !boost::filesystem::is_directory(path.parent_path(), ec)) // Another process may have made it
+        return false;
+    std::string text = "log4cxx_10_to_11 " + std::to_string(FormatVersion)
+        + " " + std::to_string(value.macroCount)
+        + " " + std::to_string(value.fixCount) + "\n";
+    OutputFile output(path);
+    return output.Store(OutputFile::SpanStore{text});
+}
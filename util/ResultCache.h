@@ -0,0 +1,55 @@
+#if !defined(RESULT_CACHE_INCLUDED)
+#define RESULT_CACHE_INCLUDED
+#include "ContentHash.h"
+#include <boost/filesystem.hpp>
+#include <string>
+#include <string_view>
+
+/// The outcome of checking file content, kept on disk for reuse by later runs.
+///
+/// Each entry is a small file named by the hash of the content combined with the hash of the rule set,
+/// in a subdirectory named by the first two hexadecimal digits.
+/// An entry is written to a new file that is then renamed into place,
+/// so any number of processes (e.g. in different checkouts) can share the directory without locking:
+/// a reader sees either no entry or a complete one, and concurrent writers store identical bytes.
+class ResultCache
+{
+public: // Types
+    typedef boost::filesystem::path PathType;
+    typedef ContentHash::ValueType KeyType;
+
+    /// What is recorded for each content
+    struct ValueType
+    {
+        int macroCount; //!< The number of function calls of interest
+        int fixCount;   //!< The number of those needing a change
+    };
+
+private: // Attributes
+    PathType m_directory; //!< Where the entries are stored
+    ContentHash::ValueType m_ruleSetHash; //!< Distinguishes the results of different rule sets
+
+public: // ...structors
+    /// Entries in \c directory for results produced under \c ruleSet
+    ResultCache(const PathType& directory, const std::string& ruleSet);
+
+public: // Accessors
+    /// The key of the result of checking \c content
+    KeyType GetKey(std::string_view content) const;
+
+    /// Put the result stored for \c key into \c value. Returns false if there is no valid entry.
+    bool Find(const KeyType& key, ValueType& value) const;
+
+public: // Methods
+    /// Record \c value as the result for \c key. Returns false if the entry could not be written.
+    bool Store(const KeyType& key, const ValueType& value) const;
+
+protected: // Support methods
+    /// The file holding the entry for \c key
+    PathType GetEntryPath(const KeyType& key) const;
+
+private: // Class data
+    static const int FormatVersion = 1; //!< Changes when the entry layout or checking rules change
+};
+
+#endif // !defined(RESULT_CACHE_INCLUDED)
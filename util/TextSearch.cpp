@@ -0,0 +1,209 @@
+#include "TextSearch.h"
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TEXT_SEARCH_SSE2 __attribute__((target("sse2")))
+#define TEXT_SEARCH_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#define TEXT_SEARCH_SSE2
+#endif
+
+namespace
+{
+    typedef const char* (*FindFunction)(const char*, const char*, const char*, size_t);
+    typedef void (*LineStartFunction)(const char*, const char*, const char*, std::vector<size_t>&);
+
+    /// The first occurrence of [needle, needle + needleLength) in [first, last) or \c last if not found
+    const char* FindScalar(const char* first, const char* last, const char* needle, size_t needleLength)
+    {
+        if (0 == needleLength)
+            return first;
+        for (const char* p = first; needleLength <= size_t(last - p); ++p)
+        {
+            p = static_cast<const char*>(memchr(p, needle[0], last - p - needleLength + 1));
+            if (!p)
+                break;
+            if (0 == memcmp(p + 1, needle + 1, needleLength - 1))
+                return p;
+        }
+        return last;
+    }
+
+    /// Append to \c lineStarts the index (from \c base) after each line feed in [first, last)
+    void FindLineStartsScalar(const char* base, const char* first, const char* last, std::vector<size_t>& lineStarts)
+    {
+        for (const char* p = first; (p = static_cast<const char*>(memchr(p, '\n', last - p))) != 0; )
+            lineStarts.push_back(++p - base);
+    }
+
+#if defined(TEXT_SEARCH_SSE2)
+    /// The index of the lowest set bit in \c mask - Precondition: 0 != mask
+    inline int LowestBit(unsigned mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long result;
+        _BitScanForward(&result, mask);
+        return int(result);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    /// Compare 16 candidate positions at a time on their first and last characters
+    TEXT_SEARCH_SSE2
+    const char* FindSse2(const char* first, const char* last, const char* needle, size_t needleLength)
+    {
+        if (needleLength < 2 || size_t(last - first) < needleLength)
+            return FindScalar(first, last, needle, needleLength);
+        const __m128i firstChar = _mm_set1_epi8(needle[0]);
+        const __m128i lastChar = _mm_set1_epi8(needle[needleLength - 1]);
+        const char* candidateEnd = last - needleLength + 1;
+        const char* p = first;
+        for (; p + 16 <= candidateEnd; p += 16)
+        {
+            __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + needleLength - 1));
+            unsigned mask = unsigned(_mm_movemask_epi8(_mm_and_si128
+                ( _mm_cmpeq_epi8(firstChar, blockFirst)
+                , _mm_cmpeq_epi8(lastChar, blockLast)
+                )));
+            while (mask)
+            {
+                int bit = LowestBit(mask);
+                if (0 == memcmp(p + bit + 1, needle + 1, needleLength - 2))
+                    return p + bit;
+                mask &= mask - 1;
+            }
+        }
+        return FindScalar(p, last, needle, needleLength);
+    }
+
+    /// Compare 16 characters at a time with a line feed
+    TEXT_SEARCH_SSE2
+    void FindLineStartsSse2(const char* base, const char* first, const char* last, std::vector<size_t>& lineStarts)
+    {
+        const __m128i lineFeed = _mm_set1_epi8('\n');
+        const char* p = first;
+        for (; p + 16 <= last; p += 16)
+        {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            unsigned mask = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(lineFeed, block)));
+            for (; mask; mask &= mask - 1)
+                lineStarts.push_back(p + LowestBit(mask) + 1 - base);
+        }
+        FindLineStartsScalar(base, p, last, lineStarts);
+    }
+#endif
+
+#if defined(TEXT_SEARCH_AVX2)
+    /// Compare 32 candidate positions at a time on their first and last characters
+    TEXT_SEARCH_AVX2
+    const char* FindAvx2(const char* first, const char* last, const char* needle, size_t needleLength)
+    {
+        if (needleLength < 2 || size_t(last - first) < needleLength)
+            return FindScalar(first, last, needle, needleLength);
+        const __m256i firstChar = _mm256_set1_epi8(needle[0]);
+        const __m256i lastChar = _mm256_set1_epi8(needle[needleLength - 1]);
+        const char* candidateEnd = last - needleLength + 1;
+        const char* p = first;
+        for (; p + 32 <= candidateEnd; p += 32)
+        {
+            __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + needleLength - 1));
+            unsigned mask = unsigned(_mm256_movemask_epi8(_mm256_and_si256
+                ( _mm256_cmpeq_epi8(firstChar, blockFirst)
+                , _mm256_cmpeq_epi8(lastChar, blockLast)
+                )));
+            while (mask)
+            {
+                int bit = __builtin_ctz(mask);
+                if (0 == memcmp(p + bit + 1, needle + 1, needleLength - 2))
+                    return p + bit;
+                mask &= mask - 1;
+            }
+        }
+        return FindSse2(p, last, needle, needleLength);
+    }
+
+    /// Compare 32 characters at a time with a line feed
+    TEXT_SEARCH_AVX2
+    void FindLineStartsAvx2(const char* base, const char* first, const char* last, std::vector<size_t>& lineStarts)
+    {
+        const __m256i lineFeed = _mm256_set1_epi8('\n');
+        const char* p = first;
+        for (; p + 32 <= last; p += 32)
+        {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            unsigned mask = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lineFeed, block)));
+            for (; mask; mask &= mask - 1)
+                lineStarts.push_back(p + __builtin_ctz(mask) + 1 - base);
+        }
+        FindLineStartsSse2(base, p, last, lineStarts);
+    }
+#endif
+
+    /// The kernels supported by this processor
+    struct Kernel
+    {
+        const char*  name;
+        FindFunction find;
+        LineStartFunction findLineStarts;
+
+        Kernel()
+        {
+#if defined(TEXT_SEARCH_AVX2)
+            if (__builtin_cpu_supports("avx2"))
+            {
+                name = "avx2";
+                find = FindAvx2;
+                findLineStarts = FindLineStartsAvx2;
+                return;
+            }
+#endif
+#if defined(TEXT_SEARCH_SSE2)
+#if defined(__GNUC__) || defined(__clang__)
+            if (__builtin_cpu_supports("sse2"))
+#endif
+            {
+                name = "sse2";
+                find = FindSse2;
+                findLineStarts = FindLineStartsSse2;
+                return;
+            }
+#endif
+            name = "scalar";
+            find = FindScalar;
+            findLineStarts = FindLineStartsScalar;
+        }
+    };
+
+    /// The kernels selected on first use
+    const Kernel& GetKernel()
+    {
+        static const Kernel kernel;
+        return kernel;
+    }
+}
+
+/// The first occurrence of [needle, needle + needleLength) in [first, last) or \c last if not found
+    const char*
+TextSearch::Find(const char* first, const char* last, const char* needle, size_t needleLength)
+{
+    return GetKernel().find(first, last, needle, needleLength);
+}
+
+/// Append to \c lineStarts the index (from \c first) after each line feed in [first, last)
+    void
+TextSearch::FindLineStarts(const char* first, const char* last, std::vector<size_t>& lineStarts)
+{
+    GetKernel().findLineStarts(first, first, last, lineStarts);
+}
+
+/// The name of the kernel implementation in use
+    const char*
+TextSearch::GetKernelName()
+{
+    return GetKernel().name;
+}
@@ -0,0 +1,22 @@
+#if !defined(TEXT_SEARCH_INCLUDED)
+#define TEXT_SEARCH_INCLUDED
+#include <cstddef>
+#include <vector>
+
+/// Vectorized text scanning kernels.
+///
+/// The widest instruction set supported by the processor (AVX2 or SSE2)
+/// is selected the first time a kernel is used, otherwise a scalar version is used.
+namespace TextSearch
+{
+    /// The first occurrence of [needle, needle + needleLength) in [first, last) or \c last if not found
+    const char* Find(const char* first, const char* last, const char* needle, size_t needleLength);
+
+    /// Append to \c lineStarts the index (from \c first) after each line feed in [first, last)
+    void FindLineStarts(const char* first, const char* last, std::vector<size_t>& lineStarts);
+
+    /// The name of the kernel implementation in use
+    const char* GetKernelName();
+}
+
+#endif // !defined(TEXT_SEARCH_INCLUDED)
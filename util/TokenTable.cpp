@@ -0,0 +1,84 @@
+#include "TokenTable.h"
+#include <algorithm>
+
+static_assert(boost::wave::T_LAST_TOKEN < 512, "Wave base token identifiers must fit in TokenTable::BaseIdMask");
+
+const TokenTable::OrdinalType TokenTable::NoOrdinal;
+
+/// An empty table
+TokenTable::TokenTable()
+    : m_lastSignificant(NoOrdinal)
+{
+    m_category.fill(0);
+}
+
+/// The ordinal of the first token at or after \c offset, or Size()
+    size_t
+TokenTable::LowerBound(size_t offset) const
+{
+    if (GetMaxContentSize() < offset)
+        return Size();
+    return std::lower_bound(m_offsets.begin(), m_offsets.end(), OffsetType(offset)) - m_offsets.begin();
+}
+
+/// The ordinal of the first token after \c offset, or Size()
+    size_t
+TokenTable::UpperBound(size_t offset) const
+{
+    if (GetMaxContentSize() <= offset)
+        return Size();
+    return std::upper_bound(m_offsets.begin(), m_offsets.end(), OffsetType(offset)) - m_offsets.begin();
+}
+
+/// Remove all tokens (retaining the allocated storage)
+    void
+TokenTable::Clear()
+{
+    m_offsets.clear();
+    m_ids.clear();
+    m_mates.clear();
+    m_nextSignificant.clear();
+    m_previousSignificant.clear();
+    m_lastSignificant = NoOrdinal;
+}
+
+/// Allow for \c tokenCount tokens without reallocation
+    void
+TokenTable::Reserve(size_t tokenCount)
+{
+    m_offsets.reserve(tokenCount);
+    m_ids.reserve(tokenCount);
+    m_mates.reserve(tokenCount);
+    m_nextSignificant.reserve(tokenCount);
+    m_previousSignificant.reserve(tokenCount);
+}
+
+/// Add the token \c id at \c offset - Precondition: GetOffset(Size() - 1) <= offset
+    void
+TokenTable::Append(size_t offset, TokenId id)
+{
+    if (BaseIdMask < (id & boost::wave::TokenValueMask & ~boost::wave::PPTokenFlag)) // Not a lexer token
+        id = boost::wave::T_UNKNOWN;
+    uint32_t baseId = id & BaseIdMask;
+    m_category[baseId] = id & ~(BaseIdMask | boost::wave::ExtTokenOnlyMask);
+    m_offsets.push_back(OffsetType(offset));
+    m_ids.push_back(CompactIdType(baseId | ((id & boost::wave::ExtTokenOnlyMask) >> ExtensionShift)));
+    m_mates.push_back(NoOrdinal);
+    m_previousSignificant.push_back(m_lastSignificant);
+    m_nextSignificant.push_back(NoOrdinal);
+    if (!IsWhitespaceId(id)) // The next significant token of the tokens since the last one
+    {
+        OrdinalType ordinal = OrdinalType(m_offsets.size() - 1);
+        for (size_t i = NoOrdinal == m_lastSignificant ? 0 : m_lastSignificant; i < ordinal; ++i)
+            m_nextSignificant[i] = ordinal;
+        m_lastSignificant = ordinal;
+    }
+}
+
+/// Make the tokens at \c opening and \c closing refer to each other - Precondition: opening < closing < Size()
+    void
+TokenTable::SetMate(size_t opening, size_t closing)
+{
+    m_mates[opening] = OrdinalType(closing);
+    m_mates[closing] = OrdinalType(opening);
+}
@@ -0,0 +1,168 @@
+#if !defined(TOKEN_TABLE_INCLUDED)
+#define TOKEN_TABLE_INCLUDED
+#include <boost/wave/token_ids.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/// The tokens of some content as parallel arrays of content offsets and compact token identifiers.
+///
+/// Tokens are appended in content order, so the offsets are sorted by construction
+/// and a token is located using a binary search of the offsets.
+/// A token is referred to by its ordinal, the number of tokens before it.
+/// Matching parentheses, braces and brackets refer to each other by ordinal,
+/// as does each token and its neighbours that are not white space,
+/// so moving to the next or previous significant token takes constant time.
+class TokenTable
+{
+public: // Types
+    typedef boost::wave::token_id TokenId;
+    typedef uint32_t OffsetType; //!< The index of the first character of a token in the content
+    typedef uint16_t CompactIdType; //!< The base identifier and extension bits of a TokenId
+    typedef uint32_t OrdinalType; //!< The position of a token in the table
+    /// The kinds of token that are matched
+    enum BracketKind
+    { Parenthesis //!< ( and )
+    , Brace       //!< { and }
+    , Bracket     //!< [ and ]
+    , BracketKindCount
+    , NotBracket = BracketKindCount
+    };
+
+protected: // Types
+    typedef std::vector<OffsetType> OffsetStore;
+    typedef std::vector<CompactIdType> CompactIdStore;
+    typedef std::vector<OrdinalType> OrdinalStore;
+    static const size_t BaseIdCount = 512;
+    typedef std::array<uint32_t, BaseIdCount> CategoryStore;
+    /// The bits of a token class
+    enum ClassBits : uint8_t
+    { WhitespaceClass = 1    //!< White space, a comment or a line break
+    , OpeningClass    = 2    //!< An opening bracket
+    , KindShift       = 2    //!< Moves a BracketKind into the class
+    , KindMask        = 3 << KindShift
+    };
+    typedef std::array<uint8_t, BaseIdCount> ClassStore;
+
+private: // Attributes
+    OffsetStore m_offsets; //!< The content offset of each token
+    CompactIdStore m_ids; //!< The compact identifier of each token
+    OrdinalStore m_mates; //!< The ordinal of the matching bracket of each token, or NoOrdinal
+    OrdinalStore m_nextSignificant; //!< The ordinal of the first significant token after each token, or NoOrdinal
+    OrdinalStore m_previousSignificant; //!< The ordinal of the last significant token before each token, or NoOrdinal
+    OrdinalType m_lastSignificant; //!< The ordinal of the last significant token, or NoOrdinal
+    CategoryStore m_category; //!< The category bits of each base identifier appended
+
+public: // ...structors
+    /// An empty table
+    TokenTable();
+
+public: // Accessors
+    /// The number of tokens
+    size_t Size() const { return m_offsets.size(); }
+
+    /// Are there no tokens?
+    bool IsEmpty() const { return m_offsets.empty(); }
+
+    /// The content offset of the token at \c ordinal - Precondition: ordinal < Size()
+    size_t GetOffset(size_t ordinal) const { return m_offsets[ordinal]; }
+
+    /// The identifier of the token at \c ordinal - Precondition: ordinal < Size()
+    TokenId GetId(size_t ordinal) const
+    {
+        CompactIdType id = m_ids[ordinal];
+        return TokenId(m_category[id & BaseIdMask] | (uint32_t(id & ~BaseIdMask) << ExtensionShift) | (id & BaseIdMask));
+    }
+
+    /// The ordinal of the bracket matching the token at \c ordinal, or Size() - Precondition: ordinal < Size()
+    size_t GetMate(size_t ordinal) const
+    {
+        OrdinalType mate = m_mates[ordinal];
+        return NoOrdinal == mate ? Size() : mate;
+    }
+
+    /// The identifier of the token at \c ordinal, or T_EOI when ordinal is Size()
+    TokenId GetIdOrEnd(size_t ordinal) const { return ordinal < Size() ? GetId(ordinal) : boost::wave::T_EOI; }
+
+    /// Is the token at \c ordinal white space, a comment or a line break? - Precondition: ordinal < Size()
+    bool IsWhitespace(size_t ordinal) const { return IsWhitespaceId(GetId(ordinal)); }
+
+    /// The ordinal of the first token at or after \c offset, or Size()
+    size_t LowerBound(size_t offset) const;
+
+    /// The ordinal of the first token after \c offset, or Size()
+    size_t UpperBound(size_t offset) const;
+
+    /// The ordinal of the first token after \c ordinal that is not white space, or Size()
+    size_t NextSignificant(size_t ordinal) const
+    {
+        if (Size() <= ordinal)
+            return Size();
+        OrdinalType result = m_nextSignificant[ordinal];
+        return NoOrdinal == result ? Size() : result;
+    }
+
+    /// The ordinal of the last token before \c ordinal that is not white space, or Size()
+    size_t PreviousSignificant(size_t ordinal) const
+    {
+        OrdinalType result = ordinal < Size() ? m_previousSignificant[ordinal] : m_lastSignificant;
+        return NoOrdinal == result ? Size() : result;
+    }
+
+    /// Is \c id white space, a comment or a line break?
+    static bool IsWhitespaceId(TokenId id) { return 0 != (m_classOfBaseId[id & BaseIdMask] & WhitespaceClass); }
+
+    /// The kind of bracket \c id is, and whether it is an opening bracket
+    static BracketKind GetBracketKind(TokenId id, bool& isOpening)
+    {
+        uint8_t tokenClass = m_classOfBaseId[id & BaseIdMask];
+        isOpening = 0 != (tokenClass & OpeningClass);
+        return BracketKind((tokenClass & KindMask) >> KindShift);
+    }
+
+    /// The largest content size that can be indexed
+    static size_t GetMaxContentSize() { return UINT32_MAX; }
+
+public: // Modifiers
+    /// Remove all tokens (retaining the allocated storage)
+    void Clear();
+
+    /// Allow for \c tokenCount tokens without reallocation
+    void Reserve(size_t tokenCount);
+
+    /// Add the token \c id at \c offset - Precondition: GetOffset(Size() - 1) <= offset
+    void Append(size_t offset, TokenId id);
+
+    /// Make the tokens at \c opening and \c closing refer to each other - Precondition: opening < closing < Size()
+    void SetMate(size_t opening, size_t closing);
+
+protected: // Support methods
+    /// The class of each base identifier
+    static constexpr ClassStore MakeClassTable()
+    {
+        ClassStore result{};
+        for (auto& tokenClass : result)
+            tokenClass = NotBracket << KindShift;
+        for (TokenId id : { boost::wave::T_SPACE, boost::wave::T_SPACE2, boost::wave::T_CCOMMENT, boost::wave::T_CPPCOMMENT
+                          , boost::wave::T_NEWLINE, boost::wave::T_CONTLINE, boost::wave::T_PLACEHOLDER })
+            result[id & BaseIdMask] |= WhitespaceClass;
+        struct { TokenId id; BracketKind kind; bool isOpening; } brackets[] =
+            { { boost::wave::T_LEFTPAREN, Parenthesis, true }, { boost::wave::T_RIGHTPAREN, Parenthesis, false }
+            , { boost::wave::T_LEFTBRACE, Brace, true }, { boost::wave::T_RIGHTBRACE, Brace, false }
+            , { boost::wave::T_LEFTBRACKET, Bracket, true }, { boost::wave::T_RIGHTBRACKET, Bracket, false }
+            };
+        for (auto& bracket : brackets)
+            result[bracket.id & BaseIdMask] = uint8_t((bracket.kind << KindShift) | (bracket.isOpening ? OpeningClass : 0));
+        return result;
+    }
+
+private: // Class data
+    static const OrdinalType NoOrdinal = UINT32_MAX;
+    static const uint32_t BaseIdMask = BaseIdCount - 1;
+    static const int ExtensionShift = 10; //!< Moves ExtTokenOnlyMask bits to above BaseIdMask
+    static const ClassStore m_classOfBaseId; //!< Replaces chained category tests
+};
+
+inline constexpr TokenTable::ClassStore TokenTable::m_classOfBaseId = TokenTable::MakeClassTable();
+
+#endif // !defined(TOKEN_TABLE_INCLUDED)